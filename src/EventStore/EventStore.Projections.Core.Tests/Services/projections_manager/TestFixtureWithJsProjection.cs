@@ -31,6 +31,8 @@ using System.Collections.Generic;
 using EventStore.Projections.Core.Services;
 using EventStore.Projections.Core.Services.Management;
 using EventStore.Projections.Core.Services.Processing;
+using EventStore.Projections.Core.Services.v8;
+using EventStore.Projections.Core.v8;
 using NUnit.Framework;
 
 namespace EventStore.Projections.Core.Tests.Services.projections_manager
@@ -68,6 +70,34 @@ namespace EventStore.Projections.Core.Tests.Services.projections_manager
 
         protected abstract void Given();
 
+        internal QueryScript GetQuery()
+        {
+            return ((V8ProjectionStateHandler) _stateHandler).GetQuery();
+        }
+
+        protected string ProcessEvent(int sequenceNumber, string data)
+        {
+            return ProcessEvent(sequenceNumber, "stream1", "type1", data);
+        }
+
+        protected string ProcessEvent(int sequenceNumber, string streamId, string eventType, string data)
+        {
+            string state;
+            EmittedEvent[] emittedEvents;
+            _stateHandler.ProcessEvent(
+                new EventPosition(sequenceNumber * 10 + 10, sequenceNumber * 10 + 5),
+                CheckpointTag.FromPosition(sequenceNumber * 10 + 10, sequenceNumber * 10 + 5), streamId, eventType,
+                "category", Guid.NewGuid(), sequenceNumber, "metadata", data, out state, out emittedEvents);
+            return state;
+        }
+
+        // loads the state the way a restarted projection does and forgets what has been logged so far
+        protected void ReloadState(string state)
+        {
+            _stateHandler.Load(state);
+            _logged.Clear();
+        }
+
         [TearDown]
         public void teardown()
         {
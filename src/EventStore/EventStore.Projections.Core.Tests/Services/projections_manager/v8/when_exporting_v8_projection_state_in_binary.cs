@@ -0,0 +1,117 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System;
+using System.IO;
+using System.Text;
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_exporting_v8_projection_state_in_binary : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { items: [], flag: new Boolean(false), ignored: undefined };
+                    },
+                    type1: function(state, event) {
+                        state.items.push({ customer: event.body.customer, amount: event.body.amount, paid: true });
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private static byte[] ExportState(QueryScript query, int chunkSize)
+        {
+            var all = new MemoryStream();
+            query.ExportState(chunkSize, chunk => all.Write(chunk, 0, chunk.Length));
+            return all.ToArray();
+        }
+
+        [Test]
+        public void the_imported_state_is_the_exported_one()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, "{\"customer\":\"a\u017e\",\"amount\":-12}");
+            var state = ProcessEvent(1, @"{""customer"":""b"",""amount"":0.25}");
+            var exported = ExportState(query, 5);
+
+            query.SetState("{}");
+            query.ImportState(exported);
+            Assert.AreEqual(state, query.GetState());
+        }
+
+        [Test]
+        public void boolean_objects_are_exported_as_their_value()
+        {
+            var query = GetQuery();
+            var exported = ExportState(query, 1024);
+            query.ImportState(exported);
+            Assert.AreEqual(@"{""items"":[],""flag"":false}", query.GetState());
+        }
+
+        [Test]
+        public void a_proto_key_is_imported_as_an_own_property()
+        {
+            var query = GetQuery();
+            const string state = @"{""__proto__"":{""items"":[1]},""flag"":true}";
+            query.SetState(state);
+            var exported = ExportState(query, 1024);
+            query.SetState("{}");
+            query.ImportState(exported);
+            Assert.AreEqual(state, query.GetState());
+        }
+
+        [Test]
+        public void repeated_keys_make_the_export_smaller_than_json()
+        {
+            var query = GetQuery();
+            string state = null;
+            for (var i = 0; i < 20; i++)
+                state = ProcessEvent(i, @"{""customer"":""customer-" + i % 3 + @""",""amount"":" + i + "}");
+            Assert.Less(ExportState(query, 1024).Length, Encoding.UTF8.GetByteCount(state));
+        }
+
+        [Test]
+        public void invalid_data_is_rejected()
+        {
+            var query = GetQuery();
+            var exported = ExportState(query, 1024);
+            var truncated = new byte[exported.Length - 1];
+            Array.Copy(exported, truncated, truncated.Length);
+            Assert.Throws<Js1Exception>(() => query.ImportState(truncated));
+            Assert.Throws<Js1Exception>(() => query.ImportState(Encoding.UTF8.GetBytes("{}")));
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_reading_a_part_of_v8_projection_state : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { customers: {}, 'a/b': [1, 2], hidden: undefined };
+                    },
+                    type1: function(state, event) {
+                        var customer = state.customers[event.body.id] || (state.customers[event.body.id] = { total: 0 });
+                        customer.total += event.body.amount;
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        [Test]
+        public void a_top_level_key_selects_its_value()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""id"":42,""amount"":5}");
+            Assert.AreEqual(@"{""42"":{""total"":5}}", query.GetStateAt("customers"));
+        }
+
+        [Test]
+        public void a_json_pointer_selects_a_nested_value()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""id"":42,""amount"":5}");
+            ProcessEvent(1, @"{""id"":42,""amount"":2}");
+            Assert.AreEqual("7", query.GetStateAt("/customers/42/total"));
+            Assert.AreEqual("2", query.GetStateAt("/a~1b/1"));
+        }
+
+        [Test]
+        public void the_empty_path_selects_the_whole_state()
+        {
+            var query = GetQuery();
+            Assert.AreEqual(query.GetState(), query.GetStateAt(""));
+        }
+
+        [Test]
+        public void a_path_which_does_not_exist_is_rejected()
+        {
+            var query = GetQuery();
+            Assert.Throws<Js1Exception>(() => query.GetStateAt("/customers/1"));
+            Assert.Throws<Js1Exception>(() => query.GetStateAt("/a~1b/2"));
+            Assert.Throws<Js1Exception>(() => query.GetStateAt("hidden"));
+            Assert.Throws<Js1Exception>(() => query.GetStateAt("/a~2b"));
+        }
+    }
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System.IO;
+using System.Text;
+using System.Text.RegularExpressions;
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_reading_v8_projection_state_repeatedly : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { count: 0 };
+                    },
+                    type1: function(state, event) {
+                        state.count++;
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private static int GetStateCalls(QueryScript query)
+        {
+            var match = Regex.Match(query.GetHandlerStatistics(), @"""get_state"":\{""calls"":(\d+)");
+            Assert.IsTrue(match.Success);
+            return int.Parse(match.Groups[1].Value);
+        }
+
+        [Test]
+        public void the_state_is_serialized_once_until_it_changes()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, "{}");
+            Assert.AreEqual(@"{""count"":1}", query.GetState());
+            Assert.AreEqual(@"{""count"":1}", query.GetState());
+            Assert.AreEqual(1, GetStateCalls(query));
+        }
+
+        [Test]
+        public void a_processed_event_invalidates_the_cached_state()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, "{}");
+            query.GetState();
+            ProcessEvent(1, "{}");
+            Assert.AreEqual(@"{""count"":2}", query.GetState());
+            Assert.AreEqual(2, GetStateCalls(query));
+        }
+
+        [Test]
+        public void a_replaced_state_invalidates_the_cached_state()
+        {
+            var query = GetQuery();
+            query.GetState();
+            query.SetState(@"{""count"":5}");
+            Assert.AreEqual(@"{""count"":5}", query.GetState());
+            query.LoadState(new MemoryStream(Encoding.UTF8.GetBytes(@"{""count"":7}")), 1024);
+            Assert.AreEqual(@"{""count"":7}", query.GetState());
+        }
+    }
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System.Collections.Generic;
+using System.Globalization;
+using EventStore.Projections.Core.Services.v8;
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_a_v8_projection_in_shards
+    {
+        private const string Projection = @"
+            fromAll().foreachStream().when({
+                $init: function() {
+                    return { count: 0 };
+                },
+                type1: function(state, event) {
+                    if (event.body.fail)
+                        throw 'failed';
+                    if (event.body.emit)
+                        emit('output', 'emitted', { count: state.count });
+                    state.count++;
+                    return state;
+                }
+            });
+        ";
+
+        private PreludeScript _prelude;
+        private ShardedQuery _query;
+        private List<string> _emitted;
+
+        [SetUp]
+        public void setup()
+        {
+            var preludeSource = DefaultV8ProjectionStateHandler.GetModuleSource("1Prelude");
+            _prelude = new PreludeScript(
+                preludeSource.Item1, preludeSource.Item2, DefaultV8ProjectionStateHandler.GetModuleSource);
+            _query = new ShardedQuery(_prelude, Projection, "sharded.js", 4);
+            _emitted = new List<string>();
+            _query.Emit += json =>
+                {
+                    lock (_emitted)
+                        _emitted.Add(json);
+                };
+        }
+
+        [TearDown]
+        public void teardown()
+        {
+            _query.Dispose();
+            _prelude.Dispose();
+        }
+
+        private void Push(string partition, int sequenceNumber, string data)
+        {
+            _query.Push(
+                partition, data,
+                new[]
+                    {
+                        partition, "type1", "category", sequenceNumber.ToString(CultureInfo.InvariantCulture), "metadata",
+                        "0"
+                    });
+        }
+
+        [Test]
+        public void the_state_contains_the_partitions_of_all_the_shards()
+        {
+            for (var i = 0; i < 10; i++)
+                for (var j = 0; j <= i; j++)
+                    Push("stream-" + i, j, "{}");
+            var state = _query.GetState();
+            for (var i = 0; i < 10; i++)
+                StringAssert.Contains(@"""stream-" + i + @""":{""count"":" + (i + 1) + "}", state);
+        }
+
+        [Test]
+        public void a_loaded_state_is_continued()
+        {
+            _query.SetState(@"{""a"":{""count"":5},""b"":{""count"":1}}");
+            Push("a", 5, "{}");
+            Push("c", 0, "{}");
+            var state = _query.GetState();
+            StringAssert.Contains(@"""a"":{""count"":6}", state);
+            StringAssert.Contains(@"""b"":{""count"":1}", state);
+            StringAssert.Contains(@"""c"":{""count"":1}", state);
+        }
+
+        [Test]
+        public void initialize_removes_all_the_partitions()
+        {
+            Push("a", 0, "{}");
+            _query.Initialize();
+            Assert.AreEqual("{}", _query.GetState());
+        }
+
+        [Test]
+        public void reverse_commands_are_delivered()
+        {
+            Push("a", 0, "{}");
+            Push("a", 1, @"{""emit"":true}");
+            _query.GetState();
+            Assert.AreEqual(1, _emitted.Count);
+            StringAssert.Contains(@"""streamId"":""output""", _emitted[0]);
+            StringAssert.Contains(@"\""count\"":1", _emitted[0]);
+        }
+
+        [Test]
+        public void a_failed_event_is_reported_by_the_next_call()
+        {
+            Push("a", 0, @"{""fail"":true}");
+            var exception = Assert.Throws<Js1Exception>(() => _query.GetState());
+            StringAssert.StartsWith("Shard ", exception.Message);
+            Assert.Throws<Js1Exception>(() => Push("b", 0, "{}"));
+        }
+
+        [Test]
+        public void compilation_errors_are_reported()
+        {
+            Assert.Throws<Js1Exception>(() => new ShardedQuery(_prelude, "fromAll(", "invalid.js", 2));
+        }
+    }
+}
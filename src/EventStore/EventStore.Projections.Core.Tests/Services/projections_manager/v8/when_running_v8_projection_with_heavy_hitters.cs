@@ -0,0 +1,102 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_v8_projection_with_heavy_hitters : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { sketch: new CountMinSketch(), small: new CountMinSketch(4, 2), top: new TopK(2) };
+                    },
+                    type1: function(state, event) {
+                        state.sketch.add(event.body.product);
+                        state.small.add(event.body.product);
+                        state.top.add(event.body.product);
+                        log(state.sketch.estimate(event.body.product) + ' ' + JSON.stringify(state.top.top(1)));
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private string ProcessProduct(int sequenceNumber, string product)
+        {
+            return ProcessEvent(sequenceNumber, @"{""product"":""" + product + @"""}");
+        }
+
+        [Test]
+        public void the_most_frequent_value_is_reported()
+        {
+            ProcessProduct(0, "a");
+            ProcessProduct(1, "b");
+            ProcessProduct(2, "a");
+            ProcessProduct(3, "c");
+            Assert.AreEqual(4, _logged.Count);
+            Assert.AreEqual(@"2 [{""value"":""a"",""count"":2,""error"":0}]", _logged[2]);
+            Assert.AreEqual(@"1 [{""value"":""a"",""count"":2,""error"":0}]", _logged[3]);
+        }
+
+        [Test]
+        public void the_counters_are_revived_when_the_state_is_loaded()
+        {
+            ProcessProduct(0, "a");
+            var state = ProcessProduct(1, "a");
+            StringAssert.Contains(@"""$type"":""CountMinSketch""", state);
+            StringAssert.Contains(@"""$type"":""TopK""", state);
+            ReloadState(state);
+            ProcessProduct(2, "a");
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(@"3 [{""value"":""a"",""count"":3,""error"":0}]", _logged[0]);
+        }
+
+        [Test]
+        public void a_mostly_empty_sketch_is_stored_compactly()
+        {
+            var state = ProcessProduct(0, "a");
+            // the 2048 x 4 counters take at least 8KB when written densely
+            Assert.Less(state.Length, 1024);
+        }
+
+        [Test]
+        public void sparse_and_dense_sketches_are_stored_without_loss()
+        {
+            string state = null;
+            for (var i = 0; i < 8; i++)
+                state = ProcessProduct(i, "product-" + i);
+            ReloadState(state);
+            Assert.AreEqual(state, GetQuery().GetState());
+        }
+    }
+}
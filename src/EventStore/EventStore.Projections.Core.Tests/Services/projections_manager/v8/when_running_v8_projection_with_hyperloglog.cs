@@ -0,0 +1,89 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_v8_projection_with_hyperloglog : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { users: new HyperLogLog() };
+                    },
+                    type1: function(state, event) {
+                        state.users.add(event.body.user);
+                        log(state.users.estimate());
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private string ProcessUser(int sequenceNumber, string user)
+        {
+            return ProcessEvent(sequenceNumber, @"{""user"":""" + user + @"""}");
+        }
+
+        [Test]
+        public void distinct_values_are_counted()
+        {
+            ProcessUser(0, "a");
+            ProcessUser(1, "b");
+            ProcessUser(2, "a");
+            Assert.AreEqual(3, _logged.Count);
+            Assert.AreEqual(@"1", _logged[0]);
+            Assert.AreEqual(@"2", _logged[1]);
+            Assert.AreEqual(@"2", _logged[2]);
+        }
+
+        [Test]
+        public void the_counter_is_stored_in_the_state()
+        {
+            var state = ProcessUser(0, "a");
+            StringAssert.Contains(@"""$type"":""HyperLogLog""", state);
+        }
+
+        [Test]
+        public void the_counter_is_revived_when_the_state_is_loaded()
+        {
+            ProcessUser(0, "a");
+            var state = ProcessUser(1, "b");
+            ReloadState(state);
+            ProcessUser(2, "a");
+            ProcessUser(3, "c");
+            Assert.AreEqual(2, _logged.Count);
+            Assert.AreEqual(@"2", _logged[0]);
+            Assert.AreEqual(@"3", _logged[1]);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_v8_projection_with_tdigest : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { latency: new TDigest() };
+                    },
+                    type1: function(state, event) {
+                        state.latency.add(event.body.ms);
+                        log(state.latency.quantile(0.5));
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private string ProcessLatency(int sequenceNumber, int ms)
+        {
+            return ProcessEvent(sequenceNumber, @"{""ms"":" + ms + @"}");
+        }
+
+        [Test]
+        public void the_median_is_interpolated_between_samples()
+        {
+            for (var i = 0; i < 5; i++)
+                ProcessLatency(i, (i + 1) * 10);
+            Assert.AreEqual(new[] {"10", "15", "20", "25", "30"}, _logged.ToArray());
+        }
+
+        [Test]
+        public void the_digest_is_revived_when_the_state_is_loaded()
+        {
+            ProcessLatency(0, 10);
+            ProcessLatency(1, 20);
+            var state = ProcessLatency(2, 30);
+            StringAssert.Contains(@"""$type"":""TDigest""", state);
+            ReloadState(state);
+            ProcessLatency(3, 40);
+            ProcessLatency(4, 50);
+            Assert.AreEqual(new[] {"25", "30"}, _logged.ToArray());
+        }
+    }
+}
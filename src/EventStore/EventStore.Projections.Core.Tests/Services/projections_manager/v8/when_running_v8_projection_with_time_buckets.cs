@@ -0,0 +1,104 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_v8_projection_with_time_buckets : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { };
+                    },
+                    type1: function(state, event) {
+                        if (event.body.throwingGranularity) {
+                            try {
+                                timeBucket(0, { toString: function() { throw 'no granularity'; } });
+                            } catch (e) {
+                                log('caught ' + e);
+                            }
+                            return state;
+                        }
+                        var timestamp = parseTimestamp(event.body.at);
+                        if (timestamp === null) {
+                            log('invalid');
+                            return state;
+                        }
+                        log(timestamp + ' ' + timeBucket(event.body.at, 'minute') + ' ' + timeBucket(timestamp, 'day'));
+                        var hour = timeBucket(timestamp, 'hour');
+                        state[hour] = (state[hour] || 0) + 1;
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private string ProcessAt(int sequenceNumber, string at)
+        {
+            return ProcessEvent(sequenceNumber, @"{""at"":""" + at + @"""}");
+        }
+
+        [Test]
+        public void timestamps_are_parsed_to_epoch_milliseconds_and_bucketed()
+        {
+            ProcessAt(0, "2013-01-31T14:05:09.123Z");
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(@"1359641109123 2013-01-31T14:05 2013-01-31", _logged[0]);
+        }
+
+        [Test]
+        public void offsets_are_applied_before_bucketing()
+        {
+            ProcessAt(0, "2013-01-31T14:05:09Z");
+            ProcessAt(1, "2013-01-31T16:59:00+02:00");
+            var state = ProcessAt(2, "2013-01-31T15:00:00Z");
+            Assert.AreEqual(@"{""2013-01-31T14"":2,""2013-01-31T15"":1}", state);
+        }
+
+        [Test]
+        public void invalid_timestamps_are_parsed_to_null()
+        {
+            ProcessAt(0, "2013-02-29T00:00:00Z");
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(@"invalid", _logged[0]);
+        }
+
+        [Test]
+        public void an_exception_converting_the_granularity_reaches_the_script()
+        {
+            ProcessEvent(0, @"{""throwingGranularity"":true}");
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(@"caught no granularity", _logged[0]);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_running_v8_projection_with_time_windows : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { lastThreeMinutes: new SlidingWindow(180000, 60000), minutes: new TumblingWindow(60000) };
+                    },
+                    type1: function(state, event) {
+                        state.lastThreeMinutes.add(event.body.ts);
+                        state.minutes.add(event.body.ts);
+                        log(state.lastThreeMinutes.count() + ' ' + JSON.stringify(state.minutes.closed()));
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private string ProcessAt(int sequenceNumber, long timestamp)
+        {
+            return ProcessEvent(sequenceNumber, @"{""ts"":" + timestamp + @"}");
+        }
+
+        [Test]
+        public void windows_advance_with_event_timestamps()
+        {
+            ProcessAt(0, 0);
+            ProcessAt(1, 30000);
+            ProcessAt(2, 60000);
+            ProcessAt(3, 200000);
+            Assert.AreEqual(4, _logged.Count);
+            Assert.AreEqual(@"1 []", _logged[0]);
+            Assert.AreEqual(@"2 []", _logged[1]);
+            Assert.AreEqual(@"3 [{""start"":0,""count"":2,""sum"":2}]", _logged[2]);
+            Assert.AreEqual(
+                @"2 [{""start"":60000,""count"":1,""sum"":1},{""start"":120000,""count"":0,""sum"":0}]", _logged[3]);
+        }
+
+        [Test]
+        public void the_windows_are_revived_when_the_state_is_loaded()
+        {
+            ProcessAt(0, 0);
+            var state = ProcessAt(1, 30000);
+            StringAssert.Contains(@"""$type"":""SlidingWindow""", state);
+            StringAssert.Contains(@"""$type"":""TumblingWindow""", state);
+            ReloadState(state);
+            ProcessAt(2, 60000);
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(@"3 [{""start"":0,""count"":2,""sum"":2}]", _logged[0]);
+        }
+
+        [Test]
+        public void a_window_closed_past_the_history_is_kept_when_the_state_is_loaded()
+        {
+            ProcessAt(0, 0);
+            ProcessAt(1, 60000);
+            var state = ProcessAt(2, 200000);
+            ReloadState(state);
+            ProcessAt(3, 210000);
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual(
+                @"3 [{""start"":60000,""count"":1,""sum"":1},{""start"":120000,""count"":0,""sum"":0}]", _logged[0]);
+        }
+    }
+}
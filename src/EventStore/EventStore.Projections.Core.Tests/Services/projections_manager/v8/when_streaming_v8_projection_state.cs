@@ -0,0 +1,145 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_streaming_v8_projection_state : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { names: [], flag: new Boolean(false), total: 0 };
+                    },
+                    type1: function(state, event) {
+                        state.names.push(event.body.name);
+                        state.total += 1.5;
+                        return state;
+                    },
+                    type2: function(state, event) {
+                        log(String(state.x));
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private List<byte[]> WriteState(QueryScript query, int chunkSize)
+        {
+            var chunks = new List<byte[]>();
+            query.WriteState(chunkSize, chunks.Add);
+            return chunks;
+        }
+
+        private static string Concat(List<byte[]> chunks)
+        {
+            var all = new MemoryStream();
+            foreach (var chunk in chunks)
+                all.Write(chunk, 0, chunk.Length);
+            return Encoding.UTF8.GetString(all.ToArray());
+        }
+
+        [Test]
+        public void the_written_state_is_the_json_state()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, "{\"name\":\"ab\u017e\"}");
+            var state = ProcessEvent(1, @"{""name"":""cd""}");
+            Assert.AreEqual(state, Concat(WriteState(query, 1024)));
+        }
+
+        [Test]
+        public void boolean_objects_are_written_as_their_value()
+        {
+            var query = GetQuery();
+            StringAssert.Contains(@"""flag"":false", Concat(WriteState(query, 1024)));
+        }
+
+        [Test]
+        public void chunks_do_not_exceed_the_chunk_size()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""name"":""a long name which does not fit into a single chunk""}");
+            var state = ProcessEvent(1, "{\"name\":\"\u017e\u017e\u017e\"}");
+            var chunks = WriteState(query, 7);
+            Assert.Greater(chunks.Count, 1);
+            foreach (var chunk in chunks)
+                Assert.LessOrEqual(chunk.Length, 7);
+            Assert.AreEqual(state, Concat(chunks));
+        }
+
+        [Test]
+        public void numbers_are_written_as_json_stringify_writes_them()
+        {
+            var query = GetQuery();
+            const string numbers =
+                "[0.000001,-0.0000015,1e-7,1.2e-7,1e+21,1000000000000000.5,123456789012345680000,5e-324," +
+                "0.30000000000000004,1.7976931348623157e+308,-0]";
+            query.SetState(@"{""total"":" + numbers + "}");
+            Assert.AreEqual(
+                @"{""total"":" + numbers.Replace("-0]", "0]") + "}", Concat(WriteState(query, 1024)));
+        }
+
+        [Test]
+        public void a_state_loaded_in_chunks_is_restored()
+        {
+            var query = GetQuery();
+            var json = "{\"names\":[\"a\u017eb\",\"c\"],\"flag\":true,\"total\":-1.25e2}";
+            query.LoadState(new MemoryStream(Encoding.UTF8.GetBytes(json)), 1);
+            Assert.AreEqual("{\"names\":[\"a\u017eb\",\"c\"],\"flag\":true,\"total\":-125}", query.GetState());
+        }
+
+        [Test]
+        public void numbers_outside_of_the_json_grammar_are_rejected()
+        {
+            var query = GetQuery();
+            foreach (var number in new[] {"01", "1.", "-", "1e", "1e+", "-.5", "1.e3"})
+                Assert.Throws<Js1Exception>(
+                    () => query.LoadState(new MemoryStream(Encoding.UTF8.GetBytes(@"{""total"":" + number + "}")), 1024),
+                    number);
+        }
+
+        [Test]
+        public void a_proto_key_does_not_replace_the_prototype()
+        {
+            var query = GetQuery();
+            query.LoadState(new MemoryStream(Encoding.UTF8.GetBytes(@"{""__proto__"":{""x"":1}}")), 1024);
+            ProcessEvent(0, "stream1", "type2", "{}");
+            Assert.AreEqual(1, _logged.Count);
+            Assert.AreEqual("undefined", _logged[0]);
+        }
+    }
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System;
+using System.IO;
+using System.Text.RegularExpressions;
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_switching_v8_projection_partitions : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().foreachStream().when({
+                    $init: function() {
+                        return { count: 0 };
+                    },
+                    type1: function(state, event) {
+                        state.count++;
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        private static long GetStatistic(QueryScript query, string name)
+        {
+            var match = Regex.Match(query.GetPartitionStoreStatistics(), @"""" + name + @""":(\d+)");
+            Assert.IsTrue(match.Success, name);
+            return long.Parse(match.Groups[1].Value);
+        }
+
+        private void ProcessEvents(QueryScript query, string partition, int count)
+        {
+            query.SelectPartition(partition);
+            for (var i = 0; i < count; i++)
+                ProcessEvent(i, partition, "type1", "{}");
+        }
+
+        [Test]
+        public void a_new_partition_starts_from_the_initial_state()
+        {
+            var query = GetQuery();
+            ProcessEvents(query, "a", 2);
+            Assert.IsFalse(query.SelectPartition("b"));
+            Assert.AreEqual(@"{""count"":0}", query.GetState());
+            ProcessEvent(0, "b", "type1", "{}");
+            Assert.IsTrue(query.SelectPartition("a"));
+            Assert.AreEqual(@"{""count"":2}", query.GetState());
+        }
+
+        [Test]
+        public void evicted_partitions_are_restored()
+        {
+            var query = GetQuery();
+            query.ConfigurePartitionStore(1, long.MaxValue, null);
+            ProcessEvents(query, "a", 1);
+            ProcessEvents(query, "b", 2);
+            ProcessEvents(query, "c", 3);
+            Assert.IsTrue(query.SelectPartition("a"));
+            Assert.AreEqual(@"{""count"":1}", query.GetState());
+            Assert.IsTrue(query.SelectPartition("b"));
+            Assert.AreEqual(@"{""count"":2}", query.GetState());
+            Assert.Greater(GetStatistic(query, "evictions"), 0);
+            Assert.Greater(GetStatistic(query, "loads"), 0);
+        }
+
+        [Test]
+        public void spilled_partitions_are_restored()
+        {
+            var query = GetQuery();
+            var spillFileName = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".spill");
+            try
+            {
+                query.ConfigurePartitionStore(1, 0, spillFileName);
+                for (var i = 0; i < 10; i++)
+                    ProcessEvents(query, "partition-" + i, i + 1);
+                Assert.AreEqual(8, GetStatistic(query, "spills"));
+                for (var i = 0; i < 10; i++)
+                {
+                    Assert.IsTrue(query.SelectPartition("partition-" + i));
+                    Assert.AreEqual(@"{""count"":" + (i + 1) + "}", query.GetState());
+                }
+            }
+            finally
+            {
+                query.ClearPartitionStore();
+                query.ConfigurePartitionStore(1, 0, null);
+                File.Delete(spillFileName);
+            }
+        }
+
+        [Test]
+        public void a_failed_spill_keeps_the_current_partition()
+        {
+            var query = GetQuery();
+            var spillFileName = Path.Combine(Path.Combine(Path.GetTempPath(), Guid.NewGuid().ToString()), "spill");
+            query.ConfigurePartitionStore(1, 0, spillFileName);
+            ProcessEvents(query, "a", 1);
+            ProcessEvents(query, "b", 2);
+            Assert.Throws<Js1Exception>(() => query.SelectPartition("a"));
+            Assert.AreEqual(@"{""count"":2}", query.GetState());
+
+            ProcessEvent(2, "b", "type1", "{}");
+            query.ConfigurePartitionStore(1, 0, null);
+            Assert.IsTrue(query.SelectPartition("a"));
+            Assert.AreEqual(@"{""count"":1}", query.GetState());
+            Assert.IsTrue(query.SelectPartition("b"));
+            Assert.AreEqual(@"{""count"":3}", query.GetState());
+        }
+
+        [Test]
+        public void a_new_partition_selected_while_spilling_fails_can_be_selected_later()
+        {
+            var query = GetQuery();
+            var failingFileName = Path.Combine(Path.Combine(Path.GetTempPath(), Guid.NewGuid().ToString()), "spill");
+            var spillFileName = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".spill");
+            try
+            {
+                query.ConfigurePartitionStore(1, 0, failingFileName);
+                ProcessEvents(query, "a", 1);
+                ProcessEvents(query, "b", 2);
+                Assert.Throws<Js1Exception>(() => query.SelectPartition("c"));
+                Assert.AreEqual(@"{""count"":2}", query.GetState());
+
+                query.ConfigurePartitionStore(1, 0, spillFileName);
+                Assert.IsFalse(query.SelectPartition("c"));
+                Assert.AreEqual(@"{""count"":0}", query.GetState());
+                ProcessEvent(0, "c", "type1", "{}");
+                Assert.IsTrue(query.SelectPartition("a"));
+                Assert.AreEqual(@"{""count"":1}", query.GetState());
+                Assert.IsTrue(query.SelectPartition("c"));
+                Assert.AreEqual(@"{""count"":1}", query.GetState());
+                Assert.IsTrue(query.SelectPartition("b"));
+                Assert.AreEqual(@"{""count"":2}", query.GetState());
+            }
+            finally
+            {
+                query.ClearPartitionStore();
+                query.ConfigurePartitionStore(1, 0, null);
+                File.Delete(spillFileName);
+            }
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System.Diagnostics;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_ticking_an_idle_v8_projection : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return { items: [] };
+                    },
+                    type1: function(state, event) {
+                        for (var i = 0; i < 1000; i++)
+                            state.items.push({ index: i, text: 'item ' + i });
+                        state.items = [];
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        [Test]
+        public void the_policy_is_applied_once_the_projection_has_been_idle_long_enough()
+        {
+            var query = GetQuery();
+            query.SetIdleGcPolicy(60000, 10, false);
+            ProcessEvent(0, "{}");
+            Assert.IsFalse(query.IdleTick());
+            query.SetIdleGcPolicy(0, 10, false);
+            Assert.IsTrue(query.IdleTick());
+        }
+
+        [Test]
+        public void a_completed_checkpoint_gives_a_single_idle_notification()
+        {
+            var query = GetQuery();
+            query.SetIdleGcPolicy(-1, 10, true);
+            ProcessEvent(0, "{}");
+            Assert.IsFalse(query.IdleTick());
+            query.NotifyCheckpoint();
+            Assert.IsTrue(query.IdleTick());
+            Assert.IsFalse(query.IdleTick());
+        }
+
+        [Test]
+        public void an_idle_tick_stops_at_the_deadline()
+        {
+            var query = GetQuery();
+            for (var i = 0; i < 10; i++)
+                ProcessEvent(i, "{}");
+            query.SetIdleGcPolicy(0, 50, false);
+            var stopwatch = Stopwatch.StartNew();
+            Assert.IsTrue(query.IdleTick());
+            // a single notification may overrun the deadline, but no new one is started after it
+            Assert.Less(stopwatch.ElapsedMilliseconds, 1000);
+        }
+
+        [Test]
+        public void no_idle_notification_is_given_without_a_policy()
+        {
+            var query = GetQuery();
+            query.SetIdleGcPolicy(-1, 0, false);
+            query.NotifyCheckpoint();
+            Assert.IsFalse(query.IdleTick());
+        }
+    }
+}
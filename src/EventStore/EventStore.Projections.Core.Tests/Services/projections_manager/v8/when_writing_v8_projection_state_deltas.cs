@@ -0,0 +1,109 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using EventStore.Projections.Core.v8;
+using NUnit.Framework;
+
+namespace EventStore.Projections.Core.Tests.Services.projections_manager.v8
+{
+    [TestFixture]
+    public class when_writing_v8_projection_state_deltas : TestFixtureWithJsProjection
+    {
+        protected override void Given()
+        {
+            _projection = @"
+                fromAll().when({
+                    $init: function() {
+                        return {};
+                    },
+                    type1: function(state, event) {
+                        state[event.body.key] = (state[event.body.key] || 0) + 1;
+                        return state;
+                    }
+                });
+            ";
+        }
+
+        [Test]
+        public void the_first_checkpoint_is_a_full_snapshot()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""key"":""a""}");
+            var delta = query.GetStateDelta(false, 0);
+            StringAssert.StartsWith(@"{""full"":true", delta);
+            StringAssert.Contains(@"""state"":{""a"":1}", delta);
+        }
+
+        [Test]
+        public void later_checkpoints_contain_changed_keys_only()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""key"":""a""}");
+            ProcessEvent(1, @"{""key"":""b""}");
+            query.GetStateDelta(false, 0);
+            ProcessEvent(2, @"{""key"":""a""}");
+            var delta = query.GetStateDelta(false, 0);
+            StringAssert.StartsWith(@"{""full"":false", delta);
+            StringAssert.Contains(@"""set"":{""a"":2}", delta);
+            StringAssert.DoesNotContain(@"""b""", delta);
+        }
+
+        [Test]
+        public void applying_the_snapshot_and_the_delta_restores_the_state()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""key"":""a""}");
+            ProcessEvent(1, @"{""key"":""b""}");
+            var full = query.GetStateDelta(false, 0);
+            ProcessEvent(2, @"{""key"":""a""}");
+            var expected = ProcessEvent(3, @"{""key"":""c""}");
+            var delta = query.GetStateDelta(false, 0);
+
+            _stateHandler.Initialize();
+            query.ApplyStateDelta(full);
+            query.ApplyStateDelta(delta);
+            Assert.AreEqual(expected, query.GetState());
+        }
+
+        [Test]
+        public void a_delta_not_following_the_applied_state_is_rejected()
+        {
+            var query = GetQuery();
+            ProcessEvent(0, @"{""key"":""a""}");
+            var full = query.GetStateDelta(false, 0);
+            ProcessEvent(1, @"{""key"":""a""}");
+            query.GetStateDelta(false, 0);
+            ProcessEvent(2, @"{""key"":""a""}");
+            var skipped = query.GetStateDelta(false, 0);
+
+            _stateHandler.Initialize();
+            query.ApplyStateDelta(full);
+            Assert.Throws<Js1Exception>(() => query.ApplyStateDelta(skipped));
+        }
+    }
+}
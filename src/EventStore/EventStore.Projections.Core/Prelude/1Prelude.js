@@ -3,9 +3,44 @@
 // they are redefined here to make R# like tools understand them
 var _log = $log;
 var _load_module = $load_module;
+var _HyperLogLog = $HyperLogLog;
+var _CountMinSketch = $CountMinSketch;
+var _TopK = $TopK;
+var _TDigest = $TDigest;
+var _SlidingWindow = $SlidingWindow;
+var _TumblingWindow = $TumblingWindow;
+var _parseTimestamp = $parseTimestamp;
+var _timeBucket = $timeBucket;
+
+// native objects serialize themselves as { $type: name, data: ... } and are revived by name
+var nativeTypes = {
+    HyperLogLog: _HyperLogLog,
+    CountMinSketch: _CountMinSketch,
+    TopK: _TopK,
+    TDigest: _TDigest,
+    SlidingWindow: _SlidingWindow,
+    TumblingWindow: _TumblingWindow
+};
+
+function reviveNative(key, value) {
+    if (value !== null && typeof value === "object" && typeof value.$type === "string" && nativeTypes.hasOwnProperty(value.$type))
+        return new nativeTypes[value.$type](value);
+    return value;
+}
+
+function reviveNatives(value) {
+    if (value === null || typeof value !== "object")
+        return value;
+    for (var name in value) {
+        if (value.hasOwnProperty(name))
+            value[name] = reviveNatives(value[name]);
+    }
+    return reviveNative(null, value);
+}
 
-function log(message) {
-    _log("P: " + message);
+// level: 0 - debug, 1 - info (default), 2 - warning, 3 - error
+function log(message, level) {
+    _log("P: " + message, level);
 }
 
 function initializeModules() {
@@ -44,7 +79,7 @@ function scope($on, $notify) {
             }, 
         
             set_state: function(json) {
-                var projectionState = JSON.parse(json);
+                var projectionState = json.indexOf('"$type"') < 0 ? JSON.parse(json) : JSON.parse(json, reviveNative);
                 return eventProcessor.commandHandlers.set_state_raw(projectionState);
             }, 
         
@@ -54,6 +89,16 @@ function scope($on, $notify) {
         
             get_sources: function() {
                 return JSON.stringify(eventProcessor.commandHandlers.get_sources_raw());
+            },
+
+            // used by the native state commands only, these return and accept state objects instead of JSON
+            get_state_object: function() {
+                return eventProcessor.commandHandlers.get_state_raw();
+            },
+
+            // revive is set when the state was rebuilt from its serialized form
+            set_state_object: function(state, revive) {
+                return eventProcessor.commandHandlers.set_state_raw(revive ? reviveNatives(state) : state);
             }
     };
 
@@ -68,8 +113,8 @@ function scope($on, $notify) {
     registerCommandHandlers($on);
 
 
-    function queryLog(message) {
-        _log(message);
+    function queryLog(message, level) {
+        _log(message, level);
     }
 
     function translateOn(handlers) {
@@ -183,6 +228,15 @@ function scope($on, $notify) {
         emit: emit, 
         linkTo: linkTo, 
         require: modules.require,
+
+        HyperLogLog: _HyperLogLog,
+        CountMinSketch: _CountMinSketch,
+        TopK: _TopK,
+        TDigest: _TDigest,
+        SlidingWindow: _SlidingWindow,
+        TumblingWindow: _TumblingWindow,
+        parseTimestamp: _parseTimestamp,
+        timeBucket: _timeBucket,
     };
 };
 
@@ -33,6 +33,8 @@ using EventStore.Common.Log;
 using EventStore.Core.Bus;
 using EventStore.Core.Data;
 using EventStore.Core.Messages;
+using EventStore.Core.Messaging;
+using EventStore.Core.Services.TimerService;
 using EventStore.Projections.Core.Messages;
 using EventStore.Projections.Core.Utils;
 
@@ -52,6 +54,7 @@ namespace EventStore.Projections.Core.Services.Processing
         internal const string ProjectionsStreamPrefix = "$projections-";
         private const string ProjectionsStateStreamSuffix = "-state";
         internal const string ProjectionCheckpointStreamSuffix = "-checkpoint";
+        private static readonly TimeSpan IdleTickInterval = TimeSpan.FromSeconds(1);
 
         [Flags]
         private enum State : uint
@@ -81,6 +84,7 @@ namespace EventStore.Projections.Core.Services.Processing
         private readonly ILogger _logger;
 
         private readonly IProjectionStateHandler _projectionStateHandler;
+        private readonly IIdleProjectionStateHandler _idleStateHandler;
         private State _state;
 
         private string _faultedReason;
@@ -103,6 +107,8 @@ namespace EventStore.Projections.Core.Services.Processing
         private long _expectedSubscriptionMessageSequenceNumber = -1;
         private readonly HashSet<Guid> _loadStateRequests = new HashSet<Guid>();
         private bool _subscribed;
+        private bool _idleTickScheduled;
+        private bool _disposed;
 
         public CoreProjection(
             string name, Guid projectionCorrelationId, IPublisher publisher,
@@ -117,6 +123,7 @@ namespace EventStore.Projections.Core.Services.Processing
             if (publisher == null) throw new ArgumentNullException("publisher");
             if (projectionStateHandler == null) throw new ArgumentNullException("projectionStateHandler");
             _projectionStateHandler = projectionStateHandler;
+            _idleStateHandler = projectionStateHandler as IIdleProjectionStateHandler;
             _projectionCorrelationId = projectionCorrelationId;
 
             var namingBuilder = new ProjectionNamesBuilder();
@@ -429,6 +436,7 @@ namespace EventStore.Projections.Core.Services.Processing
             {
                 SetFaulted(ex);
             }
+            EnsureIdleTickScheduled();
         }
 
         private void EnterPaused()
@@ -750,6 +758,7 @@ namespace EventStore.Projections.Core.Services.Processing
 
         public void Dispose()
         {
+            _disposed = true;
             if (_projectionStateHandler != null)
                 _projectionStateHandler.Dispose();
         }
@@ -765,6 +774,35 @@ namespace EventStore.Projections.Core.Services.Processing
             }
         }
 
+        private void EnsureIdleTickScheduled()
+        {
+            if (_idleStateHandler == null || _idleTickScheduled)
+                return;
+            _idleTickScheduled = true;
+            _publisher.Publish(
+                TimerMessage.Schedule.Create(
+                    IdleTickInterval, new PublishEnvelope(_publisher, crossThread: true),
+                    new ProjectionCoreServiceMessage.Tick(IdleTick)));
+        }
+
+        private void IdleTick()
+        {
+            _idleTickScheduled = false;
+            // the handler decides whether the projection has been idle long enough to do anything
+            if (_disposed || (_state != State.Running && _state != State.Paused))
+                return;
+            try
+            {
+                _idleStateHandler.IdleTick();
+            }
+            catch (Exception ex)
+            {
+                SetFaulted(ex);
+                return;
+            }
+            EnsureIdleTickScheduled();
+        }
+
         private void SetFaulted(Exception ex)
         {
             SetFaulted(ex.Message);
@@ -781,6 +819,8 @@ namespace EventStore.Projections.Core.Services.Processing
             // all emitted events caused by events before the checkpoint position have been written  
             // unlock states, so the cache can be clean up as they can now be safely reloaded from the ES
             _partitionStateCache.Unlock(lastCompletedCheckpointPosition);
+            if (_idleStateHandler != null && !_disposed)
+                _idleStateHandler.CheckpointCompleted();
 
             switch (_state)
             {
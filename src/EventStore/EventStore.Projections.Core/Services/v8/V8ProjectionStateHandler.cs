@@ -37,8 +37,12 @@ using EventStore.Projections.Core.v8;
 
 namespace EventStore.Projections.Core.Services.v8
 {
-    public class V8ProjectionStateHandler : IProjectionStateHandler
+    public class V8ProjectionStateHandler : IProjectionStateHandler, IIdleProjectionStateHandler
     {
+        // projections compact their heap after a checkpoint or once no event has arrived for a while
+        private const int IdleGcAfterMs = 5000;
+        private const int IdleGcTimeMs = 10;
+
         private readonly PreludeScript _prelude;
         private readonly QueryScript _query;
         private List<EmittedEvent> _emittedEvents;
@@ -56,6 +60,7 @@ namespace EventStore.Projections.Core.Services.v8
             {
                 query = new QueryScript(prelude, querySource, "POST-BODY");
                 query.Emit += QueryOnEmit;
+                query.SetIdleGcPolicy(IdleGcAfterMs, IdleGcTimeMs, afterCheckpoint: true);
             }
             catch
             {
@@ -160,6 +165,24 @@ namespace EventStore.Projections.Core.Services.v8
             return true;
         }
 
+        public void CheckpointCompleted()
+        {
+            CheckDisposed();
+            _query.NotifyCheckpoint();
+        }
+
+        public void IdleTick()
+        {
+            CheckDisposed();
+            _query.IdleTick();
+        }
+
+        internal QueryScript GetQuery()
+        {
+            CheckDisposed();
+            return _query;
+        }
+
         private void CheckDisposed()
         {
             if (_disposed)
@@ -28,6 +28,7 @@
 
 using System;
 using System.Collections.Generic;
+using System.IO;
 using System.Runtime.InteropServices;
 using System.Runtime.Serialization;
 
@@ -129,6 +130,10 @@ namespace EventStore.Projections.Core.v8
                 case "get_sources":
                     _getSources = () => ExecuteHandler(handlerHandle, "");
                     break;
+                case "get_state_object":
+                case "set_state_object":
+                    // used by the native state commands only
+                    break;
                 default:
                     Console.WriteLine(
                         string.Format("Unknown command handler registered. Command name: {0}", commandName));
@@ -241,6 +246,144 @@ namespace EventStore.Projections.Core.v8
             return _getStatistics();
         }
 
+        // idleAfterMs of -1 disables idle notifications, afterCheckpoint adds one after each NotifyCheckpoint
+        public void SetIdleGcPolicy(int idleAfterMs, int idleTimeMs, bool afterCheckpoint)
+        {
+            Js1.SetIdleGcPolicy(_script.GetHandle(), idleAfterMs, idleTimeMs, afterCheckpoint);
+        }
+
+        public void NotifyCheckpoint()
+        {
+            Js1.NotifyCheckpoint(_script.GetHandle());
+        }
+
+        // returns true if the policy gave V8 an idle notification
+        public bool IdleTick()
+        {
+            return Js1.IdleTick(_script.GetHandle());
+        }
+
+        public void NotifyLowMemory()
+        {
+            Js1.NotifyLowMemory(_script.GetHandle());
+        }
+
+        // per command handler call counts and timings
+        public string GetHandlerStatistics()
+        {
+            string statistics = null;
+            Js1.GetHandlerStatistics(_script.GetHandle(), json => statistics = json);
+            return statistics;
+        }
+
+        public string GetStateDelta(bool full, int fullSnapshotEvery)
+        {
+            string delta = null;
+            CheckSucceeded(
+                Js1.GetStateDelta(_script.GetHandle(), full, fullSnapshotEvery, json => delta = json));
+            return delta;
+        }
+
+        public void ApplyStateDelta(string delta)
+        {
+            CheckSucceeded(Js1.ApplyStateDelta(_script.GetHandle(), delta));
+        }
+
+        // chunks are UTF-8 JSON of at most chunkSize bytes, a chunk may end within a character
+        public void WriteState(int chunkSize, Action<byte[]> writeChunk)
+        {
+            WriteChunks(callback => Js1.WriteState(_script.GetHandle(), chunkSize, callback), writeChunk);
+        }
+
+        // chunks are parts of the compact binary encoding of the state, pass them to ImportState joined
+        public void ExportState(int chunkSize, Action<byte[]> writeChunk)
+        {
+            WriteChunks(callback => Js1.ExportState(_script.GetHandle(), chunkSize, callback), writeChunk);
+        }
+
+        public void ImportState(byte[] data)
+        {
+            CheckSucceeded(Js1.ImportState(_script.GetHandle(), data, data.Length));
+        }
+
+        // path is a top-level key or a JSON pointer such as "/customers/42/total"
+        public string GetStateAt(string path)
+        {
+            string json = null;
+            CheckSucceeded(Js1.GetStateAt(_script.GetHandle(), path, state => json = state));
+            return json;
+        }
+
+        // spillFileName may be null to keep serialized partitions in memory
+        public void ConfigurePartitionStore(int maxMaterialized, long maxResidentBytes, string spillFileName)
+        {
+            CheckSucceeded(
+                Js1.ConfigurePartitionStore(_script.GetHandle(), maxMaterialized, maxResidentBytes, spillFileName));
+        }
+
+        // returns false for a partition seen for the first time, its state is then initialized by $init
+        public bool SelectPartition(string partition)
+        {
+            int result = Js1.SelectPartition(_script.GetHandle(), partition);
+            CheckSucceeded(result >= 0);
+            return result > 0;
+        }
+
+        public void ClearPartitionStore()
+        {
+            Js1.ClearPartitionStore(_script.GetHandle());
+        }
+
+        public string GetPartitionStoreStatistics()
+        {
+            string statistics = null;
+            Js1.GetPartitionStoreStatistics(_script.GetHandle(), json => statistics = json);
+            return statistics;
+        }
+
+        private void WriteChunks(Func<Js1.WriteChunkDelegate, bool> write, Action<byte[]> writeChunk)
+        {
+            Exception writeException = null;
+            bool written = write(
+                (data, length) =>
+                    {
+                        //NOTE: do not let exceptions through the native code
+                        try
+                        {
+                            var chunk = new byte[length];
+                            Marshal.Copy(data, chunk, 0, length);
+                            writeChunk(chunk);
+                            return true;
+                        }
+                        catch (Exception ex)
+                        {
+                            writeException = ex;
+                            return false;
+                        }
+                    });
+            if (writeException != null)
+                throw writeException;
+            CheckSucceeded(written);
+        }
+
+        public void LoadState(Stream utf8Json, int chunkSize)
+        {
+            var chunk = new byte[chunkSize];
+            Js1.BeginStateLoad(_script.GetHandle());
+            int read;
+            while ((read = utf8Json.Read(chunk, 0, chunk.Length)) > 0)
+                CheckSucceeded(Js1.AppendStateChunk(_script.GetHandle(), chunk, read));
+            CheckSucceeded(Js1.EndStateLoad(_script.GetHandle()));
+        }
+
+        private void CheckSucceeded(bool succeeded)
+        {
+            if (succeeded)
+                return;
+            CompiledScript.CheckResult(_script.GetHandle(), disposeScriptOnException: false);
+            throw new InvalidOperationException("Native state command failed");
+        }
+
         public QuerySourcesDefinition GetSourcesDefintion()
         {
             return _sources;
@@ -0,0 +1,150 @@
+// Copyright (c) 2012, Event Store LLP
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+// Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// Neither the name of the Event Store LLP nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+using System;
+using System.Threading;
+
+namespace EventStore.Projections.Core.v8
+{
+    // runs a by-stream query in shardCount isolates on native threads, events of one partition 
+    // are always processed by the same shard
+    class ShardedQuery : IDisposable
+    {
+        private IntPtr _handle;
+
+        // the delegate must be kept alive while used by unmanaged code
+        private readonly Js1.ReverseCommandHandlerDelegate _reverseCommandHandlerDelegate; // do not inline
+        private Exception _reverseCommandHandlerException;
+
+        // raised on the shard threads, one call at a time
+        public event Action<string> Emit;
+
+        public ShardedQuery(PreludeScript prelude, string script, string fileName, int shardCount)
+        {
+            _reverseCommandHandlerDelegate = ReverseCommandHandler;
+            _handle = Js1.CompileShardedQuery(
+                prelude.GetHandle(), script, fileName, shardCount, _reverseCommandHandlerDelegate);
+            try
+            {
+                CheckSucceeded(true);
+            }
+            catch
+            {
+                Dispose();
+                throw;
+            }
+        }
+
+        private void ReverseCommandHandler(string commandName, string commandBody)
+        {
+            try
+            {
+                switch (commandName)
+                {
+                    case "emit":
+                        Action<string> handler = Emit;
+                        if (handler != null) handler(commandBody);
+                        break;
+                    default:
+                        Console.WriteLine("Ignoring unknown reverse command: '{0}'", commandName);
+                        break;
+                }
+            }
+            catch (Exception ex)
+            {
+                // report only the first exception occured in reverse command handler
+                Interlocked.CompareExchange(ref _reverseCommandHandlerException, ex, null);
+            }
+        }
+
+        // queues the event, errors of queued events are reported by the following calls
+        public void Push(string partition, string json, string[] other)
+        {
+            CheckSucceeded(
+                Js1.ShardedProcessEvent(_handle, partition, json, other, other != null ? other.Length : 0));
+        }
+
+        // waits for the queued events and removes the states of all the partitions
+        public void Initialize()
+        {
+            CheckSucceeded(Js1.ShardedInitialize(_handle));
+        }
+
+        // waits for the queued events, the state is a JSON object keyed by partition
+        public string GetState()
+        {
+            string state = null;
+            CheckSucceeded(Js1.ShardedGetState(_handle, json => state = json));
+            return state;
+        }
+
+        public void SetState(string state)
+        {
+            CheckSucceeded(Js1.ShardedSetState(_handle, state));
+        }
+
+        public string GetStatistics()
+        {
+            string statistics = null;
+            Js1.GetShardedQueryStatistics(_handle, json => statistics = json);
+            return statistics;
+        }
+
+        private void CheckSucceeded(bool succeeded)
+        {
+            int? errorCode = null;
+            string errorMessage = null;
+            Js1.ShardedReportErrors(
+                _handle, (code, message) =>
+                    {
+                        //NOTE: do not throw exceptions directly in this handler
+                        errorCode = code;
+                        errorMessage = message;
+                    });
+            if (errorCode != null)
+                throw new Js1Exception(errorCode.Value, errorMessage);
+            var reverseCommandHandlerException = _reverseCommandHandlerException;
+            if (reverseCommandHandlerException != null)
+            {
+                throw new ApplicationException(
+                    "An exception occurred while executing a reverse command handler. " + reverseCommandHandlerException.Message,
+                    reverseCommandHandlerException);
+            }
+            if (!succeeded)
+                throw new InvalidOperationException("Sharded query command failed");
+        }
+
+        public void Dispose()
+        {
+            if (_handle == IntPtr.Zero)
+                return;
+            Js1.DisposeShardedQuery(_handle);
+            _handle = IntPtr.Zero;
+        }
+    }
+}
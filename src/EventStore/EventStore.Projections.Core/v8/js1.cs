@@ -46,6 +46,11 @@ namespace EventStore.Projections.Core.v8
 
         public delegate void ReportErrorDelegate(int erroe_code, [MarshalAs(UnmanagedType.LPWStr)] string error_message);
 
+        public delegate void ReportStatisticsDelegate([MarshalAs(UnmanagedType.LPWStr)] string statisticsJson);
+
+        [return: MarshalAs(UnmanagedType.I1)]
+        public delegate bool WriteChunkDelegate(IntPtr data, int length);
+
 
         [DllImport("js1", EntryPoint = "js1_api_version")]
         public static extern IntPtr ApiVersion();
@@ -83,5 +88,194 @@ namespace EventStore.Projections.Core.v8
         [DllImport("js1", EntryPoint = "report_errors")]
         public static extern void ReportErrors(IntPtr scriptHandle, ReportErrorDelegate reportErrorCallback);
 
+        [DllImport("js1", EntryPoint = "notify_idle")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool NotifyIdle(IntPtr scriptHandle, int idleTimeMs);
+
+        [DllImport("js1", EntryPoint = "notify_low_memory")]
+        public static extern void NotifyLowMemory(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "set_idle_gc_policy")]
+        public static extern void SetIdleGcPolicy(
+            IntPtr scriptHandle, int idleAfterMs, int idleTimeMs, [MarshalAs(UnmanagedType.I1)] bool afterCheckpoint);
+
+        [DllImport("js1", EntryPoint = "notify_checkpoint")]
+        public static extern void NotifyCheckpoint(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "idle_tick")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool IdleTick(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "get_gc_statistics")]
+        public static extern void GetGcStatistics(IntPtr scriptHandle, ReportStatisticsDelegate reportStatisticsCallback);
+
+        [DllImport("js1", EntryPoint = "reset_gc_statistics")]
+        public static extern void ResetGcStatistics(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "get_handler_statistics")]
+        public static extern void GetHandlerStatistics(IntPtr scriptHandle, ReportStatisticsDelegate reportStatisticsCallback);
+
+        [DllImport("js1", EntryPoint = "reset_handler_statistics")]
+        public static extern void ResetHandlerStatistics(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "enable_v8_counters")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool EnableV8Counters([MarshalAs(UnmanagedType.LPWStr)] string mapFileName);
+
+        [DllImport("js1", EntryPoint = "get_v8_counters")]
+        public static extern void GetV8Counters(ReportStatisticsDelegate reportStatisticsCallback);
+
+        [DllImport("js1", EntryPoint = "start_cpu_profiling")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool StartCpuProfiling(
+            IntPtr scriptHandle, [MarshalAs(UnmanagedType.LPWStr)] string title, int maxDurationMs);
+
+        // format: 0 - Chrome .cpuprofile JSON, 1 - folded stacks
+        [DllImport("js1", EntryPoint = "take_cpu_profile")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool TakeCpuProfile(
+            IntPtr scriptHandle, int format, ReportStatisticsDelegate reportProfileCallback);
+
+        [DllImport("js1", EntryPoint = "write_heap_snapshot")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool WriteHeapSnapshot(IntPtr scriptHandle, [MarshalAs(UnmanagedType.LPWStr)] string fileName);
+
+        // topCount of 0 reports heap totals only, any other value takes a full heap snapshot
+        [DllImport("js1", EntryPoint = "get_heap_summary")]
+        public static extern void GetHeapSummary(
+            IntPtr scriptHandle, int topCount, ReportStatisticsDelegate reportStatisticsCallback);
+
+        [DllImport("js1", EntryPoint = "enable_perf_map")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool EnablePerfMap([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        // maxFileSize of 0 disables rotation
+        [DllImport("js1", EntryPoint = "start_capture")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool StartCapture(
+            [MarshalAs(UnmanagedType.LPWStr)] string fileName, long maxFileSize, int maxFiles);
+
+        // returns false if the capture has been ended early by a write failure
+        [DllImport("js1", EntryPoint = "stop_capture")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool StopCapture();
+
+        [DllImport("js1", EntryPoint = "start_trace")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool StartTrace([MarshalAs(UnmanagedType.LPWStr)] string fileName);
+
+        [DllImport("js1", EntryPoint = "stop_trace")]
+        public static extern void StopTrace();
+
+        // level: 0 - debug, 1 - info (default), 2 - warning, 3 - error, 4 - none; returns false for any other level
+        [DllImport("js1", EntryPoint = "set_log_level")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool SetLogLevel(int level);
+
+        // in asynchronous mode the log handler is called on a native background thread
+        [DllImport("js1", EntryPoint = "set_asynchronous_logging")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool SetAsynchronousLogging([MarshalAs(UnmanagedType.I1)] bool asynchronous, int capacity);
+
+        [DllImport("js1", EntryPoint = "get_dropped_log_messages")]
+        public static extern long GetDroppedLogMessages();
+
+        // full forces a full snapshot, fullSnapshotEvery of 0 writes deltas only until forced
+        [DllImport("js1", EntryPoint = "get_state_delta")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetStateDelta(
+            IntPtr scriptHandle, [MarshalAs(UnmanagedType.I1)] bool full, int fullSnapshotEvery,
+            ReportStatisticsDelegate reportDeltaCallback);
+
+        [DllImport("js1", EntryPoint = "apply_state_delta")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ApplyStateDelta(IntPtr scriptHandle, [MarshalAs(UnmanagedType.LPWStr)] string deltaJson);
+
+        // return false from the callback to abort
+        [DllImport("js1", EntryPoint = "write_state")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool WriteState(IntPtr scriptHandle, int chunkSize, WriteChunkDelegate writeChunkCallback);
+
+        [DllImport("js1", EntryPoint = "begin_state_load")]
+        public static extern void BeginStateLoad(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "append_state_chunk")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool AppendStateChunk(IntPtr scriptHandle, byte[] data, int length);
+
+        [DllImport("js1", EntryPoint = "end_state_load")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool EndStateLoad(IntPtr scriptHandle);
+
+        // binary snapshot, written in chunks like WriteState
+        [DllImport("js1", EntryPoint = "export_state")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ExportState(IntPtr scriptHandle, int chunkSize, WriteChunkDelegate writeChunkCallback);
+
+        [DllImport("js1", EntryPoint = "import_state")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ImportState(IntPtr scriptHandle, byte[] data, int length);
+
+        // path is a top-level key or a JSON pointer such as "/customers/42/total"
+        [DllImport("js1", EntryPoint = "get_state_at")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetStateAt(
+            IntPtr scriptHandle, [MarshalAs(UnmanagedType.LPWStr)] string path, ReportStatisticsDelegate reportStateCallback);
+
+        // spillFileName may be null to keep serialized partitions in memory
+        [DllImport("js1", EntryPoint = "configure_partition_store")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ConfigurePartitionStore(
+            IntPtr scriptHandle, int maxMaterialized, long maxResidentBytes,
+            [MarshalAs(UnmanagedType.LPWStr)] string spillFileName);
+
+        // returns 1 if the partition state has been restored, 0 for a new partition (initialized by $init) and -1 on error
+        [DllImport("js1", EntryPoint = "select_partition")]
+        public static extern int SelectPartition(IntPtr scriptHandle, [MarshalAs(UnmanagedType.LPWStr)] string partition);
+
+        [DllImport("js1", EntryPoint = "clear_partition_store")]
+        public static extern void ClearPartitionStore(IntPtr scriptHandle);
+
+        [DllImport("js1", EntryPoint = "get_partition_store_statistics")]
+        public static extern void GetPartitionStoreStatistics(
+            IntPtr scriptHandle, ReportStatisticsDelegate reportStatisticsCallback);
+
+        // the query runs in shardCount isolates on their own threads, errors are reported by ShardedReportErrors
+        [DllImport("js1", EntryPoint = "compile_sharded_query")]
+        public static extern IntPtr CompileShardedQuery(
+            IntPtr prelude, [MarshalAs(UnmanagedType.LPWStr)] string script,
+            [MarshalAs(UnmanagedType.LPWStr)] string fileName, int shardCount,
+            ReverseCommandHandlerDelegate reverseCommandHandler);
+
+        [DllImport("js1", EntryPoint = "dispose_sharded_query")]
+        public static extern void DisposeShardedQuery(IntPtr shardedQueryHandle);
+
+        // queues the event, reverse commands are delivered on the shard threads
+        [DllImport("js1", EntryPoint = "sharded_process_event")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ShardedProcessEvent(
+            IntPtr shardedQueryHandle, [MarshalAs(UnmanagedType.LPWStr)] string partition,
+            [MarshalAs(UnmanagedType.LPWStr)] string dataJson,
+            [MarshalAs(UnmanagedType.LPArray, ArraySubType = UnmanagedType.LPWStr)] string[] dataOther, int otherLength);
+
+        [DllImport("js1", EntryPoint = "sharded_initialize")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ShardedInitialize(IntPtr shardedQueryHandle);
+
+        // the state is a JSON object keyed by partition
+        [DllImport("js1", EntryPoint = "sharded_get_state")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ShardedGetState(IntPtr shardedQueryHandle, ReportStatisticsDelegate reportStateCallback);
+
+        [DllImport("js1", EntryPoint = "sharded_set_state")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ShardedSetState(IntPtr shardedQueryHandle, [MarshalAs(UnmanagedType.LPWStr)] string stateJson);
+
+        [DllImport("js1", EntryPoint = "sharded_report_errors")]
+        public static extern void ShardedReportErrors(IntPtr shardedQueryHandle, ReportErrorDelegate reportErrorCallback);
+
+        [DllImport("js1", EntryPoint = "get_sharded_query_statistics")]
+        public static extern void GetShardedQueryStatistics(
+            IntPtr shardedQueryHandle, ReportStatisticsDelegate reportStatisticsCallback);
     }
 }
\ No newline at end of file
@@ -0,0 +1,308 @@
+// js1bench.cpp : Replays an event file through a projection using the js1 exports 
+// the same way the managed projection host does and reports throughput, latency 
+// percentiles, peak RSS and GC time as JSON.  Projections partitioned by stream 
+// (foreachStream) get their state swapped per stream through set_state/get_state, 
+// so get-state-every does not apply to them.
+//
+// usage: js1bench <prelude-dir> <query.js> <events.tsv> [iterations] [get-state-every]
+//
+// Event files contain one event per line with tab separated fields:
+// stream_id, event_type, category, sequence_number, metadata, body
+
+#include "stdafx.h"
+#include "js1.h"
+#include "Histogram.h"
+#include "JsonWriter.h"
+#include "encoding.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+
+#if __GNUC__ >= 4
+#include <sys/resource.h>
+#endif
+
+namespace js1bench 
+{
+	const int OTHER_ARGUMENTS_COUNT = 6;
+
+	struct Event 
+	{
+		std::vector<uint16_t> body;
+		std::vector<uint16_t> other[OTHER_ARGUMENTS_COUNT];
+	};
+
+	std::string prelude_dir;
+	void *prelude_handle = NULL;
+	std::map<std::string, void *> handlers;
+	std::string last_error;
+	uint64_t emitted_count = 0;
+	uint64_t logged_count = 0;
+
+	std::string read_file(const std::string &file_name)
+	{
+		std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+		if (!file)
+		{
+			fprintf(stderr, "Cannot open %s\n", file_name.c_str());
+			exit(1);
+		}
+		std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		// skip UTF-8 byte order mark
+		if (content.size() >= 3 && content.compare(0, 3, "\xEF\xBB\xBF") == 0)
+			content.erase(0, 3);
+		return content;
+	}
+
+	void STDCALL report_error(const int /*error_code*/, const uint16_t *error_message)
+	{
+		last_error = js1::utf16_to_utf8(error_message);
+	}
+
+	void check_errors(void *script_handle, const std::string &what)
+	{
+		last_error.clear();
+		::report_errors(script_handle, report_error);
+		if (!last_error.empty())
+		{
+			fprintf(stderr, "%s failed: %s\n", what.c_str(), last_error.c_str());
+			exit(1);
+		}
+	}
+
+	void * STDCALL load_module(const uint16_t *module_name)
+	{
+		std::string name = js1::utf16_to_utf8(module_name);
+		std::string file_name = prelude_dir + "/" + name + ".js";
+		std::vector<uint16_t> source = js1::utf8_to_utf16(read_file(file_name));
+		std::vector<uint16_t> file_name16 = js1::utf8_to_utf16(file_name);
+		// prelude_handle is still NULL while the prelude itself is being compiled, as in the managed host
+		void *module_handle = ::compile_module(prelude_handle, &source[0], &file_name16[0]);
+		check_errors(module_handle, "Compiling module " + name);
+		return module_handle;
+	}
+
+	void STDCALL log(const uint16_t * /*message*/)
+	{
+		logged_count++;
+	}
+
+	void STDCALL register_command_handler(const uint16_t *event_name, void *handler_handle)
+	{
+		handlers[js1::utf16_to_utf8(event_name)] = handler_handle;
+	}
+
+	void STDCALL reverse_command(const uint16_t * /*command_name*/, const uint16_t * /*command_arguments*/)
+	{
+		emitted_count++;
+	}
+
+	std::string gc_statistics_json;
+
+	void STDCALL report_gc_statistics(const uint16_t *statistics_json)
+	{
+		gc_statistics_json = js1::utf16_to_utf8(statistics_json);
+	}
+
+	void split(const std::string &line, char separator, std::vector<std::string> &fields, size_t max_fields)
+	{
+		fields.clear();
+		size_t start = 0;
+		while (fields.size() + 1 < max_fields)
+		{
+			size_t end = line.find(separator, start);
+			if (end == std::string::npos)
+				break;
+			fields.push_back(line.substr(start, end - start));
+			start = end + 1;
+		}
+		fields.push_back(line.substr(start));
+	}
+
+	void load_events(const std::string &file_name, std::vector<Event> &events)
+	{
+		std::ifstream file(file_name.c_str());
+		if (!file)
+		{
+			fprintf(stderr, "Cannot open %s\n", file_name.c_str());
+			exit(1);
+		}
+		std::string line;
+		std::vector<std::string> fields;
+		int64_t log_position = 0;
+		while (std::getline(file, line))
+		{
+			if (line.empty())
+				continue;
+			split(line, '\t', fields, 6);
+			if (fields.size() != 6)
+			{
+				fprintf(stderr, "Invalid event line %d\n", static_cast<int>(events.size()) + 1);
+				exit(1);
+			}
+			char position[32];
+			sprintf(position, "%lld", static_cast<long long>(log_position));
+			log_position += line.size();
+
+			events.push_back(Event());
+			Event &event = events.back();
+			event.body = js1::utf8_to_utf16(fields[5]);
+			for (int i = 0; i < 5; i++)
+				event.other[i] = js1::utf8_to_utf16(fields[i]);
+			event.other[5] = js1::utf8_to_utf16(position);
+		}
+	}
+
+	void *get_handler(const char *name)
+	{
+		std::map<std::string, void *>::iterator it = handlers.find(name);
+		if (it == handlers.end())
+		{
+			fprintf(stderr, "'%s' command handler has not been registered\n", name);
+			exit(1);
+		}
+		return it->second;
+	}
+
+	// returns the length of the result, which is copied (zero terminated) into result_copy if given
+	size_t execute(
+		void *query_handle, void *handler, const uint16_t *data, const uint16_t *other[], int32_t other_length, 
+		std::vector<uint16_t> *result_copy = NULL)
+	{
+		uint16_t *result_json;
+		void *result = ::execute_command_handler(query_handle, handler, data, other, other_length, &result_json);
+		if (result == NULL)
+			check_errors(query_handle, "Executing handler");
+		size_t length = 0;
+		if (result_json != NULL)
+			while (result_json[length] != 0)
+				length++;
+		if (result_copy != NULL)
+		{
+			if (result_json != NULL)
+				result_copy->assign(result_json, result_json + length + 1);
+			else
+				result_copy->assign(1, 0);
+		}
+		::free_result(result);
+		return length;
+	}
+
+	uint64_t peak_rss_bytes()
+	{
+#if __GNUC__ >= 4
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#else
+		return 0;
+#endif
+	}
+
+	int run(int argc, char *argv[])
+	{
+		if (argc < 4)
+		{
+			fprintf(stderr, "usage: js1bench <prelude-dir> <query.js> <events.tsv> [iterations] [get-state-every]\n");
+			return 2;
+		}
+		prelude_dir = argv[1];
+		std::string query_file_name = argv[2];
+		int iterations = argc > 4 ? atoi(argv[4]) : 1;
+		int get_state_every = argc > 5 ? atoi(argv[5]) : 1;
+
+		std::vector<Event> events;
+		load_events(argv[3], events);
+
+		std::string prelude_file_name = prelude_dir + "/1Prelude.js";
+		std::vector<uint16_t> prelude_source = js1::utf8_to_utf16(read_file(prelude_file_name));
+		std::vector<uint16_t> prelude_file_name16 = js1::utf8_to_utf16(prelude_file_name);
+		std::vector<uint16_t> query_source = js1::utf8_to_utf16(read_file(query_file_name));
+		std::vector<uint16_t> query_file_name16 = js1::utf8_to_utf16(query_file_name);
+
+		uint64_t compile_started_us = js1::platform::now_us();
+		void *prelude = ::compile_prelude(&prelude_source[0], &prelude_file_name16[0], load_module, log);
+		check_errors(prelude, "Compiling prelude");
+		prelude_handle = prelude;
+		void *query = ::compile_query(prelude, &query_source[0], &query_file_name16[0], register_command_handler, reverse_command);
+		check_errors(query, "Compiling query");
+		uint64_t compile_us = js1::platform::now_us() - compile_started_us;
+
+		void *initialize = get_handler("initialize");
+		void *process_event = get_handler("process_event");
+		void *get_state = get_handler("get_state");
+		void *set_state = get_handler("set_state");
+		std::vector<uint16_t> empty(1, 0);
+		std::vector<uint16_t> sources;
+		execute(query, get_handler("get_sources"), &empty[0], NULL, 0, &sources);
+		bool by_streams = js1::utf16_to_utf8(&sources[0]).find("\"by_streams\":true") != std::string::npos;
+		execute(query, initialize, &empty[0], NULL, 0);
+
+		// the same state swapping the projection host does for partitioned projections
+		std::map<std::vector<uint16_t>, std::vector<uint16_t> > partitions;
+
+		js1::Histogram latency;
+		uint64_t state_bytes = 0;
+		uint64_t started_us = js1::platform::now_us();
+		for (int iteration = 0; iteration < iterations; iteration++)
+			for (size_t i = 0; i < events.size(); i++)
+			{
+				Event &event = events[i];
+				const uint16_t *other[OTHER_ARGUMENTS_COUNT];
+				for (int j = 0; j < OTHER_ARGUMENTS_COUNT; j++)
+					other[j] = &event.other[j][0];
+
+				uint64_t event_started_us = js1::platform::now_us();
+				if (by_streams)
+				{
+					std::vector<uint16_t> &partition_state = partitions[event.other[0]];
+					if (partition_state.empty())
+						execute(query, initialize, &empty[0], NULL, 0);
+					else
+						execute(query, set_state, &partition_state[0], NULL, 0);
+					execute(query, process_event, &event.body[0], other, OTHER_ARGUMENTS_COUNT);
+					state_bytes = execute(query, get_state, &empty[0], NULL, 0, &partition_state) * sizeof(uint16_t);
+				}
+				else
+				{
+					execute(query, process_event, &event.body[0], other, OTHER_ARGUMENTS_COUNT);
+					if (get_state_every > 0 && (i + 1) % get_state_every == 0)
+						state_bytes = execute(query, get_state, &empty[0], NULL, 0) * sizeof(uint16_t);
+				}
+				latency.record(js1::platform::now_us() - event_started_us);
+			}
+		uint64_t elapsed_us = js1::platform::now_us() - started_us;
+
+		::get_gc_statistics(query, report_gc_statistics);
+		::dispose_script(query);
+		::dispose_script(prelude);
+
+		js1::JsonWriter writer;
+		writer.begin_object();
+		writer.member("query", query_file_name);
+		writer.member("events", static_cast<uint64_t>(events.size()) * iterations);
+		writer.member("iterations", iterations);
+		writer.member("compile_us", compile_us);
+		writer.member("elapsed_us", elapsed_us);
+		writer.member("events_per_second", elapsed_us == 0 ? 0.0 : latency.get_count() * 1000000.0 / elapsed_us);
+		writer.key("latency_us");
+		latency.write_json(writer);
+		writer.member("last_state_bytes", state_bytes);
+		writer.member("partitions", static_cast<uint64_t>(partitions.size()));
+		writer.member("emitted", emitted_count);
+		writer.member("logged", logged_count);
+		writer.member("peak_rss_bytes", peak_rss_bytes());
+		writer.key("gc");
+		writer.raw_value(gc_statistics_json.empty() ? "null" : gc_statistics_json);
+		writer.end_object();
+		printf("%s\n", writer.str().c_str());
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	return js1bench::run(argc, argv);
+}
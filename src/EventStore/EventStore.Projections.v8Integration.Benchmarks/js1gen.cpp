@@ -0,0 +1,201 @@
+// js1gen.cpp : Generates synthetic event files in the js1bench format.
+//
+// usage: js1gen [options] > events.tsv
+//   --events N          number of events to generate (default 100000)
+//   --streams N         number of distinct streams (default 1000)
+//   --categories N      number of stream categories (default 4)
+//   --zipf S            Zipf exponent of the stream popularity, 0 is uniform (default 1.0)
+//   --types T:W,...     event types with relative weights (default OrderPlaced:5,OrderShipped:3,OrderCancelled:1)
+//   --body-min N        minimal event body size in bytes (default 64)
+//   --body-max N        maximal event body size in bytes (default 512)
+//   --customers N       number of distinct customers referenced by bodies (default 10000)
+//   --metadata P        probability of an event having metadata (default 0.5)
+//   --seed N            random seed (default 1)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+namespace js1gen 
+{
+
+	// xorshift64* - fast and deterministic across platforms 
+	class Random 
+	{
+	public:
+		Random(unsigned long long seed) : state(seed == 0 ? 0x9E3779B97F4A7C15ULL : seed) 
+		{
+		}
+
+		unsigned long long next()
+		{
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return state * 0x2545F4914F6CDD1DULL;
+		}
+
+		double next_double()
+		{
+			return (next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		int next_int(int min, int max)
+		{
+			return min + static_cast<int>(next() % static_cast<unsigned long long>(max - min + 1));
+		}
+
+	private:
+		unsigned long long state;
+	};
+
+	// cumulative distribution sampled by binary search
+	class Distribution 
+	{
+	public:
+		void add(double weight)
+		{
+			double total = cdf.empty() ? 0.0 : cdf.back();
+			cdf.push_back(total + weight);
+		}
+
+		size_t sample(Random &random) const
+		{
+			double value = random.next_double() * cdf.back();
+			size_t low = 0;
+			size_t high = cdf.size() - 1;
+			while (low < high)
+			{
+				size_t middle = (low + high) / 2;
+				if (cdf[middle] <= value)
+					low = middle + 1;
+				else
+					high = middle;
+			}
+			return low;
+		}
+
+	private:
+		std::vector<double> cdf;
+	};
+
+	struct Options 
+	{
+		Options() : 
+			events(100000), streams(1000), categories(4), zipf(1.0), 
+			types("OrderPlaced:5,OrderShipped:3,OrderCancelled:1"),
+			body_min(64), body_max(512), customers(10000), metadata(0.5), seed(1)
+		{
+		}
+
+		long events;
+		int streams;
+		int categories;
+		double zipf;
+		std::string types;
+		int body_min;
+		int body_max;
+		int customers;
+		double metadata;
+		unsigned long long seed;
+	};
+
+	bool parse_options(int argc, char *argv[], Options &options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			if (i + 1 >= argc)
+				return false;
+			const char *name = argv[i];
+			const char *value = argv[++i];
+			if (strcmp(name, "--events") == 0) options.events = atol(value);
+			else if (strcmp(name, "--streams") == 0) options.streams = atoi(value);
+			else if (strcmp(name, "--categories") == 0) options.categories = atoi(value);
+			else if (strcmp(name, "--zipf") == 0) options.zipf = atof(value);
+			else if (strcmp(name, "--types") == 0) options.types = value;
+			else if (strcmp(name, "--body-min") == 0) options.body_min = atoi(value);
+			else if (strcmp(name, "--body-max") == 0) options.body_max = atoi(value);
+			else if (strcmp(name, "--customers") == 0) options.customers = atoi(value);
+			else if (strcmp(name, "--metadata") == 0) options.metadata = atof(value);
+			else if (strcmp(name, "--seed") == 0) options.seed = strtoull(value, NULL, 10);
+			else return false;
+		}
+		return options.events >= 0 && options.streams > 0 && options.categories > 0 
+			&& options.body_min >= 0 && options.body_max >= options.body_min && options.customers > 0;
+	}
+
+	bool parse_types(const std::string &types, std::vector<std::string> &names, Distribution &distribution)
+	{
+		size_t start = 0;
+		while (start < types.size())
+		{
+			size_t end = types.find(',', start);
+			if (end == std::string::npos)
+				end = types.size();
+			std::string item = types.substr(start, end - start);
+			size_t colon = item.find(':');
+			double weight = colon == std::string::npos ? 1.0 : atof(item.c_str() + colon + 1);
+			if (weight <= 0)
+				return false;
+			names.push_back(item.substr(0, colon));
+			distribution.add(weight);
+			start = end + 1;
+		}
+		return !names.empty();
+	}
+
+	int run(int argc, char *argv[])
+	{
+		Options options;
+		if (!parse_options(argc, argv, options))
+		{
+			fprintf(stderr, "usage: js1gen [--events N] [--streams N] [--categories N] [--zipf S] [--types T:W,...]\n"
+				"              [--body-min N] [--body-max N] [--customers N] [--metadata P] [--seed N]\n");
+			return 2;
+		}
+
+		std::vector<std::string> type_names;
+		Distribution types;
+		if (!parse_types(options.types, type_names, types))
+		{
+			fprintf(stderr, "Invalid --types\n");
+			return 2;
+		}
+
+		Distribution streams;
+		for (int i = 1; i <= options.streams; i++)
+			streams.add(1.0 / pow(static_cast<double>(i), options.zipf));
+
+		Random random(options.seed);
+		std::vector<int> sequence_numbers(options.streams, 0);
+		std::string padding;
+		for (long i = 0; i < options.events; i++)
+		{
+			size_t stream = streams.sample(random);
+			int category = static_cast<int>(stream % options.categories);
+			const std::string &type = type_names[types.sample(random)];
+			int customer = random.next_int(0, options.customers - 1);
+			int body_size = random.next_int(options.body_min, options.body_max);
+
+			char body[256];
+			int length = sprintf(body, "{\"id\":%ld,\"customer\":\"customer-%d\",\"amount\":%d.%02d,\"payload\":\"", 
+				i, customer, random.next_int(1, 1000), random.next_int(0, 99));
+			int padding_size = body_size - length - 2;
+			padding.assign(padding_size > 0 ? padding_size : 0, 'x');
+
+			printf("category%d-%u\t%s\tcategory%d\t%d\t", category, static_cast<unsigned>(stream), type.c_str(), category, sequence_numbers[stream]++);
+			if (random.next_double() < options.metadata)
+				printf("{\"correlationId\":\"%016llx\",\"user\":\"user-%d\"}", random.next(), customer % 100);
+			printf("\t%s%s\"}\n", body, padding.c_str());
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	return js1gen::run(argc, argv);
+}
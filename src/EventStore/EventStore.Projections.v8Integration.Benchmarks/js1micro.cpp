@@ -0,0 +1,406 @@
+// js1micro.cpp : Microbenchmarks of the V8 primitives used by the js1 execute path.
+//
+// usage: js1micro [samples] [sample-ms]
+//
+// Each benchmark is calibrated to run batches of about sample-ms milliseconds and
+// is then measured samples times.  Samples further than 3 median absolute 
+// deviations from the median are rejected; results are reported in ns per 
+// operation as JSON.
+
+#include "stdafx.h"
+#include "CompiledScript.h"
+#include "PreludeScope.h"
+#include "JsonWriter.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+namespace js1micro 
+{
+	// a script which owns an isolate but compiles nothing, used to measure PreludeScope
+	class BenchmarkScript : public js1::CompiledScript 
+	{
+	public:
+		BenchmarkScript() : isolate(v8::Isolate::New())
+		{
+			isolate_add_ref(isolate);
+		}
+
+		virtual ~BenchmarkScript()
+		{
+			isolate_release(isolate);
+		}
+
+	protected:
+		virtual v8::Isolate *get_isolate()
+		{
+			return isolate;
+		}
+
+		virtual v8::Persistent<v8::ObjectTemplate> create_global_template()
+		{
+			return v8::Persistent<v8::ObjectTemplate>();
+		}
+
+	private:
+		v8::Isolate *isolate;
+	};
+
+	class Benchmark 
+	{
+	public:
+		Benchmark(const std::string &name_) : name(name_) 
+		{
+		}
+		virtual ~Benchmark() 
+		{
+		}
+		virtual void run(long iterations) = 0;
+
+		std::string name;
+	};
+
+	struct Environment 
+	{
+		BenchmarkScript *script;
+		v8::Isolate *isolate;
+		v8::Persistent<v8::Context> context;
+		v8::Persistent<v8::Function> identity;
+		v8::Persistent<v8::Function> stringify;
+	};
+
+	Environment environment;
+
+	class PreludeScopeBenchmark : public Benchmark 
+	{
+	public:
+		PreludeScopeBenchmark() : Benchmark("prelude_scope") 
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			environment.isolate->Exit();
+			for (long i = 0; i < iterations; i++)
+			{
+				js1::PreludeScope prelude_scope(environment.script);
+			}
+			environment.isolate->Enter();
+		}
+	};
+
+	class HandleAndContextScopeBenchmark : public Benchmark 
+	{
+	public:
+		HandleAndContextScopeBenchmark() : Benchmark("handle_scope_context_scope") 
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::HandleScope handle_scope;
+				v8::Context::Scope context_scope(environment.context);
+			}
+		}
+	};
+
+	class TryCatchBenchmark : public Benchmark 
+	{
+	public:
+		TryCatchBenchmark() : Benchmark("try_catch") 
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::TryCatch try_catch;
+			}
+		}
+	};
+
+	class StringNewBenchmark : public Benchmark 
+	{
+	public:
+		StringNewBenchmark(bool utf16_, size_t size) : 
+			Benchmark(std::string(utf16_ ? "string_new_utf16_" : "string_new_utf8_") + size_name(size)), 
+			utf16(utf16_), narrow(size, 'x'), wide(size, 'x')
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::HandleScope handle_scope;
+				if (utf16)
+					v8::String::New(&wide[0], static_cast<int>(wide.size()));
+				else
+					v8::String::New(narrow.data(), static_cast<int>(narrow.size()));
+			}
+		}
+
+		static std::string size_name(size_t size)
+		{
+			char name[32];
+			sprintf(name, "%u", static_cast<unsigned>(size));
+			return name;
+		}
+
+	private:
+		bool utf16;
+		std::string narrow;
+		std::vector<uint16_t> wide;
+	};
+
+	class StringValueBenchmark : public Benchmark 
+	{
+	public:
+		StringValueBenchmark(size_t size) : Benchmark("string_value_" + StringNewBenchmark::size_name(size))
+		{
+			v8::HandleScope handle_scope;
+			std::vector<uint16_t> wide(size, 'x');
+			value = v8::Persistent<v8::String>::New(v8::String::New(&wide[0], static_cast<int>(size)));
+		}
+
+		virtual ~StringValueBenchmark()
+		{
+			value.Dispose();
+		}
+
+		virtual void run(long iterations)
+		{
+			for (long i = 0; i < iterations; i++)
+			{
+				// ToString inside String::Value allocates a handle
+				v8::HandleScope handle_scope;
+				v8::String::Value string_value(value);
+			}
+		}
+
+	private:
+		v8::Persistent<v8::String> value;
+	};
+
+	class PersistentBenchmark : public Benchmark 
+	{
+	public:
+		PersistentBenchmark() : Benchmark("persistent_new_dispose") 
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			v8::HandleScope handle_scope;
+			v8::Handle<v8::String> value = v8::String::New("x");
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::Persistent<v8::String> persistent = v8::Persistent<v8::String>::New(value);
+				persistent.Dispose();
+			}
+		}
+	};
+
+	class FunctionCallBenchmark : public Benchmark 
+	{
+	public:
+		FunctionCallBenchmark(int argc_) : Benchmark(argc_ == 1 ? "function_call_1_arg" : "function_call_7_args"), argc(argc_) 
+		{
+		}
+
+		virtual void run(long iterations)
+		{
+			v8::HandleScope handle_scope;
+			v8::Context::Scope context_scope(environment.context);
+			v8::Handle<v8::Value> argv[7];
+			for (int i = 0; i < 7; i++)
+				argv[i] = v8::String::New("argument");
+			v8::Handle<v8::Object> global = environment.context->Global();
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::HandleScope handle_scope;
+				environment.identity->Call(global, argc, argv);
+			}
+		}
+
+	private:
+		int argc;
+	};
+
+	class StringifyBenchmark : public Benchmark 
+	{
+	public:
+		StringifyBenchmark(int keys) : Benchmark("json_stringify_" + StringNewBenchmark::size_name(keys) + "_keys")
+		{
+			v8::HandleScope handle_scope;
+			v8::Context::Scope context_scope(environment.context);
+			v8::Handle<v8::Object> object = v8::Object::New();
+			char key[32];
+			for (int i = 0; i < keys; i++)
+			{
+				sprintf(key, "stream-%d", i);
+				v8::Handle<v8::Object> item = v8::Object::New();
+				item->Set(v8::String::New("count"), v8::Integer::New(i));
+				item->Set(v8::String::New("total"), v8::Number::New(i * 1.5));
+				object->Set(v8::String::New(key), item);
+			}
+			state = v8::Persistent<v8::Object>::New(object);
+		}
+
+		virtual ~StringifyBenchmark()
+		{
+			state.Dispose();
+		}
+
+		virtual void run(long iterations)
+		{
+			v8::Context::Scope context_scope(environment.context);
+			v8::Handle<v8::Value> argv[1] = { state };
+			v8::Handle<v8::Object> global = environment.context->Global();
+			for (long i = 0; i < iterations; i++)
+			{
+				v8::HandleScope handle_scope;
+				environment.stringify->Call(global, 1, argv);
+			}
+		}
+
+	private:
+		v8::Persistent<v8::Object> state;
+	};
+
+	double measure(Benchmark &benchmark, long iterations)
+	{
+		uint64_t started_us = js1::platform::now_us();
+		benchmark.run(iterations);
+		return static_cast<double>(js1::platform::now_us() - started_us) * 1000.0 / iterations;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		size_t middle = values.size() / 2;
+		return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+	}
+
+	void run_benchmark(Benchmark &benchmark, int samples, int sample_ms, js1::JsonWriter &writer)
+	{
+		// calibrate the batch size so a sample takes about sample_ms
+		long iterations = 1;
+		while (true)
+		{
+			double elapsed_ms = measure(benchmark, iterations) * iterations / 1000000.0;
+			if (elapsed_ms >= sample_ms || iterations >= (1L << 30))
+				break;
+			iterations *= elapsed_ms < 1 ? 10 : 2;
+		}
+
+		std::vector<double> results;
+		for (int i = 0; i < samples; i++)
+			results.push_back(measure(benchmark, iterations));
+
+		double result_median = median(results);
+		std::vector<double> deviations;
+		for (size_t i = 0; i < results.size(); i++)
+			deviations.push_back(fabs(results[i] - result_median));
+		double mad = median(deviations);
+
+		std::vector<double> kept;
+		for (size_t i = 0; i < results.size(); i++)
+			if (mad == 0 || fabs(results[i] - result_median) <= 3 * mad)
+				kept.push_back(results[i]);
+
+		double sum = 0;
+		for (size_t i = 0; i < kept.size(); i++)
+			sum += kept[i];
+		double mean = sum / kept.size();
+		double variance = 0;
+		for (size_t i = 0; i < kept.size(); i++)
+			variance += (kept[i] - mean) * (kept[i] - mean);
+
+		writer.begin_object();
+		writer.member("name", benchmark.name);
+		writer.member("iterations_per_sample", static_cast<int64_t>(iterations));
+		writer.member("samples", static_cast<int32_t>(results.size()));
+		writer.member("rejected", static_cast<int32_t>(results.size() - kept.size()));
+		writer.member("median_ns", result_median);
+		writer.member("mean_ns", mean);
+		writer.member("min_ns", *std::min_element(kept.begin(), kept.end()));
+		writer.member("stddev_ns", kept.size() > 1 ? sqrt(variance / (kept.size() - 1)) : 0.0);
+		writer.end_object();
+		fprintf(stderr, "%-32s %12.1f ns\n", benchmark.name.c_str(), result_median);
+	}
+
+	int run(int argc, char *argv[])
+	{
+		int samples = argc > 1 ? atoi(argv[1]) : 21;
+		int sample_ms = argc > 2 ? atoi(argv[2]) : 20;
+
+		environment.script = new BenchmarkScript();
+		{
+			js1::PreludeScope prelude_scope(environment.script);
+			// the isolate stays entered for every benchmark other than prelude_scope
+			environment.isolate = v8::Isolate::GetCurrent();
+			environment.context = v8::Context::New();
+			{
+				v8::HandleScope handle_scope;
+				v8::Context::Scope context_scope(environment.context);
+				v8::Handle<v8::Value> identity = v8::Script::Compile(
+					v8::String::New("(function (a, b, c, d, e, f, g) { return a; })"))->Run();
+				environment.identity = v8::Persistent<v8::Function>::New(identity.As<v8::Function>());
+				v8::Handle<v8::Object> json = environment.context->Global()->Get(v8::String::New("JSON")).As<v8::Object>();
+				environment.stringify = v8::Persistent<v8::Function>::New(
+					json->Get(v8::String::New("stringify")).As<v8::Function>());
+			}
+
+			std::vector<Benchmark *> benchmarks;
+			benchmarks.push_back(new PreludeScopeBenchmark());
+			benchmarks.push_back(new HandleAndContextScopeBenchmark());
+			benchmarks.push_back(new TryCatchBenchmark());
+			benchmarks.push_back(new PersistentBenchmark());
+			size_t sizes[] = { 16, 256, 4096, 65536 };
+			for (int i = 0; i < 4; i++)
+			{
+				benchmarks.push_back(new StringNewBenchmark(true, sizes[i]));
+				benchmarks.push_back(new StringNewBenchmark(false, sizes[i]));
+				benchmarks.push_back(new StringValueBenchmark(sizes[i]));
+			}
+			benchmarks.push_back(new FunctionCallBenchmark(1));
+			benchmarks.push_back(new FunctionCallBenchmark(7));
+			int keys[] = { 10, 1000, 100000 };
+			for (int i = 0; i < 3; i++)
+				benchmarks.push_back(new StringifyBenchmark(keys[i]));
+
+			js1::JsonWriter writer;
+			writer.begin_object();
+			writer.member("samples", samples);
+			writer.member("sample_ms", sample_ms);
+			writer.key("benchmarks");
+			writer.begin_array();
+			for (size_t i = 0; i < benchmarks.size(); i++)
+			{
+				run_benchmark(*benchmarks[i], samples, sample_ms, writer);
+				delete benchmarks[i];
+			}
+			writer.end_array();
+			writer.end_object();
+			printf("%s\n", writer.str().c_str());
+
+			environment.identity.Dispose();
+			environment.stringify.Dispose();
+			environment.context.Dispose();
+		}
+		delete environment.script;
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	return js1micro::run(argc, argv);
+}
@@ -0,0 +1,241 @@
+// js1replay.cpp : Replays a trace written by the js1 capture mode (see Capture.h) 
+// through the library and compares replayed and captured handler durations.
+//
+// usage: js1replay <trace-file> [iterations]
+//
+// Modules are replayed when the prelude being replayed requests them, in the order 
+// they were captured.
+
+#include "stdafx.h"
+#include "js1.h"
+#include "Capture.h"
+#include "Histogram.h"
+#include "JsonWriter.h"
+#include "encoding.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace js1replay 
+{
+	typedef js1::CaptureReader::Record Record;
+
+	struct HandlerResults 
+	{
+		js1::Histogram replayed_us;
+		js1::Histogram captured_us;
+	};
+
+	std::vector<Record> records;
+	size_t next_module = 0;
+	std::map<uint64_t, void *> scripts;
+	std::vector<uint64_t> script_order;
+	std::map<uint64_t, std::map<std::string, void *> > handlers;
+	std::map<std::string, void *> *registering_handlers = NULL;
+	std::string last_error;
+	uint64_t failed_count = 0;
+
+	void STDCALL report_error(const int /*error_code*/, const uint16_t *error_message)
+	{
+		last_error = js1::utf16_to_utf8(error_message);
+	}
+
+	bool check_errors(void *script_handle, const char *what)
+	{
+		last_error.clear();
+		::report_errors(script_handle, report_error);
+		if (last_error.empty())
+			return true;
+		fprintf(stderr, "%s failed: %s\n", what, last_error.c_str());
+		failed_count++;
+		return false;
+	}
+
+	void *find_script(uint64_t id)
+	{
+		std::map<uint64_t, void *>::iterator it = scripts.find(id);
+		return it == scripts.end() ? NULL : it->second;
+	}
+
+	void add_script(uint64_t id, void *handle)
+	{
+		scripts[id] = handle;
+		script_order.push_back(id);
+	}
+
+	void * STDCALL load_module(const uint16_t *module_name)
+	{
+		while (next_module < records.size() && records[next_module].type != js1::Capture::COMPILE_MODULE)
+			next_module++;
+		if (next_module == records.size())
+		{
+			fprintf(stderr, "Module %s has not been captured\n", js1::utf16_to_utf8(module_name).c_str());
+			return NULL;
+		}
+		Record &record = records[next_module++];
+		void *module_handle = ::compile_module(find_script(record.prelude_id), &record.source[0], &record.file_name[0]);
+		check_errors(module_handle, "Compiling module");
+		add_script(record.id, module_handle);
+		return module_handle;
+	}
+
+	void STDCALL log(const uint16_t * /*message*/)
+	{
+	}
+
+	void STDCALL register_command_handler(const uint16_t *event_name, void *handler_handle)
+	{
+		(*registering_handlers)[js1::utf16_to_utf8(event_name)] = handler_handle;
+	}
+
+	void STDCALL reverse_command(const uint16_t * /*command_name*/, const uint16_t * /*command_arguments*/)
+	{
+	}
+
+	void dispose(uint64_t id)
+	{
+		std::map<uint64_t, void *>::iterator it = scripts.find(id);
+		if (it == scripts.end())
+			return;
+		::dispose_script(it->second);
+		scripts.erase(it);
+		handlers.erase(id);
+	}
+
+	void load_records(const char *file_name)
+	{
+		js1::CaptureReader reader;
+		if (!reader.open(file_name))
+		{
+			fprintf(stderr, "Cannot open %s or it is not a js1 trace\n", file_name);
+			exit(1);
+		}
+		Record record;
+		while (reader.read(record))
+			records.push_back(record);
+	}
+
+	int run(int argc, char *argv[])
+	{
+		if (argc < 2)
+		{
+			fprintf(stderr, "usage: js1replay <trace-file> [iterations]\n");
+			return 2;
+		}
+		int iterations = argc > 2 ? atoi(argv[2]) : 1;
+		load_records(argv[1]);
+
+		std::map<std::string, HandlerResults> results;
+		uint64_t executed_count = 0;
+		uint64_t skipped_count = 0;
+		uint64_t mismatched_count = 0;
+		uint64_t started_us = js1::platform::now_us();
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			for (size_t i = 0; i < records.size(); i++)
+			{
+				Record &record = records[i];
+				switch (record.type)
+				{
+				case js1::Capture::COMPILE_PRELUDE:
+					{
+						next_module = i + 1;
+						void *prelude = ::compile_prelude(&record.source[0], &record.file_name[0], load_module, log);
+						check_errors(prelude, "Compiling prelude");
+						add_script(record.id, prelude);
+						break;
+					}
+				case js1::Capture::COMPILE_QUERY:
+					{
+						registering_handlers = &handlers[record.id];
+						void *query = ::compile_query(
+							find_script(record.prelude_id), &record.source[0], &record.file_name[0], register_command_handler, reverse_command);
+						registering_handlers = NULL;
+						check_errors(query, "Compiling query");
+						add_script(record.id, query);
+						break;
+					}
+				case js1::Capture::EXECUTE:
+					{
+						void *query = find_script(record.id);
+						std::map<std::string, void *> &query_handlers = handlers[record.id];
+						std::map<std::string, void *>::iterator handler = query_handlers.find(record.handler_name);
+						if (query == NULL || handler == query_handlers.end())
+						{
+							skipped_count++;
+							break;
+						}
+						std::vector<const uint16_t *> other;
+						for (size_t j = 0; j < record.data_other.size(); j++)
+							other.push_back(&record.data_other[j][0]);
+
+						uint16_t *result_json;
+						uint64_t execute_started_us = js1::platform::now_us();
+						void *result = ::execute_command_handler(query, handler->second, &record.data_json[0], 
+							other.empty() ? NULL : &other[0], static_cast<int32_t>(other.size()), &result_json);
+						uint64_t duration_us = js1::platform::now_us() - execute_started_us;
+
+						int32_t result_length = -1;
+						if (result_json != NULL)
+							for (result_length = 0; result_json[result_length] != 0; result_length++);
+						::free_result(result);
+						if (result == NULL)
+							check_errors(query, "Executing handler");
+
+						executed_count++;
+						if (result_length != record.result_length)
+							mismatched_count++;
+						HandlerResults &handler_results = results[record.handler_name];
+						handler_results.replayed_us.record(duration_us);
+						handler_results.captured_us.record(record.duration_us);
+						break;
+					}
+				case js1::Capture::DISPOSE:
+					dispose(record.id);
+					break;
+				default:
+					// modules are compiled when requested by the prelude
+					break;
+				}
+			}
+
+			for (size_t i = script_order.size(); i > 0; i--)
+				dispose(script_order[i - 1]);
+			script_order.clear();
+		}
+		uint64_t elapsed_us = js1::platform::now_us() - started_us;
+
+		js1::JsonWriter writer;
+		writer.begin_object();
+		writer.member("trace", std::string(argv[1]));
+		writer.member("records", static_cast<uint64_t>(records.size()));
+		writer.member("iterations", iterations);
+		writer.member("elapsed_us", elapsed_us);
+		writer.member("executed", executed_count);
+		writer.member("skipped", skipped_count);
+		writer.member("failed", failed_count);
+		writer.member("result_length_mismatches", mismatched_count);
+		writer.key("handlers");
+		writer.begin_object();
+		for (std::map<std::string, HandlerResults>::iterator it = results.begin(); it != results.end(); ++it)
+		{
+			writer.key(it->first);
+			writer.begin_object();
+			writer.key("replayed_us");
+			it->second.replayed_us.write_json(writer);
+			writer.key("captured_us");
+			it->second.captured_us.write_json(writer);
+			writer.end_object();
+		}
+		writer.end_object();
+		writer.end_object();
+		printf("%s\n", writer.str().c_str());
+		return failed_count == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	return js1replay::run(argc, argv);
+}
@@ -0,0 +1,6 @@
+// counts all events by event type
+fromAll().whenAny(function (state, event) {
+    var count = state[event.eventType];
+    state[event.eventType] = count === undefined ? 1 : count + 1;
+    return state;
+});
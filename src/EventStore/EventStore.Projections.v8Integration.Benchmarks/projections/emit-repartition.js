@@ -0,0 +1,9 @@
+// re-partitions orders by customer emitting a new event for each order
+fromAll().when({
+    OrderPlaced: function (state, event) {
+        emit(event.body.customer, 'CustomerOrderPlaced', { orderId: event.body.id, amount: event.body.amount });
+    },
+    OrderCancelled: function (state, event) {
+        emit(event.body.customer, 'CustomerOrderCancelled', { orderId: event.body.id });
+    }
+});
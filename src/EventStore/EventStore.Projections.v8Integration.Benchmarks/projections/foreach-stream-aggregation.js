@@ -0,0 +1,21 @@
+// per stream order totals
+// js1bench swaps the state per stream the way the projection host does
+fromCategory('category0').foreachStream().when({
+    $init: function () {
+        return { placed: 0, shipped: 0, cancelled: 0, total: 0 };
+    },
+    OrderPlaced: function (state, event) {
+        state.placed++;
+        state.total += event.body.amount;
+        return state;
+    },
+    OrderShipped: function (state, event) {
+        state.shipped++;
+        return state;
+    },
+    OrderCancelled: function (state, event) {
+        state.cancelled++;
+        state.total -= event.body.amount;
+        return state;
+    }
+});
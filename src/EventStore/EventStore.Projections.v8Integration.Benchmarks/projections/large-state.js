@@ -0,0 +1,19 @@
+// keeps per customer statistics growing the state with the number of customers
+fromAll().when({
+    $init: function () {
+        return { customers: {}, events: 0 };
+    },
+    OrderPlaced: function (state, event) {
+        var customer = state.customers[event.body.customer];
+        if (customer === undefined) {
+            customer = { orders: 0, total: 0, lastOrderId: null, streams: {} };
+            state.customers[event.body.customer] = customer;
+        }
+        customer.orders++;
+        customer.total += event.body.amount;
+        customer.lastOrderId = event.body.id;
+        customer.streams[event.streamId] = event.sequenceNumber;
+        state.events++;
+        return state;
+    }
+});
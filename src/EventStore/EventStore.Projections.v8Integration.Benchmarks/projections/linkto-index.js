@@ -0,0 +1,6 @@
+// indexes all events by event type and by customer
+fromAll().whenAny(function (state, event) {
+    linkTo('type-' + event.eventType, event);
+    if (event.body && event.body.customer)
+        linkTo('by-' + event.body.customer, event);
+});
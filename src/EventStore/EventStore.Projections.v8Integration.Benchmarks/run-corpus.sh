@@ -0,0 +1,28 @@
+#!/bin/bash
+# Runs every projection of the corpus through js1bench and appends one JSON 
+# result per projection (tagged with the build and the workload) to a results file.
+#
+# usage: run-corpus.sh [results-file] [js1gen options...]
+
+function err() {
+    exit 1
+}
+
+pushd $(dirname $0) > /dev/null || err
+bench=$(pwd -P)
+js=$(cd .. && pwd -P)
+popd > /dev/null || err
+
+results=${1:-$bench/results.jsonl}
+[ $# -gt 0 ] && shift
+build=$(git -C $js describe --always --dirty 2>/dev/null || echo unknown)
+workload="$*"
+events=$(mktemp) || err
+trap "rm -f $events" EXIT
+
+$js/libs/js1gen "$@" > $events || err
+
+for projection in $bench/projections/*.js ; do
+    result=$($js/libs/js1bench $js/EventStore.Projections.Core/Prelude $projection $events) || err
+    echo "{\"build\":\"$build\",\"workload\":\"$workload\",\"projection\":\"$(basename $projection .js)\",\"result\":$result}" >> $results
+done
@@ -0,0 +1,329 @@
+#include "stdafx.h"
+#include "BinaryState.h"
+
+#include <string.h>
+#include <math.h>
+
+namespace js1 
+{
+	namespace 
+	{
+		const char MAGIC[4] = { 'J', 'S', '1', 'S' };
+		// integers of up to 2^53 are exact in a double
+		const double MAX_EXACT_INTEGER = 9007199254740992.0;
+	}
+
+	BinaryStateWriter::BinaryStateWriter(ChunkSink &sink_, size_t chunk_size_) : 
+		StateWalker("binary state"), sink(sink_), chunk_size(chunk_size_ > 0 ? chunk_size_ : 1)
+	{
+		buffer.reserve(chunk_size + 16);
+	}
+
+	bool BinaryStateWriter::serialize(v8::Handle<v8::Value> value)
+	{
+		append(MAGIC, sizeof(MAGIC));
+		char version = static_cast<char>(BinaryState::VERSION);
+		append(&version, 1);
+		if (!walk(value))
+			return false;
+		if (!buffer.empty())
+			flush();
+		return !failed;
+	}
+
+	void BinaryStateWriter::write_null()
+	{
+		write_tag(BinaryState::TAG_NULL);
+	}
+
+	void BinaryStateWriter::write_boolean(bool value)
+	{
+		write_tag(value ? BinaryState::TAG_TRUE : BinaryState::TAG_FALSE);
+	}
+
+	void BinaryStateWriter::write_number(double number)
+	{
+		if (number != number || number - number != 0) // NaN or infinity, written as null like JSON does
+			write_tag(BinaryState::TAG_NULL);
+		else if (number == floor(number) && fabs(number) <= MAX_EXACT_INTEGER)
+		{
+			write_tag(BinaryState::TAG_INTEGER);
+			int64_t integer = static_cast<int64_t>(number);
+			write_varint((static_cast<uint64_t>(integer) << 1) ^ static_cast<uint64_t>(integer >> 63));
+		}
+		else
+		{
+			write_tag(BinaryState::TAG_DOUBLE);
+			uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+			char bytes[8];
+			for (int i = 0; i < 8; i++)
+				bytes[i] = static_cast<char>((bits >> (i * 8)) & 0xff);
+			append(bytes, 8);
+		}
+	}
+
+	void BinaryStateWriter::begin_object()
+	{
+		write_tag(BinaryState::TAG_OBJECT);
+	}
+
+	void BinaryStateWriter::write_key(v8::Handle<v8::String> name, bool /*first*/)
+	{
+		write_string(name);
+	}
+
+	void BinaryStateWriter::end_object()
+	{
+		write_tag(BinaryState::TAG_END);
+	}
+
+	void BinaryStateWriter::begin_array()
+	{
+		write_tag(BinaryState::TAG_ARRAY);
+	}
+
+	void BinaryStateWriter::begin_element(bool /*first*/)
+	{
+	}
+
+	void BinaryStateWriter::end_array()
+	{
+		write_tag(BinaryState::TAG_END);
+	}
+
+	void BinaryStateWriter::write_string(v8::Handle<v8::String> string)
+	{
+		std::string utf8(string->Utf8Length(), '\0');
+		if (!utf8.empty())
+			string->WriteUtf8(&utf8[0], static_cast<int>(utf8.size()), NULL, v8::String::NO_NULL_TERMINATION);
+
+		if (utf8.size() <= BinaryState::MAX_INTERNED_LENGTH)
+		{
+			std::map<std::string, uint32_t>::iterator it = strings.find(utf8);
+			if (it != strings.end())
+			{
+				write_tag(BinaryState::TAG_STRING_REF);
+				write_varint(it->second);
+				return;
+			}
+			uint32_t index = static_cast<uint32_t>(strings.size());
+			strings[utf8] = index;
+			write_tag(BinaryState::TAG_STRING);
+		}
+		else
+			write_tag(BinaryState::TAG_LONG_STRING);
+		write_varint(utf8.size());
+		append(utf8.data(), utf8.size());
+	}
+
+	void BinaryStateWriter::write_varint(uint64_t value)
+	{
+		char bytes[10];
+		size_t count = 0;
+		do
+		{
+			char byte = static_cast<char>(value & 0x7f);
+			value >>= 7;
+			bytes[count++] = static_cast<char>(byte | (value != 0 ? 0x80 : 0));
+		} while (value != 0);
+		append(bytes, count);
+	}
+
+	void BinaryStateWriter::write_tag(BinaryState::Tag tag)
+	{
+		char byte = static_cast<char>(tag);
+		append(&byte, 1);
+	}
+
+	void BinaryStateWriter::append(const char *data, size_t length)
+	{
+		buffer.append(data, length);
+		if (buffer.size() >= chunk_size)
+			flush();
+	}
+
+	void BinaryStateWriter::flush()
+	{
+		if (!failed && !sink.write(buffer.data(), buffer.size()))
+			fail("State serialization has been aborted");
+		buffer.clear();
+	}
+
+	BinaryStateReader::~BinaryStateReader()
+	{
+		for (size_t i = 0; i < strings.size(); i++)
+			strings[i].Dispose();
+	}
+
+	v8::Handle<v8::Value> BinaryStateReader::deserialize()
+	{
+		v8::HandleScope handle_scope;
+		if (length < sizeof(MAGIC) + 1 || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+			return fail("Not a binary state");
+		if (static_cast<uint8_t>(data[sizeof(MAGIC)]) != BinaryState::VERSION)
+			return fail("Unsupported binary state version");
+		position = sizeof(MAGIC) + 1;
+		v8::Handle<v8::Value> value = read_value(0);
+		if (value.IsEmpty())
+			return value;
+		if (position != length)
+			return fail("Unexpected data after the end of the binary state");
+		return handle_scope.Close(value);
+	}
+
+	v8::Handle<v8::Value> BinaryStateReader::read_value(int depth)
+	{
+		if (position >= length)
+			return fail("Unexpected end of binary state");
+		if (depth > MAX_DEPTH)
+			return fail("Binary state is nested too deeply");
+		uint8_t tag = static_cast<uint8_t>(data[position++]);
+		switch (tag)
+		{
+		case BinaryState::TAG_NULL:
+			return v8::Null();
+		case BinaryState::TAG_FALSE:
+			return v8::False();
+		case BinaryState::TAG_TRUE:
+			return v8::True();
+		case BinaryState::TAG_INTEGER:
+			{
+				uint64_t zigzag;
+				if (!read_varint(zigzag))
+					return v8::Handle<v8::Value>();
+				int64_t integer = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+				return v8::Number::New(static_cast<double>(integer));
+			}
+		case BinaryState::TAG_DOUBLE:
+			{
+				if (length - position < 8)
+					return fail("Unexpected end of binary state");
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; i++)
+					bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[position++])) << (i * 8);
+				double number;
+				memcpy(&number, &bits, sizeof(number));
+				return v8::Number::New(number);
+			}
+		case BinaryState::TAG_STRING:
+		case BinaryState::TAG_STRING_REF:
+		case BinaryState::TAG_LONG_STRING:
+			{
+				position--;
+				v8::Handle<v8::String> string;
+				if (!read_string(string))
+					return v8::Handle<v8::Value>();
+				return string;
+			}
+		case BinaryState::TAG_ARRAY:
+			{
+				v8::HandleScope handle_scope;
+				v8::Handle<v8::Array> array = v8::Array::New();
+				uint32_t index = 0;
+				while (position < length && static_cast<uint8_t>(data[position]) != BinaryState::TAG_END)
+				{
+					v8::HandleScope element_scope;
+					v8::Handle<v8::Value> element = read_value(depth + 1);
+					if (element.IsEmpty())
+						return v8::Handle<v8::Value>();
+					array->Set(index++, element);
+				}
+				if (position++ >= length)
+					return fail("Unexpected end of binary state");
+				return handle_scope.Close(array);
+			}
+		case BinaryState::TAG_OBJECT:
+			{
+				v8::HandleScope handle_scope;
+				v8::Handle<v8::Object> object = v8::Object::New();
+				while (position < length && static_cast<uint8_t>(data[position]) != BinaryState::TAG_END)
+				{
+					v8::HandleScope member_scope;
+					v8::Handle<v8::String> name;
+					if (!read_string(name))
+						return v8::Handle<v8::Value>();
+					v8::Handle<v8::Value> member = read_value(depth + 1);
+					if (member.IsEmpty())
+						return v8::Handle<v8::Value>();
+					// an own "__proto__" property stays one, as it does with JSON.parse
+					object->ForceSet(name, member);
+				}
+				if (position++ >= length)
+					return fail("Unexpected end of binary state");
+				return handle_scope.Close(object);
+			}
+		default:
+			return fail("Invalid binary state tag");
+		}
+	}
+
+	bool BinaryStateReader::read_varint(uint64_t &value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (position >= length)
+			{
+				fail("Unexpected end of binary state");
+				return false;
+			}
+			uint8_t byte = static_cast<uint8_t>(data[position++]);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		fail("Invalid varint in binary state");
+		return false;
+	}
+
+	bool BinaryStateReader::read_string(v8::Handle<v8::String> &string)
+	{
+		if (position >= length)
+		{
+			fail("Unexpected end of binary state");
+			return false;
+		}
+		uint8_t tag = static_cast<uint8_t>(data[position++]);
+		uint64_t value;
+		if (!read_varint(value))
+			return false;
+		if (tag == BinaryState::TAG_STRING_REF)
+		{
+			if (value >= strings.size())
+			{
+				fail("Invalid string reference in binary state");
+				return false;
+			}
+			string = strings[static_cast<size_t>(value)];
+			return true;
+		}
+		if (tag != BinaryState::TAG_STRING && tag != BinaryState::TAG_LONG_STRING)
+		{
+			fail("Expected a string in binary state");
+			return false;
+		}
+		if (value > length - position)
+		{
+			fail("Unexpected end of binary state");
+			return false;
+		}
+		string = v8::String::New(data + position, static_cast<int>(value));
+		position += static_cast<size_t>(value);
+		if (tag == BinaryState::TAG_STRING)
+			strings.push_back(v8::Persistent<v8::String>::New(string));
+		return true;
+	}
+
+	v8::Handle<v8::Value> BinaryStateReader::fail(const char *message)
+	{
+		if (error.empty())
+		{
+			char position_text[64];
+			sprintf(position_text, " at byte %llu", static_cast<unsigned long long>(position));
+			error = std::string(message) + position_text;
+		}
+		return v8::Handle<v8::Value>();
+	}
+
+}
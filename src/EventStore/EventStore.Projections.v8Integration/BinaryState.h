@@ -0,0 +1,112 @@
+#pragma once
+#include "StateSerializer.h"
+#include "StateWalker.h"
+
+namespace js1 
+{
+
+	// Compact tagged binary encoding of projection states.  
+	//
+	// The encoding starts with the magic "JS1S" and a version byte followed by a single 
+	// value.  Every value starts with a tag byte; integers are zigzag LEB128 varints and 
+	// strings of up to MAX_INTERNED_LENGTH bytes are written once and referred to by 
+	// their index afterwards, which makes repeated keys of partitioned states cheap.  
+	// Values are converted with the JSON rules (toJSON is honoured, undefined and 
+	// functions are omitted), so exporting and importing is equivalent to a JSON round trip.
+	class BinaryState 
+	{
+	public:
+		enum Tag 
+		{
+			TAG_NULL = 0,
+			TAG_FALSE = 1,
+			TAG_TRUE = 2,
+			TAG_INTEGER = 3,        // zigzag varint
+			TAG_DOUBLE = 4,         // 8 bytes little endian
+			TAG_STRING = 5,         // varint length, UTF-8 bytes; added to the string table
+			TAG_STRING_REF = 6,     // varint index into the string table
+			TAG_LONG_STRING = 7,    // varint length, UTF-8 bytes; not added to the string table
+			TAG_ARRAY = 8,          // values followed by TAG_END
+			TAG_OBJECT = 9,         // (key string, value) pairs followed by TAG_END
+			TAG_END = 10
+		};
+
+		static const uint8_t VERSION = 1;
+		static const size_t MAX_INTERNED_LENGTH = 128;
+	};
+
+	// Must be called within a context
+	class BinaryStateWriter : private StateWalker 
+	{
+	public:
+		BinaryStateWriter(ChunkSink &sink_, size_t chunk_size_);
+
+		// returns false if the sink aborted, a toJSON threw (the exception is left in 
+		// the caller's TryCatch) or the value cannot be serialized
+		bool serialize(v8::Handle<v8::Value> value);
+
+		using StateWalker::get_error;
+
+	private:
+		ChunkSink &sink;
+		size_t chunk_size;
+		std::string buffer;
+		std::map<std::string, uint32_t> strings;
+
+		virtual void write_null();
+		virtual void write_boolean(bool value);
+		virtual void write_number(double number);
+		virtual void write_string(v8::Handle<v8::String> string);
+		virtual void begin_object();
+		virtual void write_key(v8::Handle<v8::String> name, bool first);
+		virtual void end_object();
+		virtual void begin_array();
+		virtual void begin_element(bool first);
+		virtual void end_array();
+
+		void write_tag(BinaryState::Tag tag);
+		void write_varint(uint64_t value);
+		void append(const char *data, size_t length);
+		void flush();
+
+		BinaryStateWriter(const BinaryStateWriter &);
+		BinaryStateWriter& operator=(const BinaryStateWriter &);
+	};
+
+	// Must be called within a context
+	class BinaryStateReader 
+	{
+	public:
+		BinaryStateReader(const char *data_, size_t length_) : data(data_), length(length_), position(0) 
+		{
+		}
+
+		~BinaryStateReader();
+
+		// returns an empty handle with the error set if the data is not a valid encoding
+		v8::Handle<v8::Value> deserialize();
+
+		const std::string &get_error() const
+		{
+			return error;
+		}
+
+	private:
+		static const int MAX_DEPTH = 4096;
+
+		const char *data;
+		size_t length;
+		size_t position;
+		std::vector<v8::Persistent<v8::String> > strings;
+		std::string error;
+
+		v8::Handle<v8::Value> read_value(int depth);
+		bool read_varint(uint64_t &value);
+		bool read_string(v8::Handle<v8::String> &string);
+		v8::Handle<v8::Value> fail(const char *message);
+
+		BinaryStateReader(const BinaryStateReader &);
+		BinaryStateReader& operator=(const BinaryStateReader &);
+	};
+
+}
@@ -0,0 +1,388 @@
+#include "stdafx.h"
+#include "Capture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace js1 
+{
+	namespace 
+	{
+		const char MAGIC[8] = { 'J', 'S', '1', 'T', 'R', 'A', 'C', 'E' };
+		const size_t FILE_HEADER_SIZE = sizeof(MAGIC) + 4;
+		const size_t RECORD_HEADER_SIZE = 5;
+
+		void append_uint32(std::string &buffer, uint32_t value)
+		{
+			for (int i = 0; i < 4; i++)
+				buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+		}
+
+		void append_uint64(std::string &buffer, uint64_t value)
+		{
+			for (int i = 0; i < 8; i++)
+				buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+		}
+
+		void append_utf16(std::string &buffer, const uint16_t *value)
+		{
+			uint32_t length = 0;
+			if (value != NULL)
+				while (value[length] != 0)
+					length++;
+			append_uint32(buffer, length);
+			for (uint32_t i = 0; i < length; i++)
+			{
+				buffer.push_back(static_cast<char>(value[i] & 0xff));
+				buffer.push_back(static_cast<char>(value[i] >> 8));
+			}
+		}
+
+		void append_utf8(std::string &buffer, const std::string &value)
+		{
+			append_uint32(buffer, static_cast<uint32_t>(value.size()));
+			buffer.append(value);
+		}
+
+		uint64_t script_id(void *script)
+		{
+			return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(script));
+		}
+
+		class PayloadReader 
+		{
+		public:
+			PayloadReader(const std::string &payload_) : payload(payload_), position(0), failed(false) 
+			{
+			}
+
+			uint32_t read_uint32()
+			{
+				return static_cast<uint32_t>(read_bytes(4));
+			}
+
+			uint64_t read_uint64()
+			{
+				return read_bytes(8);
+			}
+
+			void read_utf16(std::vector<uint16_t> &value)
+			{
+				uint32_t length = read_uint32();
+				value.clear();
+				if (!check(static_cast<uint64_t>(length) * 2))
+					length = 0;
+				value.reserve(length + 1);
+				for (uint32_t i = 0; i < length; i++)
+				{
+					value.push_back(static_cast<uint16_t>(
+						static_cast<unsigned char>(payload[position]) | (static_cast<unsigned char>(payload[position + 1]) << 8)));
+					position += 2;
+				}
+				value.push_back(0);
+			}
+
+			void read_utf8(std::string &value)
+			{
+				uint32_t length = read_uint32();
+				if (!check(length))
+					length = 0;
+				value.assign(payload, position, length);
+				position += length;
+			}
+
+			bool is_failed() const
+			{
+				return failed;
+			}
+
+		private:
+			const std::string &payload;
+			size_t position;
+			bool failed;
+
+			bool check(uint64_t size)
+			{
+				if (failed || position + size > payload.size())
+				{
+					failed = true;
+					return false;
+				}
+				return true;
+			}
+
+			uint64_t read_bytes(int count)
+			{
+				if (!check(count))
+					return 0;
+				uint64_t value = 0;
+				for (int i = 0; i < count; i++)
+					value |= static_cast<uint64_t>(static_cast<unsigned char>(payload[position++])) << (i * 8);
+				return value;
+			}
+		};
+	}
+
+	volatile bool Capture::enabled = false;
+	FILE *Capture::file = NULL;
+	bool Capture::failed = false;
+	std::string Capture::file_name;
+	uint64_t Capture::max_file_size = 0;
+	int32_t Capture::max_files = 0;
+	uint64_t Capture::file_size = 0;
+	uint64_t Capture::next_sequence = 0;
+	std::map<uint64_t, std::string> Capture::live_records;
+	std::map<uint64_t, uint64_t> Capture::live_scripts;
+	platform::Mutex Capture::lock;
+
+	bool Capture::start(const std::string &file_name_, uint64_t max_file_size_, int32_t max_files_)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (file != NULL)
+			return false;
+		file_name = file_name_;
+		max_file_size = max_file_size_;
+		max_files = max_files_;
+		failed = false;
+		if (!open_file())
+			return false;
+		// scripts compiled before the capture was started cannot be replayed
+		live_records.clear();
+		live_scripts.clear();
+		enabled = true;
+		return true;
+	}
+
+	bool Capture::stop()
+	{
+		platform::ScopedLock scoped_lock(lock);
+		enabled = false;
+		if (file != NULL)
+		{
+			if (fclose(file) != 0)
+				failed = true;
+			file = NULL;
+		}
+		live_records.clear();
+		live_scripts.clear();
+		return !failed;
+	}
+
+	void Capture::record_compile(RecordType type, void *script, void *prelude, const uint16_t *file_name, const uint16_t *source)
+	{
+		std::string payload;
+		append_uint64(payload, script_id(script));
+		if (type != COMPILE_PRELUDE)
+			append_uint64(payload, script_id(prelude));
+		append_utf16(payload, file_name);
+		append_utf16(payload, source);
+
+		platform::ScopedLock scoped_lock(lock);
+		if (file == NULL)
+			return;
+		write_record(type, payload);
+
+		std::string record;
+		record.push_back(static_cast<char>(type));
+		append_uint32(record, static_cast<uint32_t>(payload.size()));
+		record.append(payload);
+		uint64_t sequence = next_sequence++;
+		live_records[sequence].swap(record);
+		live_scripts[script_id(script)] = sequence;
+	}
+
+	void Capture::record_execute(void *script, const std::string &handler_name, const uint16_t *data_json, 
+		const uint16_t *data_other[], int32_t other_length, int32_t result_length, uint64_t duration_us)
+	{
+		std::string payload;
+		append_uint64(payload, script_id(script));
+		append_utf8(payload, handler_name);
+		append_utf16(payload, data_json);
+		append_uint32(payload, static_cast<uint32_t>(other_length));
+		for (int32_t i = 0; i < other_length; i++)
+			append_utf16(payload, data_other[i]);
+		append_uint32(payload, static_cast<uint32_t>(result_length));
+		append_uint64(payload, duration_us);
+
+		platform::ScopedLock scoped_lock(lock);
+		if (file == NULL)
+			return;
+		write_record(EXECUTE, payload);
+	}
+
+	void Capture::record_dispose(void *script)
+	{
+		std::string payload;
+		append_uint64(payload, script_id(script));
+
+		platform::ScopedLock scoped_lock(lock);
+		if (file == NULL)
+			return;
+		write_record(DISPOSE, payload);
+		std::map<uint64_t, uint64_t>::iterator it = live_scripts.find(script_id(script));
+		if (it != live_scripts.end())
+		{
+			live_records.erase(it->second);
+			live_scripts.erase(it);
+		}
+	}
+
+	bool Capture::open_file()
+	{
+		file = fopen(file_name.c_str(), "wb");
+		if (file == NULL)
+			return false;
+		std::string header(MAGIC, sizeof(MAGIC));
+		append_uint32(header, VERSION);
+		file_size = 0;
+		return write(header);
+	}
+
+	void Capture::rotate()
+	{
+		fclose(file);
+		file = NULL;
+
+		char suffix[16];
+		sprintf(suffix, ".%d", max_files);
+		remove((file_name + suffix).c_str());
+		for (int32_t i = max_files - 1; i >= 1; i--)
+		{
+			char next_suffix[16];
+			sprintf(suffix, ".%d", i);
+			sprintf(next_suffix, ".%d", i + 1);
+			rename((file_name + suffix).c_str(), (file_name + next_suffix).c_str());
+		}
+		if (max_files > 0)
+			rename(file_name.c_str(), (file_name + ".1").c_str());
+
+		if (!open_file())
+		{
+			fail();
+			return;
+		}
+		for (std::map<uint64_t, std::string>::const_iterator it = live_records.begin(); it != live_records.end(); ++it)
+			if (!write(it->second))
+				return;
+	}
+
+	void Capture::write_record(RecordType type, const std::string &payload)
+	{
+		uint64_t size = RECORD_HEADER_SIZE + payload.size();
+		if (max_file_size > 0 && file_size > FILE_HEADER_SIZE && file_size + size > max_file_size)
+		{
+			rotate();
+			if (file == NULL)
+				return;
+		}
+
+		std::string header;
+		header.push_back(static_cast<char>(type));
+		append_uint32(header, static_cast<uint32_t>(payload.size()));
+		if (write(header))
+			write(payload);
+	}
+
+	bool Capture::write(const std::string &data)
+	{
+		if (fwrite(data.data(), 1, data.size(), file) != data.size())
+		{
+			fail();
+			return false;
+		}
+		file_size += data.size();
+		return true;
+	}
+
+	void Capture::fail()
+	{
+		failed = true;
+		enabled = false;
+		if (file != NULL)
+		{
+			fclose(file);
+			file = NULL;
+		}
+	}
+
+	bool CaptureReader::open(const std::string &file_name)
+	{
+		close();
+		file = fopen(file_name.c_str(), "rb");
+		if (file == NULL)
+			return false;
+		unsigned char header[FILE_HEADER_SIZE];
+		if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+		{
+			close();
+			return false;
+		}
+		const unsigned char *version = header + sizeof(MAGIC);
+		if ((version[0] | (version[1] << 8) | (version[2] << 16) | (static_cast<uint32_t>(version[3]) << 24)) != Capture::VERSION)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void CaptureReader::close()
+	{
+		if (file != NULL)
+		{
+			fclose(file);
+			file = NULL;
+		}
+	}
+
+	bool CaptureReader::read(Record &record)
+	{
+		if (file == NULL)
+			return false;
+		unsigned char header[RECORD_HEADER_SIZE];
+		if (fread(header, 1, sizeof(header), file) != sizeof(header))
+			return false;
+		uint32_t size = header[1] | (header[2] << 8) | (header[3] << 16) | (static_cast<uint32_t>(header[4]) << 24);
+		std::string payload(size, '\0');
+		if (size > 0 && fread(&payload[0], 1, size, file) != size)
+			return false;
+
+		PayloadReader reader(payload);
+		record.type = static_cast<Capture::RecordType>(header[0]);
+		record.id = reader.read_uint64();
+		record.prelude_id = 0;
+		record.data_other.clear();
+		switch (record.type)
+		{
+		case Capture::COMPILE_MODULE:
+		case Capture::COMPILE_QUERY:
+			record.prelude_id = reader.read_uint64();
+			// fall through
+		case Capture::COMPILE_PRELUDE:
+			reader.read_utf16(record.file_name);
+			reader.read_utf16(record.source);
+			break;
+		case Capture::EXECUTE:
+			{
+				reader.read_utf8(record.handler_name);
+				reader.read_utf16(record.data_json);
+				uint32_t other_length = reader.read_uint32();
+				for (uint32_t i = 0; i < other_length && !reader.is_failed(); i++)
+				{
+					record.data_other.push_back(std::vector<uint16_t>());
+					reader.read_utf16(record.data_other.back());
+				}
+				record.result_length = static_cast<int32_t>(reader.read_uint32());
+				record.duration_us = reader.read_uint64();
+				break;
+			}
+		case Capture::DISPOSE:
+			break;
+		default:
+			// unknown record types written by a newer version are skipped
+			break;
+		}
+		return !reader.is_failed();
+	}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "platform.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+
+	// Appends every compile_* and execute_command_handler call made while enabled to a 
+	// binary trace which can be replayed with js1replay.  
+	//
+	// A trace file starts with the 8 byte magic "JS1TRACE" and a uint32 version followed 
+	// by records of a uint8 type, a uint32 payload length and the payload.  Integers are 
+	// little endian, UTF-16 strings are a uint32 length in code units followed by the code 
+	// units, UTF-8 strings are a uint32 length in bytes followed by the bytes.
+	//
+	// When a file grows over max_file_size it is rotated to <file>.1 (<file>.1 to <file>.2 
+	// and so on up to max_files) and the compile records of all the live scripts are written 
+	// again at the start of the new file, so that every file can be replayed on its own.
+	//
+	// A failed write (or rotation) ends the capture, as the trace cannot be replayed past 
+	// it anyway; stop reports whether the capture has been written completely.
+	class Capture 
+	{
+	public:
+		enum RecordType 
+		{
+			COMPILE_PRELUDE = 1, // uint64 id, utf16 file_name, utf16 source
+			COMPILE_MODULE = 2,  // uint64 id, uint64 prelude_id, utf16 file_name, utf16 source
+			COMPILE_QUERY = 3,   // uint64 id, uint64 prelude_id, utf16 file_name, utf16 source
+			EXECUTE = 4,         // uint64 id, utf8 handler, utf16 data_json, uint32 count, utf16 data_other[count], int32 result_length, uint64 duration_us
+			DISPOSE = 5          // uint64 id
+		};
+
+		static const uint32_t VERSION = 1;
+
+		static bool start(const std::string &file_name, uint64_t max_file_size, int32_t max_files);
+		// returns false if the capture has been ended early by a write failure
+		static bool stop();
+
+		static bool is_enabled()
+		{
+			return enabled;
+		}
+
+		static void record_compile(RecordType type, void *script, void *prelude, const uint16_t *file_name, const uint16_t *source);
+		static void record_execute(void *script, const std::string &handler_name, const uint16_t *data_json, 
+			const uint16_t *data_other[], int32_t other_length, int32_t result_length, uint64_t duration_us);
+		static void record_dispose(void *script);
+
+	private:
+		static volatile bool enabled;
+		static FILE *file;
+		static bool failed;
+		static std::string file_name;
+		static uint64_t max_file_size;
+		static int32_t max_files;
+		static uint64_t file_size;
+		static uint64_t next_sequence;
+		// compile records of the live scripts by sequence number and the sequence number of each script
+		static std::map<uint64_t, std::string> live_records;
+		static std::map<uint64_t, uint64_t> live_scripts;
+		static platform::Mutex lock;
+
+		static bool open_file();
+		static void rotate();
+		static void write_record(RecordType type, const std::string &payload);
+		static bool write(const std::string &data);
+		static void fail();
+	};
+
+	// Reads the records of a trace written by Capture
+	class CaptureReader 
+	{
+	public:
+		struct Record 
+		{
+			Capture::RecordType type;
+			uint64_t id;
+			uint64_t prelude_id;
+			std::vector<uint16_t> file_name;
+			std::vector<uint16_t> source;
+			std::string handler_name;
+			std::vector<uint16_t> data_json;
+			std::vector<std::vector<uint16_t> > data_other;
+			int32_t result_length;
+			uint64_t duration_us;
+		};
+
+		CaptureReader() : file(NULL) 
+		{
+		}
+
+		~CaptureReader()
+		{
+			close();
+		}
+
+		bool open(const std::string &file_name);
+		void close();
+
+		// UTF-16 strings in the record are null-terminated; returns false at the end of the trace or on a truncated record
+		bool read(Record &record);
+
+	private:
+		FILE *file;
+
+		CaptureReader(const CaptureReader &);
+		CaptureReader& operator=(const CaptureReader &);
+	};
+
+}
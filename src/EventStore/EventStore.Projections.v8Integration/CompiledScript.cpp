@@ -2,6 +2,7 @@
 #include "PreludeScope.h"
 #include "CompiledScript.h"
 #include "EventHandler.h"
+#include "IsolateData.h"
 
 #include <string>
 
@@ -91,16 +92,24 @@ namespace js1
 
 	void CompiledScript::isolate_add_ref(v8::Isolate * isolate) 
 	{
-		size_t counter = reinterpret_cast<size_t>(isolate->GetData());
-		counter++;
-		isolate->SetData(reinterpret_cast<void *>(counter));
+		IsolateData *isolate_data = IsolateData::get(isolate);
+		if (isolate_data == NULL)
+		{
+			isolate_data = new IsolateData();
+			isolate->SetData(isolate_data);
+		}
+		isolate_data->ref_count++;
 	}
 
 	size_t CompiledScript::isolate_release(v8::Isolate * isolate) 
 	{
-		size_t counter = reinterpret_cast<size_t>(isolate->GetData());
-		counter--;
-		isolate->SetData(reinterpret_cast<void *>(counter));
+		IsolateData *isolate_data = IsolateData::get(isolate);
+		size_t counter = --isolate_data->ref_count;
+		if (counter == 0)
+		{
+			isolate->SetData(NULL);
+			delete isolate_data;
+		}
 		return counter;
 	}
 }
@@ -18,6 +18,10 @@ namespace js1 {
 		v8::Handle<v8::Value> run_script(v8::Persistent<v8::Context> context);
 		void set_last_error(bool is_error, v8::TryCatch &try_catch);
 		void set_last_error(v8::Handle<v8::String> message);
+		bool has_last_error() const 
+		{
+			return !last_exception.IsEmpty();
+		}
 		static void isolate_add_ref(v8::Isolate * isolate);
 		static size_t isolate_release(v8::Isolate * isolate);
 	private:
@@ -0,0 +1,257 @@
+#include "stdafx.h"
+#include "CountMinSketch.h"
+
+namespace js1 
+{
+
+	const NativeType CountMinSketch::TYPE = { "CountMinSketch" };
+
+	namespace 
+	{
+		const uint8_t SERIALIZATION_VERSION = 1;
+		const uint8_t DENSE_ENCODING = 0;
+		const uint8_t SPARSE_ENCODING = 1;
+		const uint32_t DEFAULT_WIDTH = 2048;
+		const uint32_t DEFAULT_DEPTH = 4;
+		const uint32_t MAX_WIDTH = 1 << 20;
+		const uint32_t MAX_DEPTH = 16;
+
+		bool read_dimension(v8::Handle<v8::Value> value, uint32_t default_value, uint32_t max_value, uint32_t &result)
+		{
+			if (value.IsEmpty() || value->IsUndefined())
+			{
+				result = default_value;
+				return true;
+			}
+			if (!value->IsNumber())
+				return false;
+			int32_t number = value->Int32Value();
+			if (number <= 0 || static_cast<uint32_t>(number) > max_value)
+				return false;
+			result = static_cast<uint32_t>(number);
+			return true;
+		}
+	}
+
+	v8::Handle<v8::FunctionTemplate> CountMinSketch::create_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(TYPE, constructor_callback);
+		set_method(result, "add", add_callback);
+		set_method(result, "estimate", estimate_callback);
+		set_method(result, "merge", merge_callback);
+		set_method(result, "total", total_callback);
+		set_method(result, "toJSON", to_json_callback);
+		return handle_scope.Close(result);
+	}
+
+	CountMinSketch::CountMinSketch(uint32_t width_, uint32_t depth_) : 
+		NativeObject(TYPE), width(width_), depth(depth_), total(0), counters(static_cast<size_t>(width_) * depth_, 0)
+	{
+		set_external_size(counters.size() * sizeof(uint64_t));
+	}
+
+	size_t CountMinSketch::index_of(uint64_t hash, uint32_t row) const
+	{
+		// rows are indexed by h1 + row * h2 of the two halves of the value hash
+		uint32_t h1 = static_cast<uint32_t>(hash);
+		uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+		return static_cast<size_t>(row) * width + (h1 + row * h2) % width;
+	}
+
+	uint64_t CountMinSketch::add(uint64_t hash, uint64_t count)
+	{
+		uint64_t result = counters[index_of(hash, 0)] += count;
+		for (uint32_t row = 1; row < depth; row++)
+		{
+			uint64_t counter = counters[index_of(hash, row)] += count;
+			if (counter < result)
+				result = counter;
+		}
+		total += count;
+		return result;
+	}
+
+	uint64_t CountMinSketch::estimate(uint64_t hash) const
+	{
+		uint64_t result = counters[index_of(hash, 0)];
+		for (uint32_t row = 1; row < depth; row++)
+		{
+			uint64_t counter = counters[index_of(hash, row)];
+			if (counter < result)
+				result = counter;
+		}
+		return result;
+	}
+
+	bool CountMinSketch::merge(const CountMinSketch &other)
+	{
+		if (other.width != width || other.depth != depth)
+			return false;
+		for (size_t i = 0; i < counters.size(); i++)
+			counters[i] += other.counters[i];
+		total += other.total;
+		return true;
+	}
+
+	void CountMinSketch::serialize(std::string &data) const
+	{
+		size_t non_zero = 0;
+		for (size_t i = 0; i < counters.size(); i++)
+			if (counters[i] != 0)
+				non_zero++;
+
+		NativeWriter writer(data);
+		writer.write_byte(SERIALIZATION_VERSION);
+		writer.write_varint(width);
+		writer.write_varint(depth);
+		writer.write_varint(total);
+		// a dense counter takes at least a byte and a sparse one at least two, so empty and 
+		// young sketches are written as the gaps between their non-zero counters
+		if (non_zero * 2 < counters.size())
+		{
+			writer.write_byte(SPARSE_ENCODING);
+			writer.write_varint(non_zero);
+			size_t gap = 0;
+			for (size_t i = 0; i < counters.size(); i++)
+			{
+				if (counters[i] == 0)
+				{
+					gap++;
+					continue;
+				}
+				writer.write_varint(gap);
+				writer.write_varint(counters[i]);
+				gap = 0;
+			}
+		}
+		else
+		{
+			writer.write_byte(DENSE_ENCODING);
+			for (size_t i = 0; i < counters.size(); i++)
+				writer.write_varint(counters[i]);
+		}
+	}
+
+	CountMinSketch *CountMinSketch::deserialize(const std::string &data)
+	{
+		NativeReader reader(data);
+		if (reader.read_byte() != SERIALIZATION_VERSION)
+			return NULL;
+		uint64_t width = reader.read_varint();
+		uint64_t depth = reader.read_varint();
+		if (reader.has_failed() || width == 0 || width > MAX_WIDTH || depth == 0 || depth > MAX_DEPTH)
+			return NULL;
+
+		CountMinSketch *result = new CountMinSketch(static_cast<uint32_t>(width), static_cast<uint32_t>(depth));
+		result->total = reader.read_varint();
+		uint8_t encoding = reader.read_byte();
+		if (encoding == SPARSE_ENCODING)
+		{
+			uint64_t non_zero = reader.read_varint();
+			if (non_zero > result->counters.size())
+			{
+				delete result;
+				return NULL;
+			}
+			size_t position = 0;
+			for (uint64_t i = 0; i < non_zero && !reader.has_failed(); i++)
+			{
+				uint64_t gap = reader.read_varint();
+				if (gap >= result->counters.size() - position)
+				{
+					delete result;
+					return NULL;
+				}
+				position += static_cast<size_t>(gap);
+				result->counters[position++] = reader.read_varint();
+			}
+		}
+		else if (encoding == DENSE_ENCODING)
+		{
+			for (size_t i = 0; i < result->counters.size() && !reader.has_failed(); i++)
+				result->counters[i] = reader.read_varint();
+		}
+		else
+		{
+			delete result;
+			return NULL;
+		}
+		if (reader.has_failed() || !reader.at_end())
+		{
+			delete result;
+			return NULL;
+		}
+		return result;
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("CountMinSketch must be called with new");
+
+		CountMinSketch *sketch = NULL;
+		if (args.Length() > 0 && args[0]->IsObject())
+		{
+			std::string data;
+			if (!from_json_object(args[0], TYPE, data) || (sketch = deserialize(data)) == NULL)
+				return throw_error("Invalid CountMinSketch state");
+		}
+		else
+		{
+			uint32_t width, depth;
+			if (!read_dimension(args[0], DEFAULT_WIDTH, MAX_WIDTH, width) || !read_dimension(args[1], DEFAULT_DEPTH, MAX_DEPTH, depth))
+				return throw_error("CountMinSketch width must be between 1 and 1048576 and depth between 1 and 16");
+			sketch = new CountMinSketch(width, depth);
+		}
+		sketch->wrap(args.This());
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::add_callback(const v8::Arguments& args)
+	{
+		CountMinSketch *sketch = unwrap_this(args);
+		uint64_t count;
+		if (args.Length() < 1 || !read_count(args, 1, count))
+			return throw_error("CountMinSketch.add expects a value and an optional non-negative integer count");
+		return v8::Number::New(static_cast<double>(sketch->add(hash_value(args[0]), count)));
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::estimate_callback(const v8::Arguments& args)
+	{
+		CountMinSketch *sketch = unwrap_this(args);
+		if (args.Length() != 1)
+			return throw_error("CountMinSketch.estimate expects 1 argument");
+		return v8::Number::New(static_cast<double>(sketch->estimate(hash_value(args[0]))));
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::merge_callback(const v8::Arguments& args)
+	{
+		CountMinSketch *sketch = unwrap_this(args);
+		CountMinSketch *other = static_cast<CountMinSketch *>(unwrap(args[0], TYPE));
+		if (other == NULL)
+			return throw_error("CountMinSketch.merge expects a CountMinSketch");
+		if (!sketch->merge(*other))
+			return throw_error("CountMinSketch.merge expects a CountMinSketch of the same width and depth");
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::total_callback(const v8::Arguments& args)
+	{
+		return v8::Number::New(static_cast<double>(unwrap_this(args)->total));
+	}
+
+	v8::Handle<v8::Value> CountMinSketch::to_json_callback(const v8::Arguments& args)
+	{
+		std::string data;
+		unwrap_this(args)->serialize(data);
+		return to_json_object(TYPE, data);
+	}
+
+	CountMinSketch *CountMinSketch::unwrap_this(const v8::Arguments& args)
+	{
+		// the signature guarantees the receiver is a CountMinSketch
+		return static_cast<CountMinSketch *>(unwrap(args.Holder(), TYPE));
+	}
+
+}
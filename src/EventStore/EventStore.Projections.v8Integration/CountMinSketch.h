@@ -0,0 +1,49 @@
+#pragma once
+#include "NativeObject.h"
+
+namespace js1 
+{
+
+	// Count-min sketch exposed to query scripts as CountMinSketch.
+	//
+	// new CountMinSketch([width], [depth]) keeps depth rows of width counters (default 
+	// 2048 x 4, 64KB), so counts are overestimated by at most total * e / width with 
+	// probability 1 - e^-depth.  add(value, [count]) returns the new estimate of value, 
+	// estimate(value) reads it, merge(other) adds a sketch of the same dimensions and 
+	// total() is the sum of all the counts added.  Sketches with mostly empty counters 
+	// are serialized sparsely, so a new sketch does not add its full size to the state.
+	class CountMinSketch : public NativeObject 
+	{
+	public:
+		static const NativeType TYPE;
+
+		static v8::Handle<v8::FunctionTemplate> create_template();
+
+		CountMinSketch(uint32_t width, uint32_t depth);
+
+		uint64_t add(uint64_t hash, uint64_t count);
+		uint64_t estimate(uint64_t hash) const;
+		bool merge(const CountMinSketch &other);
+
+		void serialize(std::string &data) const;
+		static CountMinSketch *deserialize(const std::string &data);
+
+	private:
+		uint32_t width;
+		uint32_t depth;
+		uint64_t total;
+		std::vector<uint64_t> counters;
+
+		size_t index_of(uint64_t hash, uint32_t row) const;
+
+		static v8::Handle<v8::Value> constructor_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> add_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> estimate_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> merge_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> total_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> to_json_callback(const v8::Arguments& args);
+
+		static CountMinSketch *unwrap_this(const v8::Arguments& args);
+	};
+
+}
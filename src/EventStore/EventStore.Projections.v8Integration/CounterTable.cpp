@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "CounterTable.h"
+#include "JsonWriter.h"
+
+#include <string.h>
+
+namespace js1 
+{
+	CounterTable::CounterCollection *CounterTable::counters = NULL;
+	platform::Mutex CounterTable::lock;
+
+	bool CounterTable::enable(const char *map_file_name)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (counters != NULL)
+			return true;
+
+		CounterCollection *collection;
+		if (map_file_name != NULL)
+		{
+			collection = reinterpret_cast<CounterCollection *>(platform::map_file(map_file_name, sizeof(CounterCollection)));
+			if (collection == NULL)
+				return false;
+		}
+		else
+			collection = new CounterCollection();
+
+		memset(collection, 0, sizeof(CounterCollection));
+		collection->magic_number = MAGIC_NUMBER;
+		collection->max_counters = MAX_COUNTERS;
+		collection->max_name_size = MAX_NAME_SIZE;
+		collection->counters_in_use = 0;
+		// the table is never released as isolates keep pointers to the counters
+		counters = collection;
+		return true;
+	}
+
+	bool CounterTable::is_enabled()
+	{
+		return counters != NULL;
+	}
+
+	void CounterTable::install()
+	{
+		if (!is_enabled())
+			return;
+		v8::V8::SetCounterFunction(lookup_counter);
+		v8::V8::SetCreateHistogramFunction(create_histogram);
+		v8::V8::SetAddHistogramSampleFunction(add_histogram_sample);
+	}
+
+	void CounterTable::write_json(JsonWriter &writer)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		writer.begin_object();
+		writer.member("enabled", counters != NULL);
+		writer.key("counters");
+		writer.begin_object();
+		if (counters != NULL)
+			for (uint32_t i = 0; i < counters->counters_in_use; i++)
+			{
+				Counter &counter = counters->counters[i];
+				if (counter.is_histogram)
+					continue;
+				writer.key(reinterpret_cast<const char *>(counter.name));
+				writer.value(counter.count);
+			}
+		writer.end_object();
+		writer.key("histograms");
+		writer.begin_object();
+		if (counters != NULL)
+			for (uint32_t i = 0; i < counters->counters_in_use; i++)
+			{
+				Counter &counter = counters->counters[i];
+				if (!counter.is_histogram)
+					continue;
+				writer.key(reinterpret_cast<const char *>(counter.name));
+				writer.begin_object();
+				writer.member("count", counter.count);
+				writer.member("total", counter.sample_total);
+				writer.end_object();
+			}
+		writer.end_object();
+		writer.end_object();
+	}
+
+	CounterTable::Counter *CounterTable::get_counter(const char *name, bool is_histogram)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (counters == NULL)
+			return NULL;
+
+		for (uint32_t i = 0; i < counters->counters_in_use; i++)
+		{
+			Counter &counter = counters->counters[i];
+			if (counter.is_histogram == is_histogram && strncmp(reinterpret_cast<const char *>(counter.name), name, MAX_NAME_SIZE - 1) == 0)
+				return &counter;
+		}
+		if (counters->counters_in_use == MAX_COUNTERS)
+			return NULL;
+
+		Counter &counter = counters->counters[counters->counters_in_use];
+		counter.count = 0;
+		counter.sample_total = 0;
+		counter.is_histogram = is_histogram;
+		strncpy(reinterpret_cast<char *>(counter.name), name, MAX_NAME_SIZE - 1);
+		counter.name[MAX_NAME_SIZE - 1] = 0;
+		counters->counters_in_use++;
+		return &counter;
+	}
+
+	int *CounterTable::lookup_counter(const char *name)
+	{
+		Counter *counter = get_counter(name, false);
+		return counter == NULL ? NULL : &counter->count;
+	}
+
+	void *CounterTable::create_histogram(const char *name, int /*min*/, int /*max*/, size_t /*buckets*/)
+	{
+		return get_counter(name, true);
+	}
+
+	void CounterTable::add_histogram_sample(void *histogram, int sample)
+	{
+		// NOTE: not synchronized, the same way V8 updates plain counters 
+		Counter *counter = reinterpret_cast<Counter *>(histogram);
+		counter->count++;
+		counter->sample_total += sample;
+	}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "platform.h"
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// Process wide table of V8 internal statistics counters and histograms.  The 
+	// memory layout is the one used by d8 --map-counters, so when the table is 
+	// backed by a file it can be scraped by external tools (i.e. v8/tools/stats-viewer.py)
+	// without calling into the process.  Counters are shared by all the isolates.
+	class CounterTable 
+	{
+	public:
+		static const uint32_t MAGIC_NUMBER = 0xDEADFACE;
+		static const int MAX_COUNTERS = 512;
+		static const int MAX_NAME_SIZE = 64;
+
+		// map_file_name can be NULL to keep the table in the process memory only
+		static bool enable(const char *map_file_name);
+		static bool is_enabled();
+
+		// installs counter callbacks into the current isolate; counters of isolates
+		// created before the table has been enabled are not collected
+		static void install();
+
+		static void write_json(JsonWriter &writer);
+
+	private:
+		struct Counter 
+		{
+			int32_t count;
+			int32_t sample_total;
+			bool is_histogram;
+			uint8_t name[MAX_NAME_SIZE];
+		};
+
+		struct CounterCollection 
+		{
+			uint32_t magic_number;
+			uint32_t max_counters;
+			uint32_t max_name_size;
+			uint32_t counters_in_use;
+			Counter counters[MAX_COUNTERS];
+		};
+
+		static CounterCollection *counters;
+		static platform::Mutex lock;
+
+		static Counter *get_counter(const char *name, bool is_histogram);
+		static int *lookup_counter(const char *name);
+		static void *create_histogram(const char *name, int min, int max, size_t buckets);
+		static void add_histogram_sample(void *histogram, int sample);
+	};
+
+}
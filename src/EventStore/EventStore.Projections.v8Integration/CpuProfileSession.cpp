@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "CpuProfileSession.h"
+#include "JsonWriter.h"
+#include "platform.h"
+
+#include <v8-profiler.h>
+#include <stdio.h>
+
+namespace js1 
+{
+
+	CpuProfileSession::CpuProfileSession() : 
+		running(false), started_us(0), deadline_us(0), stopped_us(0), completed(NULL)
+	{
+	}
+
+	CpuProfileSession::~CpuProfileSession()
+	{
+		if (running)
+			stop();
+		discard();
+	}
+
+	bool CpuProfileSession::start(const uint16_t *title_, int32_t max_duration_ms)
+	{
+		if (running)
+			return false;
+
+		v8::HandleScope handle_scope;
+		discard();
+		title = v8::Persistent<v8::String>::New(v8::String::New(title_));
+
+		v8::CpuProfiler::StartProfiling(title);
+		running = true;
+		started_us = platform::now_us();
+		deadline_us = max_duration_ms > 0 ? started_us + static_cast<uint64_t>(max_duration_ms) * 1000 : 0;
+		return true;
+	}
+
+	void CpuProfileSession::check_deadline()
+	{
+		if (running && deadline_us != 0 && platform::now_us() >= deadline_us)
+			stop();
+	}
+
+	bool CpuProfileSession::take(Format format, std::string &output)
+	{
+		if (running)
+			stop();
+		if (completed == NULL)
+			return false;
+
+		v8::HandleScope handle_scope;
+		if (format == FORMAT_FOLDED)
+			write_folded(output);
+		else
+		{
+			JsonWriter writer;
+			write_cpuprofile(writer);
+			output = writer.str();
+		}
+		discard();
+		return true;
+	}
+
+	void CpuProfileSession::stop()
+	{
+		v8::HandleScope handle_scope;
+		completed = v8::CpuProfiler::StopProfiling(title);
+		stopped_us = platform::now_us();
+		running = false;
+	}
+
+	void CpuProfileSession::discard()
+	{
+		if (completed != NULL)
+		{
+			const_cast<v8::CpuProfile *>(completed)->Delete();
+			completed = NULL;
+		}
+		title.Dispose();
+		title.Clear();
+	}
+
+	void CpuProfileSession::write_cpuprofile(JsonWriter &writer) const
+	{
+		const v8::CpuProfileNode *root = completed->GetTopDownRoot();
+		int next_id = 1;
+		writer.begin_object();
+		writer.member("title", *v8::String::Utf8Value(completed->GetTitle()));
+		// seconds of the monotonic clock, only their difference is meaningful
+		writer.member("startTime", static_cast<double>(started_us) / 1000000.0);
+		writer.member("endTime", static_cast<double>(stopped_us) / 1000000.0);
+		// this V8 keeps aggregated ticks only, so there is no sample timeline to 
+		// write and the profile is the call tree with the hit counts of each node
+		writer.key("head");
+		write_node(writer, root, next_id);
+		writer.end_object();
+	}
+
+	void CpuProfileSession::write_node(JsonWriter &writer, const v8::CpuProfileNode *node, int &next_id)
+	{
+		v8::String::Utf8Value function_name(node->GetFunctionName());
+		v8::String::Utf8Value url(node->GetScriptResourceName());
+		writer.begin_object();
+		writer.member("functionName", function_name.length() == 0 ? "(anonymous function)" : *function_name);
+		writer.member("url", *url == NULL ? "" : *url);
+		writer.member("lineNumber", node->GetLineNumber());
+		writer.member("callUID", static_cast<uint32_t>(node->GetCallUid()));
+		writer.member("id", next_id++);
+		writer.member("hitCount", static_cast<uint64_t>(node->GetSelfSamplesCount()));
+		writer.member("selfTime", node->GetSelfTime());
+		writer.member("totalTime", node->GetTotalTime());
+		writer.key("children");
+		writer.begin_array();
+		for (int i = 0; i < node->GetChildrenCount(); i++)
+			write_node(writer, node->GetChild(i), next_id);
+		writer.end_array();
+		writer.end_object();
+	}
+
+	void CpuProfileSession::write_folded(std::string &output) const
+	{
+		const v8::CpuProfileNode *root = completed->GetTopDownRoot();
+		std::string stack;
+		for (int i = 0; i < root->GetChildrenCount(); i++)
+			write_folded_node(output, stack, root->GetChild(i));
+	}
+
+	void CpuProfileSession::write_folded_node(std::string &output, std::string &stack, const v8::CpuProfileNode *node)
+	{
+		size_t parent_length = stack.size();
+		if (!stack.empty())
+			stack += ';';
+		stack += frame_name(node);
+
+		uint64_t self_samples = static_cast<uint64_t>(node->GetSelfSamplesCount());
+		if (self_samples > 0)
+		{
+			char count[32];
+			sprintf(count, " %llu\n", static_cast<unsigned long long>(self_samples));
+			output += stack;
+			output += count;
+		}
+		for (int i = 0; i < node->GetChildrenCount(); i++)
+			write_folded_node(output, stack, node->GetChild(i));
+
+		stack.resize(parent_length);
+	}
+
+	std::string CpuProfileSession::frame_name(const v8::CpuProfileNode *node)
+	{
+		v8::String::Utf8Value function_name(node->GetFunctionName());
+		v8::String::Utf8Value url(node->GetScriptResourceName());
+		std::string name = function_name.length() == 0 ? "(anonymous function)" : *function_name;
+		if (url.length() > 0)
+		{
+			char line[32];
+			sprintf(line, ":%d", node->GetLineNumber());
+			name += " (";
+			name += *url;
+			name += line;
+			name += ")";
+		}
+		// ';' separates frames in the folded format
+		for (size_t i = 0; i < name.size(); i++)
+			if (name[i] == ';')
+				name[i] = ',';
+		return name;
+	}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+namespace v8 
+{
+	class CpuProfile;
+	class CpuProfileNode;
+}
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// A bounded CPU profiling window of one isolate.  The profile stops either 
+	// explicitly or on the first handler execution or idle tick after the maximum 
+	// duration has elapsed; a completed profile is kept until it is taken by the 
+	// host or the isolate is released.
+	class CpuProfileSession 
+	{
+	public:
+		enum Format 
+		{
+			FORMAT_CPUPROFILE = 0, // Chrome DevTools .cpuprofile JSON
+			FORMAT_FOLDED = 1 // folded stacks as consumed by flamegraph.pl
+		};
+
+		CpuProfileSession();
+		~CpuProfileSession();
+
+		// all the methods (and the destructor) must be called with the isolate entered
+		bool start(const uint16_t *title, int32_t max_duration_ms);
+		void check_deadline();
+		// stops profiling if still running and serializes the profile; returns false if there is no profile
+		bool take(Format format, std::string &output);
+
+		bool is_running() const { return running; }
+
+	private:
+		bool running;
+		uint64_t started_us;
+		uint64_t deadline_us;
+		uint64_t stopped_us;
+		v8::Persistent<v8::String> title;
+		const v8::CpuProfile *completed;
+
+		void stop();
+		void discard();
+		void write_cpuprofile(JsonWriter &writer) const;
+		void write_folded(std::string &output) const;
+		static void write_node(JsonWriter &writer, const v8::CpuProfileNode *node, int &next_id);
+		static void write_folded_node(std::string &output, std::string &stack, const v8::CpuProfileNode *node);
+		static std::string frame_name(const v8::CpuProfileNode *node);
+
+		CpuProfileSession(const CpuProfileSession &);
+		CpuProfileSession& operator=(const CpuProfileSession &);
+	};
+
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "HandlerStatistics.h"
 
 namespace js1 
 {
@@ -8,7 +9,9 @@ namespace js1
 	public:
 		EventHandler(v8::Handle<v8::String> _name, v8::Handle<v8::Function> _handler):
 			name(v8::Persistent<v8::String>::New(_name)),
-			handler(v8::Persistent<v8::Function>::New(_handler))
+			handler(v8::Persistent<v8::Function>::New(_handler)),
+			native_name(*v8::String::Utf8Value(_name)),
+			read_only(false)
 		{
 		}
 
@@ -23,9 +26,33 @@ namespace js1
 			return handler;
 		}
 
+		const std::string &get_name() const
+		{
+			return native_name;
+		}
+
+		HandlerStatistics &get_statistics()
+		{
+			return statistics;
+		}
+
+		// read only handlers do not invalidate the cached state
+		bool is_read_only() const
+		{
+			return read_only;
+		}
+
+		void set_read_only(bool value)
+		{
+			read_only = value;
+		}
+
 	private:
 		v8::Persistent<v8::String> name;
 		v8::Persistent<v8::Function> handler;
+		std::string native_name;
+		HandlerStatistics statistics;
+		bool read_only;
 
 		EventHandler(const EventHandler &source){} // do not allow making copies
 		EventHandler & operator=(const EventHandler &right){} // do not allow assignments
@@ -0,0 +1,38 @@
+#include "stdafx.h"
+#include "ExecuteResult.h"
+#include "platform.h"
+
+namespace js1 
+{
+
+	ExecuteResult::ExecuteResult(size_t length_) : references(1), length(length_), data(new uint16_t[length_ + 1])
+	{
+		data[length] = 0;
+	}
+
+	ExecuteResult::~ExecuteResult()
+	{
+		delete[] data;
+	}
+
+	ExecuteResult *ExecuteResult::create(v8::Handle<v8::String> value)
+	{
+		ExecuteResult *result = new ExecuteResult(value->Length());
+		if (result->length > 0)
+			value->Write(result->data, 0, static_cast<int>(result->length), v8::String::NO_NULL_TERMINATION);
+		return result;
+	}
+
+	ExecuteResult *ExecuteResult::add_ref()
+	{
+		platform::atomic_increment(&references);
+		return this;
+	}
+
+	void ExecuteResult::release()
+	{
+		if (platform::atomic_decrement(&references) == 0)
+			delete this;
+	}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "js1.h"
+
+namespace js1 
+{
+
+	// Reference counted UTF-16 result of a command handler returned by execute_command_handler 
+	// and released by free_result.  The cached state of a query is handed out as the same 
+	// instance to every reader, so the references may be released from any thread.
+	class ExecuteResult 
+	{
+	public:
+		static ExecuteResult *create(v8::Handle<v8::String> value);
+
+		ExecuteResult *add_ref();
+		void release();
+
+		uint16_t *get_data() 
+		{
+			return data;
+		}
+
+		size_t get_length() const 
+		{
+			return length;
+		}
+
+	private:
+		ExecuteResult(size_t length_);
+		~ExecuteResult();
+
+		volatile uint64_t references;
+		size_t length;
+		uint16_t *data;
+
+		ExecuteResult(const ExecuteResult &);
+		ExecuteResult& operator=(const ExecuteResult &);
+	};
+
+}
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "platform.h"
+#include "GcStatistics.h"
+#include "IsolateData.h"
+#include "JsonWriter.h"
+#include "TraceLog.h"
+
+namespace js1 
+{
+
+	GcStatistics::GcStatistics() : pause_started_us(0)
+	{
+	}
+
+	void GcStatistics::install()
+	{
+		v8::V8::AddGCPrologueCallback(gc_prologue);
+		v8::V8::AddGCEpilogueCallback(gc_epilogue);
+	}
+
+	void GcStatistics::reset()
+	{
+		scavenge.reset();
+		mark_sweep.reset();
+		mark_compact.reset();
+	}
+
+	void GcStatistics::write_json(JsonWriter &writer) const
+	{
+		v8::HeapStatistics heap_statistics;
+		v8::V8::GetHeapStatistics(&heap_statistics);
+
+		writer.begin_object();
+		writer.member("unit", "us");
+		writer.key("scavenge");
+		scavenge.write_json(writer);
+		writer.key("mark_sweep");
+		mark_sweep.write_json(writer);
+		writer.key("mark_compact");
+		mark_compact.write_json(writer);
+		writer.key("heap");
+		writer.begin_object();
+		writer.member("total_heap_size", static_cast<uint64_t>(heap_statistics.total_heap_size()));
+		writer.member("total_heap_size_executable", static_cast<uint64_t>(heap_statistics.total_heap_size_executable()));
+		writer.member("used_heap_size", static_cast<uint64_t>(heap_statistics.used_heap_size()));
+		writer.member("heap_size_limit", static_cast<uint64_t>(heap_statistics.heap_size_limit()));
+		writer.end_object();
+		writer.end_object();
+	}
+
+	// NOTE: GC callbacks must not allocate on the V8 heap
+	void GcStatistics::gc_prologue(v8::GCType /*type*/, v8::GCCallbackFlags /*flags*/)
+	{
+		IsolateData *isolate_data = IsolateData::current();
+		if (isolate_data == NULL)
+			return;
+		isolate_data->gc_statistics.pause_started_us = platform::now_us();
+	}
+
+	void GcStatistics::gc_epilogue(v8::GCType type, v8::GCCallbackFlags flags)
+	{
+		IsolateData *isolate_data = IsolateData::current();
+		if (isolate_data == NULL)
+			return;
+		GcStatistics &statistics = isolate_data->gc_statistics;
+		if (statistics.pause_started_us == 0)
+			return;
+		uint64_t pause_us = platform::now_us() - statistics.pause_started_us;
+		const char *trace_name;
+
+		if (type == v8::kGCTypeScavenge)
+		{
+			statistics.scavenge.record(pause_us);
+			trace_name = "gc_scavenge";
+		}
+		else if ((flags & v8::kGCCallbackFlagCompacted) != 0)
+		{
+			statistics.mark_compact.record(pause_us);
+			trace_name = "gc_mark_compact";
+		}
+		else
+		{
+			statistics.mark_sweep.record(pause_us);
+			trace_name = "gc_mark_sweep";
+		}
+
+		if (TraceLog::is_enabled())
+			TraceLog::complete(trace_name, "v8.gc", statistics.pause_started_us, pause_us, NULL, NULL, std::string());
+		statistics.pause_started_us = 0;
+	}
+
+}
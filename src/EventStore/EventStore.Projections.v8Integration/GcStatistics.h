@@ -0,0 +1,31 @@
+#pragma once
+#include "Histogram.h"
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// GC pause durations (in microseconds) of one isolate split by collection type.
+	// Filled by GC prologue/epilogue callbacks registered in the isolate.
+	class GcStatistics 
+	{
+	public:
+		GcStatistics();
+
+		// must be called while the isolate to be observed is entered
+		static void install();
+
+		void reset();
+		void write_json(JsonWriter &writer) const;
+
+	private:
+		uint64_t pause_started_us;
+		Histogram scavenge;
+		Histogram mark_sweep;
+		Histogram mark_compact;
+
+		static void gc_prologue(v8::GCType type, v8::GCCallbackFlags flags);
+		static void gc_epilogue(v8::GCType type, v8::GCCallbackFlags flags);
+	};
+
+}
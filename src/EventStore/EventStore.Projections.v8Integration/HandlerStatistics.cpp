@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "HandlerStatistics.h"
+#include "JsonWriter.h"
+
+namespace js1 
+{
+
+	HandlerStatistics::HandlerStatistics() : calls(0), exceptions(0), invalid_results(0), bytes_in(0), bytes_out(0)
+	{
+	}
+
+	void HandlerStatistics::record(uint64_t marshal_us, uint64_t call_us, size_t bytes_in_, size_t bytes_out_, Outcome outcome)
+	{
+		calls++;
+		if (outcome == THREW)
+			exceptions++;
+		else if (outcome == INVALID_RESULT)
+			invalid_results++;
+		bytes_in += bytes_in_;
+		bytes_out += bytes_out_;
+		latency.record(marshal_us + call_us);
+		marshal.record(marshal_us);
+		call.record(call_us);
+	}
+
+	void HandlerStatistics::reset()
+	{
+		calls = 0;
+		exceptions = 0;
+		invalid_results = 0;
+		bytes_in = 0;
+		bytes_out = 0;
+		latency.reset();
+		marshal.reset();
+		call.reset();
+	}
+
+	void HandlerStatistics::write_json(JsonWriter &writer) const
+	{
+		writer.begin_object();
+		writer.member("calls", calls);
+		writer.member("exceptions", exceptions);
+		writer.member("invalid_results", invalid_results);
+		writer.member("bytes_in", bytes_in);
+		writer.member("bytes_out", bytes_out);
+		writer.key("latency");
+		latency.write_json(writer);
+		writer.key("marshal");
+		marshal.write_json(writer);
+		writer.key("call");
+		call.write_json(writer);
+		writer.end_object();
+	}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Histogram.h"
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// Per command handler call counters and latency histograms (in microseconds).
+	// Marshalling covers conversion of the arguments into V8 strings and the copy of 
+	// the result out of V8, call covers the time spent inside Function::Call.
+	class HandlerStatistics 
+	{
+	public:
+		enum Outcome 
+		{
+			SUCCEEDED,
+			THREW,
+			// the handler returned something other than a string
+			INVALID_RESULT
+		};
+
+		HandlerStatistics();
+
+		void record(uint64_t marshal_us, uint64_t call_us, size_t bytes_in, size_t bytes_out, Outcome outcome);
+		void reset();
+		void write_json(JsonWriter &writer) const;
+
+	private:
+		uint64_t calls;
+		uint64_t exceptions;
+		uint64_t invalid_results;
+		uint64_t bytes_in;
+		uint64_t bytes_out;
+		Histogram latency;
+		Histogram marshal;
+		Histogram call;
+	};
+
+}
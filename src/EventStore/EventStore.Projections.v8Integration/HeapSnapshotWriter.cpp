@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "HeapSnapshotWriter.h"
+#include "JsonWriter.h"
+
+#include <v8-profiler.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace js1 
+{
+	namespace 
+	{
+		const int SNAPSHOT_CHUNK_SIZE = 64 * 1024;
+
+		class FileOutputStream : public v8::OutputStream 
+		{
+		public:
+			FileOutputStream(FILE *file_) : file(file_), failed(false)
+			{
+			}
+
+			virtual void EndOfStream()
+			{
+				if (fflush(file) != 0)
+					failed = true;
+			}
+
+			virtual int GetChunkSize()
+			{
+				return SNAPSHOT_CHUNK_SIZE;
+			}
+
+			virtual WriteResult WriteAsciiChunk(char *data, int size)
+			{
+				if (fwrite(data, 1, size, file) != static_cast<size_t>(size))
+				{
+					failed = true;
+					return kAbort;
+				}
+				return kContinue;
+			}
+
+			bool is_failed() const { return failed; }
+
+		private:
+			FILE *file;
+			bool failed;
+		};
+
+		struct HeapSummaryEntry 
+		{
+			HeapSummaryEntry() : count(0), self_size(0) 
+			{
+			}
+
+			std::string name;
+			uint64_t count;
+			uint64_t self_size;
+		};
+
+		bool larger_self_size(const HeapSummaryEntry &left, const HeapSummaryEntry &right)
+		{
+			return left.self_size > right.self_size;
+		}
+
+		const char *node_type_name(v8::HeapGraphNode::Type type)
+		{
+			switch (type)
+			{
+			case v8::HeapGraphNode::kArray: return "(array)";
+			case v8::HeapGraphNode::kString: return "(string)";
+			case v8::HeapGraphNode::kCode: return "(code)";
+			case v8::HeapGraphNode::kClosure: return "(closure)";
+			case v8::HeapGraphNode::kRegExp: return "(regexp)";
+			case v8::HeapGraphNode::kHeapNumber: return "(number)";
+			case v8::HeapGraphNode::kHidden: return "(system)";
+			default: return "(synthetic)";
+			}
+		}
+	}
+
+	bool HeapSnapshotWriter::write_snapshot(const char *file_name)
+	{
+		FILE *file = fopen(file_name, "wb");
+		if (file == NULL)
+			return false;
+
+		v8::HandleScope handle_scope;
+		const v8::HeapSnapshot *snapshot = v8::HeapProfiler::TakeSnapshot(v8::String::New(file_name));
+		FileOutputStream stream(file);
+		snapshot->Serialize(&stream, v8::HeapSnapshot::kJSON);
+		const_cast<v8::HeapSnapshot *>(snapshot)->Delete();
+
+		bool closed = fclose(file) == 0;
+		return closed && !stream.is_failed();
+	}
+
+	void HeapSnapshotWriter::write_summary(JsonWriter &writer, int32_t top_count)
+	{
+		v8::HeapStatistics heap_statistics;
+		v8::V8::GetHeapStatistics(&heap_statistics);
+		writer.begin_object();
+		writer.member("total_heap_size", static_cast<uint64_t>(heap_statistics.total_heap_size()));
+		writer.member("total_heap_size_executable", static_cast<uint64_t>(heap_statistics.total_heap_size_executable()));
+		writer.member("used_heap_size", static_cast<uint64_t>(heap_statistics.used_heap_size()));
+		writer.member("heap_size_limit", static_cast<uint64_t>(heap_statistics.heap_size_limit()));
+		if (top_count != 0)
+			write_constructors(writer, top_count);
+		writer.end_object();
+	}
+
+	void HeapSnapshotWriter::write_constructors(JsonWriter &writer, int32_t top_count)
+	{
+		v8::HandleScope handle_scope;
+		const v8::HeapSnapshot *snapshot = v8::HeapProfiler::TakeSnapshot(v8::String::New("summary"));
+
+		std::map<std::string, HeapSummaryEntry> groups;
+		uint64_t total_count = 0;
+		uint64_t total_size = 0;
+		int nodes_count = snapshot->GetNodesCount();
+		for (int i = 0; i < nodes_count; i++)
+		{
+			const v8::HeapGraphNode *node = snapshot->GetNode(i);
+			v8::HeapGraphNode::Type type = node->GetType();
+			std::string name;
+			if (type == v8::HeapGraphNode::kObject || type == v8::HeapGraphNode::kNative)
+				name = *v8::String::Utf8Value(node->GetName());
+			else
+				name = node_type_name(type);
+
+			HeapSummaryEntry &entry = groups[name];
+			entry.count++;
+			entry.self_size += node->GetSelfSize();
+			total_count++;
+			total_size += node->GetSelfSize();
+		}
+		const_cast<v8::HeapSnapshot *>(snapshot)->Delete();
+
+		std::vector<HeapSummaryEntry> entries;
+		entries.reserve(groups.size());
+		for (std::map<std::string, HeapSummaryEntry>::iterator it = groups.begin(); it != groups.end(); it++)
+		{
+			entries.push_back(it->second);
+			entries.back().name = it->first;
+		}
+		std::sort(entries.begin(), entries.end(), larger_self_size);
+		if (top_count >= 0 && entries.size() > static_cast<size_t>(top_count))
+			entries.resize(top_count);
+
+		writer.member("count", total_count);
+		writer.member("self_size", total_size);
+		writer.key("constructors");
+		writer.begin_array();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			writer.begin_object();
+			writer.member("name", entries[i].name);
+			writer.member("count", entries[i].count);
+			writer.member("self_size", entries[i].self_size);
+			writer.end_object();
+		}
+		writer.end_array();
+	}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// Heap snapshots of the current isolate.  Both methods must be called with 
+	// the isolate entered.
+	class HeapSnapshotWriter 
+	{
+	public:
+		// streams a snapshot in the .heapsnapshot JSON format directly into the file
+		static bool write_snapshot(const char *file_name);
+
+		// heap totals from V8 heap statistics, which are cheap enough for periodic 
+		// collection.  A non-zero top_count adds aggregated object counts and self 
+		// sizes by constructor (or node type for non-object nodes), top_count largest 
+		// groups (all of them if negative) ordered by total self size; this takes 
+		// a full heap snapshot and should be requested on demand only.
+		static void write_summary(JsonWriter &writer, int32_t top_count);
+
+	private:
+		static void write_constructors(JsonWriter &writer, int32_t top_count);
+	};
+
+}
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "Histogram.h"
+#include "JsonWriter.h"
+
+#include <string.h>
+
+namespace js1 
+{
+
+	Histogram::Histogram()
+	{
+		reset();
+	}
+
+	void Histogram::record(uint64_t value)
+	{
+		if (value > MAX_VALUE)
+			value = MAX_VALUE;
+		buckets[bucket_index(value)]++;
+		if (count == 0 || value < min)
+			min = value;
+		if (value > max)
+			max = value;
+		count++;
+		total += value;
+	}
+
+	void Histogram::merge(const Histogram &other)
+	{
+		if (other.count == 0)
+			return;
+		for (int i = 0; i < BUCKET_COUNT; i++)
+			buckets[i] += other.buckets[i];
+		if (count == 0 || other.min < min)
+			min = other.min;
+		if (other.max > max)
+			max = other.max;
+		count += other.count;
+		total += other.total;
+	}
+
+	void Histogram::reset()
+	{
+		memset(buckets, 0, sizeof(buckets));
+		count = 0;
+		total = 0;
+		min = 0;
+		max = 0;
+	}
+
+	uint64_t Histogram::get_percentile(double percentile) const
+	{
+		if (count == 0)
+			return 0;
+		uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+		if (rank < 1)
+			rank = 1;
+		if (rank > count)
+			rank = count;
+
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKET_COUNT; i++)
+		{
+			seen += buckets[i];
+			if (seen >= rank)
+			{
+				uint64_t value = bucket_upper_bound(i);
+				return value > max ? max : value;
+			}
+		}
+		return max;
+	}
+
+	void Histogram::write_json(JsonWriter &writer) const
+	{
+		writer.begin_object();
+		writer.member("count", count);
+		writer.member("total", total);
+		writer.member("min", get_min());
+		writer.member("max", max);
+		writer.member("mean", count == 0 ? 0.0 : static_cast<double>(total) / count);
+		writer.member("p50", get_percentile(50.0));
+		writer.member("p90", get_percentile(90.0));
+		writer.member("p99", get_percentile(99.0));
+		writer.member("p999", get_percentile(99.9));
+		writer.end_object();
+	}
+
+	int Histogram::bucket_index(uint64_t value)
+	{
+		if (value < SUB_BUCKET_COUNT)
+			return static_cast<int>(value);
+
+		int magnitude = 0; // index of the most significant bit
+		for (uint64_t v = value; v > 1; v >>= 1)
+			magnitude++;
+		int shift = magnitude - SUB_BUCKET_BITS + 1;
+		return SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT 
+			+ static_cast<int>(value >> shift) - HALF_SUB_BUCKET_COUNT;
+	}
+
+	uint64_t Histogram::bucket_upper_bound(int index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+			return index;
+
+		int shift = (index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+		uint64_t sub_bucket = (index - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+		return ((sub_bucket + 1) << shift) - 1;
+	}
+
+}
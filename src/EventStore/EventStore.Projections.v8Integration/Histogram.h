@@ -0,0 +1,46 @@
+#pragma once
+
+namespace js1 
+{
+	class JsonWriter;
+
+	// Log-linear (HDR style) histogram of non-negative integer samples.  Values 
+	// below 128 are recorded exactly, larger values with ~1.5% relative precision.
+	// Samples above MAX_VALUE are clamped into the last bucket.
+	class Histogram 
+	{
+	public:
+		static const int SUB_BUCKET_BITS = 7;
+		static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+		static const int HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+		static const int MAX_MAGNITUDE = 36; 
+		static const int BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_MAGNITUDE - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+		static const uint64_t MAX_VALUE = (static_cast<uint64_t>(1) << MAX_MAGNITUDE) - 1;
+
+		Histogram();
+
+		void record(uint64_t value);
+		void merge(const Histogram &other);
+		void reset();
+
+		uint64_t get_count() const { return count; }
+		uint64_t get_total() const { return total; }
+		uint64_t get_min() const { return count == 0 ? 0 : min; }
+		uint64_t get_max() const { return max; }
+		uint64_t get_percentile(double percentile) const;
+
+		// writes count, total, min, max, mean and the p50/p90/p99/p999 percentiles
+		void write_json(JsonWriter &writer) const;
+
+	private:
+		uint64_t buckets[BUCKET_COUNT];
+		uint64_t count;
+		uint64_t total;
+		uint64_t min;
+		uint64_t max;
+
+		static int bucket_index(uint64_t value);
+		static uint64_t bucket_upper_bound(int index);
+	};
+
+}
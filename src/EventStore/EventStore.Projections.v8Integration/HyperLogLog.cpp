@@ -0,0 +1,261 @@
+#include "stdafx.h"
+#include "HyperLogLog.h"
+
+#include <math.h>
+
+namespace js1 
+{
+
+	const NativeType HyperLogLog::TYPE = { "HyperLogLog" };
+
+	namespace 
+	{
+		const uint8_t SERIALIZATION_VERSION = 1;
+		const uint8_t DENSE_ENCODING = 0;
+		const uint8_t SPARSE_ENCODING = 1;
+		const int MIN_PRECISION = 4;
+		const int MAX_PRECISION = 16;
+		const int REGISTER_BITS = 6;
+	}
+
+	v8::Handle<v8::FunctionTemplate> HyperLogLog::create_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(TYPE, constructor_callback);
+		set_method(result, "add", add_callback);
+		set_method(result, "merge", merge_callback);
+		set_method(result, "estimate", estimate_callback);
+		set_method(result, "toJSON", to_json_callback);
+		return handle_scope.Close(result);
+	}
+
+	HyperLogLog::HyperLogLog(int precision_) : 
+		NativeObject(TYPE), precision(precision_), registers(static_cast<size_t>(1) << precision_, 0)
+	{
+		set_external_size(registers.size());
+	}
+
+	bool HyperLogLog::add(uint64_t hash)
+	{
+		// the top bits select the register, the rank is the position of the first set bit of the rest
+		size_t index = static_cast<size_t>(hash >> (64 - precision));
+		uint64_t rest = hash << precision;
+		uint8_t rank = 1;
+		while (rank <= 64 - precision && (rest & 0x8000000000000000ULL) == 0)
+		{
+			rest <<= 1;
+			rank++;
+		}
+		if (registers[index] >= rank)
+			return false;
+		registers[index] = rank;
+		return true;
+	}
+
+	bool HyperLogLog::merge(const HyperLogLog &other)
+	{
+		if (other.precision != precision)
+			return false;
+		for (size_t i = 0; i < registers.size(); i++)
+		{
+			if (other.registers[i] > registers[i])
+				registers[i] = other.registers[i];
+		}
+		return true;
+	}
+
+	double HyperLogLog::estimate() const
+	{
+		double m = static_cast<double>(registers.size());
+		double alpha;
+		switch (registers.size())
+		{
+		case 16: alpha = 0.673; break;
+		case 32: alpha = 0.697; break;
+		case 64: alpha = 0.709; break;
+		default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+		}
+
+		double sum = 0;
+		size_t zeros = 0;
+		for (size_t i = 0; i < registers.size(); i++)
+		{
+			sum += ldexp(1.0, -registers[i]);
+			if (registers[i] == 0)
+				zeros++;
+		}
+		double result = alpha * m * m / sum;
+		// small cardinalities are estimated by linear counting of the empty registers
+		if (result <= 2.5 * m && zeros > 0)
+			result = m * log(m / static_cast<double>(zeros));
+		return floor(result + 0.5);
+	}
+
+	void HyperLogLog::serialize(std::string &data) const
+	{
+		size_t non_zero = 0;
+		for (size_t i = 0; i < registers.size(); i++)
+		{
+			if (registers[i] != 0)
+				non_zero++;
+		}
+		size_t dense_size = (registers.size() * REGISTER_BITS + 7) / 8;
+
+		NativeWriter writer(data);
+		writer.write_byte(SERIALIZATION_VERSION);
+		writer.write_byte(static_cast<uint8_t>(precision));
+		// a sparse entry takes at least two bytes, an index delta and a rank
+		if (non_zero * 2 < dense_size)
+		{
+			writer.write_byte(SPARSE_ENCODING);
+			writer.write_varint(non_zero);
+			size_t previous = 0;
+			for (size_t i = 0; i < registers.size(); i++)
+			{
+				if (registers[i] == 0)
+					continue;
+				writer.write_varint(i - previous);
+				writer.write_byte(registers[i]);
+				previous = i;
+			}
+		}
+		else
+		{
+			writer.write_byte(DENSE_ENCODING);
+			uint32_t buffer = 0;
+			int buffered = 0;
+			for (size_t i = 0; i < registers.size(); i++)
+			{
+				buffer |= static_cast<uint32_t>(registers[i]) << buffered;
+				buffered += REGISTER_BITS;
+				while (buffered >= 8)
+				{
+					writer.write_byte(static_cast<uint8_t>(buffer));
+					buffer >>= 8;
+					buffered -= 8;
+				}
+			}
+			if (buffered > 0)
+				writer.write_byte(static_cast<uint8_t>(buffer));
+		}
+	}
+
+	HyperLogLog *HyperLogLog::deserialize(const std::string &data)
+	{
+		NativeReader reader(data);
+		if (reader.read_byte() != SERIALIZATION_VERSION)
+			return NULL;
+		int precision = reader.read_byte();
+		if (precision < MIN_PRECISION || precision > MAX_PRECISION)
+			return NULL;
+
+		HyperLogLog *result = new HyperLogLog(precision);
+		std::vector<uint8_t> &registers = result->registers;
+		uint8_t max_rank = static_cast<uint8_t>(64 - precision + 1);
+		uint8_t encoding = reader.read_byte();
+		bool valid = true;
+		if (encoding == SPARSE_ENCODING)
+		{
+			uint64_t count = reader.read_varint();
+			uint64_t index = 0;
+			valid = count <= registers.size();
+			for (uint64_t i = 0; valid && i < count; i++)
+			{
+				index += reader.read_varint();
+				uint8_t rank = reader.read_byte();
+				valid = !reader.has_failed() && index < registers.size() && rank <= max_rank;
+				if (valid)
+					registers[static_cast<size_t>(index)] = rank;
+			}
+		}
+		else if (encoding == DENSE_ENCODING)
+		{
+			uint32_t buffer = 0;
+			int buffered = 0;
+			for (size_t i = 0; valid && i < registers.size(); i++)
+			{
+				while (buffered < REGISTER_BITS)
+				{
+					buffer |= static_cast<uint32_t>(reader.read_byte()) << buffered;
+					buffered += 8;
+				}
+				registers[i] = static_cast<uint8_t>(buffer & ((1 << REGISTER_BITS) - 1));
+				buffer >>= REGISTER_BITS;
+				buffered -= REGISTER_BITS;
+				valid = registers[i] <= max_rank;
+			}
+		}
+		else
+			valid = false;
+
+		if (!valid || reader.has_failed() || !reader.at_end())
+		{
+			delete result;
+			return NULL;
+		}
+		return result;
+	}
+
+	v8::Handle<v8::Value> HyperLogLog::constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("HyperLogLog must be called with new");
+
+		HyperLogLog *hyper_log_log = NULL;
+		if (args.Length() == 0 || args[0]->IsUndefined())
+			hyper_log_log = new HyperLogLog(DEFAULT_PRECISION);
+		else if (args[0]->IsNumber())
+		{
+			int32_t precision = args[0]->Int32Value();
+			if (precision < MIN_PRECISION || precision > MAX_PRECISION)
+				return throw_error("HyperLogLog precision must be between 4 and 16");
+			hyper_log_log = new HyperLogLog(precision);
+		}
+		else
+		{
+			std::string data;
+			if (!from_json_object(args[0], TYPE, data) || (hyper_log_log = deserialize(data)) == NULL)
+				return throw_error("Invalid HyperLogLog state");
+		}
+		hyper_log_log->wrap(args.This());
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> HyperLogLog::add_callback(const v8::Arguments& args)
+	{
+		HyperLogLog *hyper_log_log = unwrap_this(args);
+		if (args.Length() != 1)
+			return throw_error("HyperLogLog.add expects 1 argument");
+		return v8::Boolean::New(hyper_log_log->add(hash_value(args[0])));
+	}
+
+	v8::Handle<v8::Value> HyperLogLog::merge_callback(const v8::Arguments& args)
+	{
+		HyperLogLog *hyper_log_log = unwrap_this(args);
+		HyperLogLog *other = static_cast<HyperLogLog *>(unwrap(args[0], TYPE));
+		if (other == NULL)
+			return throw_error("HyperLogLog.merge expects a HyperLogLog");
+		if (!hyper_log_log->merge(*other))
+			return throw_error("HyperLogLog.merge expects a HyperLogLog of the same precision");
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> HyperLogLog::estimate_callback(const v8::Arguments& args)
+	{
+		return v8::Number::New(unwrap_this(args)->estimate());
+	}
+
+	v8::Handle<v8::Value> HyperLogLog::to_json_callback(const v8::Arguments& args)
+	{
+		std::string data;
+		unwrap_this(args)->serialize(data);
+		return to_json_object(TYPE, data);
+	}
+
+	HyperLogLog *HyperLogLog::unwrap_this(const v8::Arguments& args)
+	{
+		// the signature guarantees the receiver is a HyperLogLog
+		return static_cast<HyperLogLog *>(unwrap(args.Holder(), TYPE));
+	}
+
+}
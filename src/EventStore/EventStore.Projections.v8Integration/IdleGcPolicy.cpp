@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "platform.h"
+#include "IdleGcPolicy.h"
+
+namespace js1 
+{
+	namespace 
+	{
+		// amount of work (on the V8 scale of 1 to 1000) requested in a single idle notification
+		const int IDLE_NOTIFICATION_HINT = 100;
+	}
+
+	IdleGcPolicy::IdleGcPolicy() :
+		idle_after_ms(-1), idle_time_ms(0), after_checkpoint(false), 
+		last_activity_us(platform::now_us()), checkpoint_pending(false), idle_done(false)
+	{
+	}
+
+	void IdleGcPolicy::configure(int32_t idle_after_ms_, int32_t idle_time_ms_, bool after_checkpoint_)
+	{
+		idle_after_ms = idle_after_ms_;
+		idle_time_ms = idle_time_ms_;
+		after_checkpoint = after_checkpoint_;
+	}
+
+	void IdleGcPolicy::record_activity()
+	{
+		last_activity_us = platform::now_us();
+		idle_done = false;
+	}
+
+	void IdleGcPolicy::record_checkpoint()
+	{
+		if (after_checkpoint)
+			checkpoint_pending = true;
+	}
+
+	bool IdleGcPolicy::tick()
+	{
+		if (idle_time_ms <= 0)
+			return false;
+
+		bool is_idle = idle_after_ms >= 0 && !idle_done 
+			&& platform::now_us() - last_activity_us >= static_cast<uint64_t>(idle_after_ms) * 1000;
+		if (!is_idle && !checkpoint_pending)
+			return false;
+
+		checkpoint_pending = false;
+		idle_done = notify_idle(idle_time_ms);
+		return true;
+	}
+
+	bool IdleGcPolicy::notify_idle(int32_t idle_time_ms)
+	{
+		uint64_t deadline_us = platform::now_us() + static_cast<uint64_t>(idle_time_ms) * 1000;
+		do
+		{
+			if (v8::V8::IdleNotification(IDLE_NOTIFICATION_HINT))
+				return true;
+		} 
+		while (platform::now_us() < deadline_us);
+		return false;
+	}
+
+	void IdleGcPolicy::notify_low_memory()
+	{
+		v8::V8::LowMemoryNotification();
+	}
+
+}
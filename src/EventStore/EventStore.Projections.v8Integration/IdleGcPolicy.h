@@ -0,0 +1,37 @@
+#pragma once
+
+namespace js1 
+{
+
+	// Decides when an isolate gets a chance to compact its heap.  V8 is only 
+	// notified from idle_tick/notify_* calls made by the host on the thread 
+	// that owns the isolate, so nothing here ever runs on the event hot path.  
+	// The projection core ticks every running projection once a second and 
+	// reports its completed checkpoints.
+	class IdleGcPolicy 
+	{
+	public:
+		IdleGcPolicy();
+
+		void configure(int32_t idle_after_ms, int32_t idle_time_ms, bool after_checkpoint);
+		void record_activity();
+		void record_checkpoint();
+
+		// runs an idle notification if the isolate has been idle for long enough 
+		// or a checkpoint has been completed since the last one
+		bool tick();
+
+		static bool notify_idle(int32_t idle_time_ms);
+		static void notify_low_memory();
+
+	private:
+		int32_t idle_after_ms;
+		int32_t idle_time_ms;
+		bool after_checkpoint;
+
+		uint64_t last_activity_us;
+		bool checkpoint_pending;
+		bool idle_done; // V8 reported there is nothing more to clean up until new work is done
+	};
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "IdleGcPolicy.h"
+#include "GcStatistics.h"
+#include "CpuProfileSession.h"
+#include "NativeObject.h"
+#include "Timestamp.h"
+
+namespace js1 
+{
+
+	// Native state shared by all the scripts compiled in one isolate. Attached 
+	// to the isolate data slot so it is reachable from V8 callbacks which only 
+	// know the current isolate.
+	class IsolateData 
+	{
+	public:
+		IsolateData() : ref_count(0) 
+		{
+		}
+
+		static IsolateData *get(v8::Isolate *isolate)
+		{
+			return reinterpret_cast<IsolateData *>(isolate->GetData());
+		}
+
+		static IsolateData *current()
+		{
+			return get(v8::Isolate::GetCurrent());
+		}
+
+		size_t ref_count;
+		IdleGcPolicy idle_gc_policy;
+		GcStatistics gc_statistics;
+		CpuProfileSession cpu_profile_session;
+		NativeObjectList native_objects;
+		TimeBucketCache time_buckets;
+
+	private:
+		IsolateData(const IsolateData &);
+		IsolateData& operator=(const IsolateData &);
+	};
+
+}
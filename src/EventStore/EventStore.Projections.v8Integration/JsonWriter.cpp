@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "JsonWriter.h"
+#include "encoding.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace js1 
+{
+
+	JsonWriter::JsonWriter() : after_key(false)
+	{
+	}
+
+	void JsonWriter::begin_object()
+	{
+		before_value();
+		buffer += '{';
+		first_in_scope.push_back(true);
+	}
+
+	void JsonWriter::end_object()
+	{
+		first_in_scope.pop_back();
+		buffer += '}';
+	}
+
+	void JsonWriter::begin_array()
+	{
+		before_value();
+		buffer += '[';
+		first_in_scope.push_back(true);
+	}
+
+	void JsonWriter::end_array()
+	{
+		first_in_scope.pop_back();
+		buffer += ']';
+	}
+
+	void JsonWriter::key(const char *name)
+	{
+		before_value();
+		write_string(name, strlen(name));
+		buffer += ':';
+		after_key = true;
+	}
+
+	void JsonWriter::key(const std::string &name)
+	{
+		before_value();
+		write_string(name.data(), name.size());
+		buffer += ':';
+		after_key = true;
+	}
+
+	void JsonWriter::value(const char *value)
+	{
+		before_value();
+		write_string(value, strlen(value));
+	}
+
+	void JsonWriter::value(const std::string &value)
+	{
+		before_value();
+		write_string(value.data(), value.size());
+	}
+
+	void JsonWriter::value(const char *value, size_t length)
+	{
+		before_value();
+		write_string(value, length);
+	}
+
+	void JsonWriter::value(bool flag)
+	{
+		before_value();
+		buffer += flag ? "true" : "false";
+	}
+
+	void JsonWriter::value(int32_t number)
+	{
+		value(static_cast<int64_t>(number));
+	}
+
+	void JsonWriter::value(uint32_t number)
+	{
+		value(static_cast<uint64_t>(number));
+	}
+
+	void JsonWriter::value(int64_t number)
+	{
+		before_value();
+		char text[32];
+		sprintf(text, "%lld", static_cast<long long>(number));
+		buffer += text;
+	}
+
+	void JsonWriter::value(uint64_t number)
+	{
+		before_value();
+		char text[32];
+		sprintf(text, "%llu", static_cast<unsigned long long>(number));
+		buffer += text;
+	}
+
+	void JsonWriter::value(double number)
+	{
+		before_value();
+		if (number != number || number - number != 0) // NaN or infinity
+		{
+			buffer += "null";
+			return;
+		}
+		char text[32];
+		sprintf(text, "%.17g", number);
+		buffer += text;
+	}
+
+	void JsonWriter::null_value()
+	{
+		before_value();
+		buffer += "null";
+	}
+
+	void JsonWriter::raw_value(const std::string &json)
+	{
+		before_value();
+		buffer += json;
+	}
+
+	std::vector<uint16_t> JsonWriter::to_utf16() const
+	{
+		return utf8_to_utf16(buffer);
+	}
+
+	void JsonWriter::clear()
+	{
+		buffer.clear();
+		first_in_scope.clear();
+		after_key = false;
+	}
+
+	void JsonWriter::before_value()
+	{
+		if (after_key)
+		{
+			after_key = false;
+			return;
+		}
+		if (first_in_scope.empty())
+			return;
+		if (first_in_scope.back())
+			first_in_scope.back() = false;
+		else
+			buffer += ',';
+	}
+
+	void JsonWriter::write_string(const char *value, size_t length)
+	{
+		static const char hex[] = "0123456789abcdef";
+		buffer += '"';
+		for (size_t i = 0; i < length; i++)
+		{
+			unsigned char c = static_cast<unsigned char>(value[i]);
+			switch (c)
+			{
+			case '"': buffer += "\\\""; break;
+			case '\\': buffer += "\\\\"; break;
+			case '\n': buffer += "\\n"; break;
+			case '\r': buffer += "\\r"; break;
+			case '\t': buffer += "\\t"; break;
+			default:
+				if (c < 0x20)
+				{
+					buffer += "\\u00";
+					buffer += hex[c >> 4];
+					buffer += hex[c & 0xF];
+				}
+				else
+					buffer += static_cast<char>(c);
+			}
+		}
+		buffer += '"';
+	}
+
+}
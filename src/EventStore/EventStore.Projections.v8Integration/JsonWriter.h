@@ -0,0 +1,53 @@
+#pragma once
+
+namespace js1 
+{
+
+	// Minimal forward-only JSON writer used to report native statistics and 
+	// diagnostics.  Output is UTF-8; commas between members and elements are 
+	// inserted automatically.
+	class JsonWriter 
+	{
+	public:
+		JsonWriter();
+
+		void begin_object();
+		void end_object();
+		void begin_array();
+		void end_array();
+		void key(const char *name);
+		void key(const std::string &name);
+
+		void value(const char *value);
+		void value(const std::string &value);
+		void value(const char *value, size_t length);
+		void value(bool value);
+		void value(int32_t value);
+		void value(uint32_t value);
+		void value(int64_t value);
+		void value(uint64_t value);
+		void value(double value);
+		void null_value();
+		// appends an already serialized JSON value as is
+		void raw_value(const std::string &json);
+
+		template<typename T> void member(const char *name, T member_value)
+		{
+			key(name);
+			value(member_value);
+		}
+
+		const std::string &str() const { return buffer; }
+		std::vector<uint16_t> to_utf16() const;
+		void clear();
+
+	private:
+		std::string buffer;
+		std::vector<bool> first_in_scope;
+		bool after_key;
+
+		void before_value();
+		void write_string(const char *value, size_t length);
+	};
+
+}
@@ -0,0 +1,226 @@
+#include "stdafx.h"
+#include "LogPipeline.h"
+
+namespace js1
+{
+	volatile int32_t LogPipeline::level = LogPipeline::LEVEL_INFO;
+	volatile bool LogPipeline::asynchronous = false;
+	LogPipeline::Ring *volatile LogPipeline::ring = NULL;
+	std::vector<LogPipeline::Ring *> LogPipeline::rings;
+	volatile uint64_t LogPipeline::dropped_count = 0;
+	bool LogPipeline::stopping = false;
+	platform::Mutex LogPipeline::lock;
+	platform::ConditionVariable LogPipeline::wake_up;
+	platform::ConditionVariable LogPipeline::drained;
+	platform::Thread LogPipeline::drain_thread;
+	// defined last, so it is destroyed before the state it stops
+	LogPipeline::Shutdown LogPipeline::shutdown;
+
+	LogPipeline::Shutdown::~Shutdown()
+	{
+		LogPipeline::stop();
+	}
+
+	bool LogPipeline::set_level(int32_t level_)
+	{
+		if (level_ < LEVEL_DEBUG || level_ > LEVEL_NONE)
+			return false;
+		level = level_;
+		return true;
+	}
+
+	bool LogPipeline::set_asynchronous(bool asynchronous_, uint32_t capacity)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (!asynchronous_)
+		{
+			// the messages already in the rings are still delivered by the drain thread
+			asynchronous = false;
+			return true;
+		}
+
+		uint64_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		if (ring != NULL && ring->mask + 1 == size)
+		{
+			asynchronous = true;
+			return true;
+		}
+
+		Ring *new_ring = new Ring(size);
+		if (!drain_thread.is_started())
+		{
+			stopping = false;
+			if (!drain_thread.start(drainer, NULL))
+			{
+				delete new_ring;
+				return false;
+			}
+		}
+		// writers which have already read the previous ring keep using it, so it is 
+		// drained and kept until the pipeline is stopped
+		rings.push_back(new_ring);
+		platform::memory_barrier();
+		ring = new_ring;
+		platform::memory_barrier();
+		asynchronous = true;
+		return true;
+	}
+
+	void LogPipeline::write(LOG_CALLBACK callback, const uint16_t *message, size_t length)
+	{
+		if (asynchronous)
+		{
+			if (!ring->enqueue(callback, message, length))
+				platform::atomic_increment(&dropped_count);
+		}
+		else
+			callback(message);
+	}
+
+	void LogPipeline::flush(LOG_CALLBACK callback)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		for (size_t i = 0; i < rings.size(); i++)
+		{
+			Ring *flushed = rings[i];
+			uint64_t target = flushed->last_position(callback);
+			while (static_cast<int64_t>(flushed->dequeue_position - target) < 0 && drain_thread.is_started())
+			{
+				wake_up.notify_one();
+				drained.wait(lock, DRAIN_INTERVAL_MS);
+			}
+		}
+	}
+
+	void LogPipeline::stop()
+	{
+		{
+			platform::ScopedLock scoped_lock(lock);
+			asynchronous = false;
+			stopping = true;
+			wake_up.notify_one();
+		}
+		drain_thread.join();
+
+		platform::ScopedLock scoped_lock(lock);
+		for (size_t i = 0; i < rings.size(); i++)
+			delete rings[i];
+		rings.clear();
+		ring = NULL;
+	}
+
+	void LogPipeline::drain_all()
+	{
+		std::vector<Ring *> drained_rings;
+		{
+			platform::ScopedLock scoped_lock(lock);
+			drained_rings = rings;
+		}
+		for (size_t i = 0; i < drained_rings.size(); i++)
+			drained_rings[i]->drain();
+	}
+
+	void LogPipeline::drainer(void * /*argument*/)
+	{
+		while (true)
+		{
+			bool stopped;
+			{
+				platform::ScopedLock scoped_lock(lock);
+				drained.notify_all();
+				wake_up.wait(lock, DRAIN_INTERVAL_MS);
+				stopped = stopping;
+			}
+			drain_all();
+			if (stopped)
+				break;
+		}
+		platform::ScopedLock scoped_lock(lock);
+		drained.notify_all();
+	}
+
+	LogPipeline::Ring::Ring(uint64_t size) : 
+		cells(new Cell[static_cast<size_t>(size)]), mask(size - 1), enqueue_position(0), dequeue_position(0)
+	{
+		for (uint64_t i = 0; i < size; i++)
+			cells[i].sequence = i;
+	}
+
+	LogPipeline::Ring::~Ring()
+	{
+		delete[] cells;
+	}
+
+	bool LogPipeline::Ring::enqueue(LOG_CALLBACK callback, const uint16_t *message, size_t length)
+	{
+		uint64_t position = enqueue_position;
+		Cell *cell;
+		while (true)
+		{
+			cell = &cells[position & mask];
+			uint64_t sequence = cell->sequence;
+			platform::memory_barrier();
+			int64_t difference = static_cast<int64_t>(sequence - position);
+			if (difference == 0)
+			{
+				uint64_t previous = platform::atomic_compare_exchange(&enqueue_position, position, position + 1);
+				if (previous == position)
+					break;
+				position = previous;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = enqueue_position;
+		}
+		// cell buffers are reused, so steady state logging does not allocate
+		cell->callback = callback;
+		cell->message.assign(message, message + length + 1);
+		platform::memory_barrier();
+		cell->sequence = position + 1;
+		return true;
+	}
+
+	size_t LogPipeline::Ring::drain()
+	{
+		size_t count = 0;
+		while (true)
+		{
+			uint64_t position = dequeue_position;
+			Cell &cell = cells[position & mask];
+			uint64_t sequence = cell.sequence;
+			platform::memory_barrier();
+			if (sequence != position + 1)
+				break;
+			cell.callback(&cell.message[0]);
+			platform::memory_barrier();
+			cell.sequence = position + mask + 1;
+			// advanced after the callback returns so that flush also waits for the message being delivered
+			dequeue_position = position + 1;
+			count++;
+		}
+		return count;
+	}
+
+	uint64_t LogPipeline::Ring::last_position(LOG_CALLBACK callback) const
+	{
+		uint64_t target = dequeue_position;
+		uint64_t end = enqueue_position;
+		for (uint64_t position = target; position != end; position++)
+		{
+			const Cell &cell = cells[position & mask];
+			if (cell.sequence != position + 1)
+				continue;
+			platform::memory_barrier();
+			LOG_CALLBACK cell_callback = cell.callback;
+			platform::memory_barrier();
+			// the cell may have been delivered and reused while its callback was read
+			if (cell.sequence == position + 1 && cell_callback == callback)
+				target = position + 1;
+		}
+		return target;
+	}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "js1.h"
+#include "platform.h"
+
+namespace js1 
+{
+
+	// Delivers $log messages to the host LOG_CALLBACK.  
+	//
+	// Messages below the current level (info by default) are rejected before they are 
+	// converted from V8 strings.  In asynchronous mode accepted messages are put into a 
+	// bounded lock-free ring and delivered in batches by a background thread; messages 
+	// which do not fit are counted as dropped instead of blocking the projection thread. 
+	// Switching to a different capacity replaces the ring; the replaced one is still 
+	// drained and is freed when the pipeline is stopped.  Logging is synchronous by default.
+	class LogPipeline 
+	{
+	public:
+		enum Level 
+		{
+			LEVEL_DEBUG = 0,
+			LEVEL_INFO = 1,
+			LEVEL_WARNING = 2,
+			LEVEL_ERROR = 3,
+			LEVEL_NONE = 4
+		};
+
+		// returns false (leaving the level unchanged) if level is not one of Level
+		static bool set_level(int32_t level_);
+
+		static bool is_accepted(int32_t message_level)
+		{
+			return message_level >= level;
+		}
+
+		// capacity is rounded up to a power of two
+		static bool set_asynchronous(bool asynchronous_, uint32_t capacity);
+
+		// message must be null-terminated, length excludes the terminator
+		static void write(LOG_CALLBACK callback, const uint16_t *message, size_t length);
+
+		// waits until all the messages for callback accepted before the call have been delivered
+		static void flush(LOG_CALLBACK callback);
+
+		// delivers the pending messages, joins the drain thread and frees the rings; 
+		// must not race with write.  Called during static destruction.
+		static void stop();
+
+		static uint64_t get_dropped_count()
+		{
+			return dropped_count;
+		}
+
+	private:
+		struct Cell 
+		{
+			volatile uint64_t sequence;
+			LOG_CALLBACK callback;
+			std::vector<uint16_t> message;
+		};
+
+		// bounded multi-producer queue with a sequence number per cell (D. Vyukov)
+		struct Ring 
+		{
+			Cell *cells;
+			uint64_t mask;
+			volatile uint64_t enqueue_position;
+			volatile uint64_t dequeue_position;
+
+			explicit Ring(uint64_t size);
+			~Ring();
+
+			bool enqueue(LOG_CALLBACK callback, const uint16_t *message, size_t length);
+			// called by the drain thread only
+			size_t drain();
+			// the position after the last published message for callback
+			uint64_t last_position(LOG_CALLBACK callback) const;
+
+		private:
+			Ring(const Ring &);
+			Ring& operator=(const Ring &);
+		};
+
+		struct Shutdown 
+		{
+			~Shutdown();
+		};
+
+		static const uint32_t DRAIN_INTERVAL_MS = 10;
+
+		static volatile int32_t level;
+		static volatile bool asynchronous;
+		// writers use the current ring, the drain thread drains all of them
+		static Ring *volatile ring;
+		static std::vector<Ring *> rings;
+		static volatile uint64_t dropped_count;
+		static bool stopping;
+		static platform::Mutex lock;
+		static platform::ConditionVariable wake_up;
+		static platform::ConditionVariable drained;
+		static platform::Thread drain_thread;
+		static Shutdown shutdown;
+
+		static void drain_all();
+		static void drainer(void *argument);
+	};
+
+}
@@ -4,6 +4,7 @@
 #include "ModuleScript.h"
 #include "QueryScript.h"
 #include "EventHandler.h"
+#include "encoding.h"
 
 
 using namespace v8;
@@ -17,9 +18,11 @@ namespace js1
 		isolate_release(isolate);
 	}
 
-	bool ModuleScript::compile_script(const uint16_t *source, const uint16_t *file_name)
+	bool ModuleScript::compile_script(const uint16_t *module_source, const uint16_t *module_file_name)
 	{
-		return CompiledScript::compile_script(source, file_name);
+		source.assign(module_source, module_source + utf16_length(module_source) + 1);
+		file_name.assign(module_file_name, module_file_name + utf16_length(module_file_name) + 1);
+		return CompiledScript::compile_script(module_source, module_file_name);
 	}
 
 	void ModuleScript::run()
@@ -21,6 +21,17 @@ namespace js1 {
 
 		v8::Handle<v8::Object> get_module_object();
 
+		// the sources are kept so that sharded queries can compile the module in their own isolates
+		const std::vector<uint16_t> &get_source() const
+		{
+			return source;
+		}
+
+		const std::vector<uint16_t> &get_file_name() const
+		{
+			return file_name;
+		}
+
 
 	protected:
 		virtual v8::Isolate *get_isolate();
@@ -30,6 +41,8 @@ namespace js1 {
 		v8::Isolate *isolate;
 		PreludeScript *prelude;
 		v8::Persistent<v8::Object> module_object;
+		std::vector<uint16_t> source;
+		std::vector<uint16_t> file_name;
 	};
 
 
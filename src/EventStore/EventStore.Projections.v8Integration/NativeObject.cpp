@@ -0,0 +1,239 @@
+#include "stdafx.h"
+#include "NativeObject.h"
+#include "IsolateData.h"
+#include "encoding.h"
+
+#include <string.h>
+#include <math.h>
+
+namespace js1 
+{
+
+	NativeObject::~NativeObject()
+	{
+		if (list != NULL)
+			list->remove(this);
+		set_external_size(0);
+		wrapper.Dispose();
+		wrapper.Clear();
+	}
+
+	void NativeObject::wrap(v8::Handle<v8::Object> object)
+	{
+		object->SetPointerInInternalField(0, this);
+		object->SetPointerInInternalField(1, const_cast<NativeType *>(&type));
+		wrapper = v8::Persistent<v8::Object>::New(object);
+		wrapper.MakeWeak(this, weak_callback);
+		IsolateData::current()->native_objects.add(this);
+	}
+
+	NativeObject *NativeObject::unwrap(v8::Handle<v8::Value> value, const NativeType &type)
+	{
+		if (value.IsEmpty() || !value->IsObject())
+			return NULL;
+		v8::Handle<v8::Object> object = value.As<v8::Object>();
+		if (object->InternalFieldCount() != INTERNAL_FIELD_COUNT || object->GetPointerFromInternalField(1) != &type)
+			return NULL;
+		return reinterpret_cast<NativeObject *>(object->GetPointerFromInternalField(0));
+	}
+
+	uint64_t NativeObject::hash_value(v8::Handle<v8::Value> value)
+	{
+		// FNV-1a over the UTF-16 code units followed by the MurmurHash3 finalizer
+		v8::String::Value string(value);
+		uint64_t hash = 14695981039346656037ULL;
+		for (int i = 0; i < string.length(); i++)
+		{
+			uint16_t c = (*string)[i];
+			hash = (hash ^ (c & 0xff)) * 1099511628211ULL;
+			hash = (hash ^ (c >> 8)) * 1099511628211ULL;
+		}
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	v8::Handle<v8::Object> NativeObject::to_json_object(const NativeType &type, const std::string &data)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::Object> result = v8::Object::New();
+		std::string base64 = base64_encode(data);
+		result->Set(v8::String::New("$type"), v8::String::New(type.name));
+		result->Set(v8::String::New("data"), v8::String::New(base64.data(), static_cast<int>(base64.size())));
+		return handle_scope.Close(result);
+	}
+
+	bool NativeObject::from_json_object(v8::Handle<v8::Value> value, const NativeType &type, std::string &data)
+	{
+		v8::HandleScope handle_scope;
+		if (!value->IsObject())
+			return false;
+		v8::Handle<v8::Object> object = value.As<v8::Object>();
+		v8::String::Utf8Value type_name(object->Get(v8::String::New("$type")));
+		if (*type_name == NULL || strcmp(*type_name, type.name) != 0)
+			return false;
+		v8::Handle<v8::Value> base64 = object->Get(v8::String::New("data"));
+		if (!base64->IsString())
+			return false;
+		v8::String::AsciiValue base64_value(base64);
+		return base64_decode(*base64_value, base64_value.length(), data);
+	}
+
+	v8::Handle<v8::Value> NativeObject::throw_error(const char *message)
+	{
+		return v8::ThrowException(v8::Exception::TypeError(v8::String::New(message)));
+	}
+
+	bool NativeObject::read_count(const v8::Arguments& args, int index, uint64_t &count)
+	{
+		if (args.Length() <= index || args[index]->IsUndefined())
+		{
+			count = 1;
+			return true;
+		}
+		if (!args[index]->IsNumber())
+			return false;
+		double number = args[index]->NumberValue();
+		if (!(number >= 0) || number > 9007199254740992.0 || number != floor(number))
+			return false;
+		count = static_cast<uint64_t>(number);
+		return true;
+	}
+
+	void NativeObject::set_external_size(size_t size)
+	{
+		if (size == external_size)
+			return;
+		v8::V8::AdjustAmountOfExternalAllocatedMemory(static_cast<intptr_t>(size) - static_cast<intptr_t>(external_size));
+		external_size = size;
+	}
+
+	v8::Handle<v8::FunctionTemplate> NativeObject::create_class_template(const NativeType &type, v8::InvocationCallback constructor)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = v8::FunctionTemplate::New(constructor);
+		result->SetClassName(v8::String::New(type.name));
+		result->InstanceTemplate()->SetInternalFieldCount(INTERNAL_FIELD_COUNT);
+		return handle_scope.Close(result);
+	}
+
+	void NativeObject::set_method(v8::Handle<v8::FunctionTemplate> class_template, const char *name, v8::InvocationCallback callback)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> method = v8::FunctionTemplate::New(callback, v8::Handle<v8::Value>(), v8::Signature::New(class_template));
+		class_template->PrototypeTemplate()->Set(v8::String::New(name), method);
+	}
+
+	void NativeObject::weak_callback(v8::Persistent<v8::Value> /*object*/, void *parameter)
+	{
+		delete reinterpret_cast<NativeObject *>(parameter);
+	}
+
+	NativeObjectList::~NativeObjectList()
+	{
+		while (head != NULL)
+		{
+			NativeObject *object = head;
+			remove(object);
+			delete object;
+		}
+	}
+
+	void NativeObjectList::add(NativeObject *object)
+	{
+		object->list = this;
+		object->previous = NULL;
+		object->next = head;
+		if (head != NULL)
+			head->previous = object;
+		head = object;
+	}
+
+	void NativeObjectList::remove(NativeObject *object)
+	{
+		if (object->previous != NULL)
+			object->previous->next = object->next;
+		else
+			head = object->next;
+		if (object->next != NULL)
+			object->next->previous = object->previous;
+		object->list = NULL;
+		object->previous = NULL;
+		object->next = NULL;
+	}
+
+	void NativeWriter::write_varint(uint64_t value)
+	{
+		do
+		{
+			uint8_t byte = static_cast<uint8_t>(value & 0x7f);
+			value >>= 7;
+			write_byte(byte | (value != 0 ? 0x80 : 0));
+		} while (value != 0);
+	}
+
+	void NativeWriter::write_double(double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		for (int i = 0; i < 8; i++)
+			write_byte(static_cast<uint8_t>(bits >> (i * 8)));
+	}
+
+	void NativeWriter::write_string(const std::string &value)
+	{
+		write_varint(value.size());
+		output.append(value);
+	}
+
+	uint8_t NativeReader::read_byte()
+	{
+		if (position >= input.size())
+		{
+			failed = true;
+			return 0;
+		}
+		return static_cast<uint8_t>(input[position++]);
+	}
+
+	uint64_t NativeReader::read_varint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = read_byte();
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		failed = true;
+		return 0;
+	}
+
+	double NativeReader::read_double()
+	{
+		uint64_t bits = 0;
+		for (int i = 0; i < 8; i++)
+			bits |= static_cast<uint64_t>(read_byte()) << (i * 8);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	std::string NativeReader::read_string()
+	{
+		uint64_t length = read_varint();
+		if (failed || length > input.size() - position)
+		{
+			failed = true;
+			return std::string();
+		}
+		std::string result = input.substr(position, static_cast<size_t>(length));
+		position += static_cast<size_t>(length);
+		return result;
+	}
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+namespace js1 
+{
+	class NativeObjectList;
+
+	// Identifies the class of a native object; its address is stored in the wrapper to check receivers
+	struct NativeType 
+	{
+		const char *name;
+	};
+
+	// Base class of the native objects exposed to query scripts.  
+	//
+	// Wrappers are created from templates with INTERNAL_FIELD_COUNT internal fields holding 
+	// the native object and its type.  A native object is deleted when its wrapper is 
+	// collected, or with the isolate, and reports the memory it owns to V8 as external 
+	// memory so that large native objects trigger collections.  
+	//
+	// In the state native objects are stored as {"$type":name,"data":base64} by their toJSON 
+	// and the prelude revives them when the state is loaded.
+	class NativeObject 
+	{
+	public:
+		static const int INTERNAL_FIELD_COUNT = 2;
+
+		virtual ~NativeObject();
+
+		const NativeType &get_type() const
+		{
+			return type;
+		}
+
+		// attaches this object to a new wrapper, the wrapper owns it afterwards
+		void wrap(v8::Handle<v8::Object> object);
+
+		// returns NULL if value is not a wrapper of the given type
+		static NativeObject *unwrap(v8::Handle<v8::Value> value, const NativeType &type);
+
+		// 64-bit hash of the string form of a value, numbers hash like their string form
+		static uint64_t hash_value(v8::Handle<v8::Value> value);
+
+		// {"$type":type.name,"data":base64 of data} and back
+		static v8::Handle<v8::Object> to_json_object(const NativeType &type, const std::string &data);
+		static bool from_json_object(v8::Handle<v8::Value> value, const NativeType &type, std::string &data);
+
+		static v8::Handle<v8::Value> throw_error(const char *message);
+
+		// optional count argument of an add method, 1 if missing, otherwise a non-negative integer
+		static bool read_count(const v8::Arguments& args, int index, uint64_t &count);
+
+	protected:
+		NativeObject(const NativeType &type_) : 
+			type(type_), external_size(0), list(NULL), previous(NULL), next(NULL) 
+		{
+		}
+
+		void set_external_size(size_t size);
+
+		// constructor function template whose instances can be wrapped, methods check their receiver
+		static v8::Handle<v8::FunctionTemplate> create_class_template(const NativeType &type, v8::InvocationCallback constructor);
+		static void set_method(v8::Handle<v8::FunctionTemplate> class_template, const char *name, v8::InvocationCallback callback);
+
+	private:
+		const NativeType &type;
+		size_t external_size;
+		v8::Persistent<v8::Object> wrapper;
+		NativeObjectList *list;
+		NativeObject *previous;
+		NativeObject *next;
+
+		static void weak_callback(v8::Persistent<v8::Value> object, void *parameter);
+
+		friend class NativeObjectList;
+		NativeObject(const NativeObject &);
+		NativeObject& operator=(const NativeObject &);
+	};
+
+	// Native objects alive in an isolate; the ones still alive are deleted with the isolate data
+	class NativeObjectList 
+	{
+	public:
+		NativeObjectList() : head(NULL) 
+		{
+		}
+
+		~NativeObjectList();
+
+		void add(NativeObject *object);
+		void remove(NativeObject *object);
+
+	private:
+		NativeObject *head;
+
+		NativeObjectList(const NativeObjectList &);
+		NativeObjectList& operator=(const NativeObjectList &);
+	};
+
+	// Little endian byte encoding used by the serialized forms of native objects
+	class NativeWriter 
+	{
+	public:
+		NativeWriter(std::string &output_) : output(output_) 
+		{
+		}
+
+		void write_byte(uint8_t value)
+		{
+			output.push_back(static_cast<char>(value));
+		}
+
+		void write_varint(uint64_t value);
+		void write_double(double value);
+		void write_string(const std::string &value);
+
+	private:
+		std::string &output;
+	};
+
+	class NativeReader 
+	{
+	public:
+		NativeReader(const std::string &input_) : input(input_), position(0), failed(false) 
+		{
+		}
+
+		uint8_t read_byte();
+		uint64_t read_varint();
+		double read_double();
+		std::string read_string();
+
+		// true once a read ran past the end of the input
+		bool has_failed() const
+		{
+			return failed;
+		}
+
+		bool at_end() const
+		{
+			return position == input.size();
+		}
+
+	private:
+		const std::string &input;
+		size_t position;
+		bool failed;
+	};
+
+}
@@ -0,0 +1,393 @@
+#include "stdafx.h"
+#include "PartitionStore.h"
+#include "BinaryState.h"
+#include "JsonWriter.h"
+#include "platform.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace js1 
+{
+	PartitionStore::PartitionStore() : 
+		current(NO_ENTRY), max_materialized(1000), max_resident_bytes(0), resident_bytes(0), 
+		spill_memory(NULL), spill_capacity(0), spill_used(0), spill_garbage(0), 
+		hits(0), loads(0), misses(0), evictions(0), spills(0)
+	{
+		slots.assign(1024, NO_ENTRY);
+	}
+
+	PartitionStore::~PartitionStore()
+	{
+		clear();
+		close_spill_file();
+	}
+
+	bool PartitionStore::configure(size_t max_materialized_, uint64_t max_resident_bytes_, const std::string &spill_file_name_)
+	{
+		if (max_materialized_ < 1)
+		{
+			error = "At least one partition must be materialized";
+			return false;
+		}
+		if (spill_file_name_ != spill_file_name)
+		{
+			if (spill_memory != NULL && spill_used > spill_garbage)
+			{
+				error = "The spill file cannot be changed while partitions are spilled";
+				return false;
+			}
+			close_spill_file();
+			spill_file_name = spill_file_name_;
+		}
+		max_materialized = max_materialized_;
+		max_resident_bytes = max_resident_bytes_;
+		return true;
+	}
+
+	int PartitionStore::select(const std::string &key, v8::Handle<v8::Value> current_state, v8::Handle<v8::Value> &state, bool &loaded)
+	{
+		error.clear();
+		loaded = false;
+		if (current != NO_ENTRY)
+		{
+			if (entries[current].key == key)
+			{
+				state = current_state;
+				return 1;
+			}
+			materialize(current, current_state);
+		}
+
+		uint32_t hash = hash_key(key);
+		uint32_t index = find(key, hash);
+		if (index == NO_ENTRY)
+		{
+			// a new partition is only added once evicting has succeeded so a failure leaves no 
+			// entry without a state behind
+			if (!evict_excess(NO_ENTRY))
+				return -1;
+			current = insert(key, hash);
+			misses++;
+			return 0;
+		}
+
+		if (entries[index].materialized)
+		{
+			lru.splice(lru.begin(), lru, entries[index].lru_position);
+			state = entries[index].state;
+			hits++;
+		}
+		else
+		{
+			state = load(index);
+			if (state.IsEmpty())
+				return -1;
+			loaded = true;
+			loads++;
+		}
+
+		// current is only moved once nothing can fail, the query keeps its state on failure
+		if (!evict_excess(index))
+			return -1;
+		current = index;
+		return 1;
+	}
+
+	void PartitionStore::clear()
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+			entries[i].state.Dispose();
+		entries.clear();
+		slots.assign(1024, NO_ENTRY);
+		lru.clear();
+		current = NO_ENTRY;
+		resident_bytes = 0;
+		spill_used = 0;
+		spill_garbage = 0;
+	}
+
+	void PartitionStore::write_statistics(JsonWriter &writer)
+	{
+		writer.begin_object();
+		writer.member("partitions", static_cast<uint64_t>(entries.size()));
+		writer.member("materialized", static_cast<uint64_t>(lru.size()));
+		writer.member("max_materialized", static_cast<uint64_t>(max_materialized));
+		writer.member("resident_bytes", resident_bytes);
+		writer.member("max_resident_bytes", max_resident_bytes);
+		writer.member("spill_file_bytes", spill_capacity);
+		writer.member("spill_used_bytes", spill_used - spill_garbage);
+		writer.member("spill_garbage_bytes", spill_garbage);
+		writer.member("hits", hits);
+		writer.member("loads", loads);
+		writer.member("misses", misses);
+		writer.member("evictions", evictions);
+		writer.member("spills", spills);
+		writer.end_object();
+	}
+
+	bool PartitionStore::write_json(v8::Handle<v8::Value> current_state, ChunkSink &sink)
+	{
+		if (!sink.write("{", 1))
+			return false;
+		for (uint32_t index = 0; index < entries.size(); index++)
+		{
+			v8::HandleScope handle_scope;
+			Entry &entry = entries[index];
+			v8::Handle<v8::Value> value;
+			if (index == current)
+				value = current_state;
+			else if (entry.materialized)
+				value = entry.state;
+			else
+			{
+				BinaryStateReader reader(
+					entry.spilled ? spill_memory + entry.spill_offset : entry.data.data(), 
+					entry.spilled ? entry.spill_length : entry.data.size());
+				value = reader.deserialize();
+				if (value.IsEmpty())
+				{
+					error = "Partition '" + entry.key + "' cannot be loaded: " + reader.get_error();
+					return false;
+				}
+			}
+
+			if (index > 0 && !sink.write(",", 1))
+				return false;
+			StateSerializer key_serializer(sink, entry.key.size() + 2);
+			if (!key_serializer.serialize(v8::String::New(entry.key.data(), static_cast<int>(entry.key.size()))) || !sink.write(":", 1))
+				return false;
+			StateSerializer serializer(sink, 64 * 1024);
+			if (!serializer.serialize(value))
+			{
+				error = serializer.get_error();
+				return false;
+			}
+		}
+		return sink.write("}", 1);
+	}
+
+	uint32_t PartitionStore::shard_of(const std::string &key, uint32_t shard_count)
+	{
+		return static_cast<uint32_t>((static_cast<uint64_t>(hash_key(key)) * shard_count) >> 32);
+	}
+
+	uint32_t PartitionStore::find(const std::string &key, uint32_t hash)
+	{
+		size_t mask = slots.size() - 1;
+		for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+		{
+			uint32_t index = slots[slot];
+			if (index == NO_ENTRY)
+				return NO_ENTRY;
+			if (entries[index].hash == hash && entries[index].key == key)
+				return index;
+		}
+	}
+
+	uint32_t PartitionStore::insert(const std::string &key, uint32_t hash)
+	{
+		if ((entries.size() + 1) * 10 > slots.size() * 7)
+			grow();
+		uint32_t index = static_cast<uint32_t>(entries.size());
+		entries.push_back(Entry());
+		Entry &entry = entries.back();
+		entry.key = key;
+		entry.hash = hash;
+		entry.materialized = false;
+		entry.spilled = false;
+		entry.lru_position = lru.end();
+		entry.spill_offset = 0;
+		entry.spill_length = 0;
+
+		size_t mask = slots.size() - 1;
+		size_t slot = hash & mask;
+		while (slots[slot] != NO_ENTRY)
+			slot = (slot + 1) & mask;
+		slots[slot] = index;
+		return index;
+	}
+
+	void PartitionStore::grow()
+	{
+		slots.assign(slots.size() * 2, NO_ENTRY);
+		size_t mask = slots.size() - 1;
+		for (uint32_t index = 0; index < entries.size(); index++)
+		{
+			size_t slot = entries[index].hash & mask;
+			while (slots[slot] != NO_ENTRY)
+				slot = (slot + 1) & mask;
+			slots[slot] = index;
+		}
+	}
+
+	uint32_t PartitionStore::hash_key(const std::string &key)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < key.size(); i++)
+		{
+			hash ^= static_cast<uint8_t>(key[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	void PartitionStore::materialize(uint32_t index, v8::Handle<v8::Value> value)
+	{
+		Entry &entry = entries[index];
+		entry.state.Dispose();
+		entry.state = v8::Persistent<v8::Value>::New(value);
+		if (entry.materialized)
+			lru.splice(lru.begin(), lru, entry.lru_position);
+		else
+		{
+			lru.push_front(index);
+			entry.lru_position = lru.begin();
+			entry.materialized = true;
+		}
+		// the serialized form is stale once the state is materialized
+		resident_bytes -= entry.data.size();
+		std::string().swap(entry.data);
+		if (entry.spilled)
+			release_spilled(entry);
+	}
+
+	v8::Handle<v8::Value> PartitionStore::load(uint32_t index)
+	{
+		v8::HandleScope handle_scope;
+		Entry &entry = entries[index];
+		v8::Handle<v8::Value> value;
+		if (entry.spilled)
+		{
+			BinaryStateReader reader(spill_memory + entry.spill_offset, entry.spill_length);
+			value = reader.deserialize();
+			if (value.IsEmpty())
+				error = "Spilled partition '" + entry.key + "' cannot be loaded: " + reader.get_error();
+		}
+		else
+		{
+			BinaryStateReader reader(entry.data.data(), entry.data.size());
+			value = reader.deserialize();
+			if (value.IsEmpty())
+				error = "Partition '" + entry.key + "' cannot be loaded: " + reader.get_error();
+		}
+		if (value.IsEmpty())
+			return value;
+		materialize(index, value);
+		return handle_scope.Close(value);
+	}
+
+	bool PartitionStore::evict_excess(uint32_t keep)
+	{
+		while (lru.size() > max_materialized && lru.back() != keep)
+			if (!evict())
+				return false;
+		return true;
+	}
+
+	bool PartitionStore::evict()
+	{
+		uint32_t index = lru.back();
+		Entry &entry = entries[index];
+
+		v8::HandleScope handle_scope;
+		std::string data;
+		StringChunkSink sink(data);
+		BinaryStateWriter writer(sink, 64 * 1024);
+		if (!writer.serialize(entry.state))
+		{
+			error = "Partition '" + entry.key + "' cannot be serialized: " + writer.get_error();
+			return false;
+		}
+		entry.state.Dispose();
+		entry.state.Clear();
+		lru.pop_back();
+		entry.materialized = false;
+		entry.lru_position = lru.end();
+		entry.data.swap(data);
+		resident_bytes += entry.data.size();
+		evictions++;
+
+		if (!spill_file_name.empty() && resident_bytes > max_resident_bytes)
+			return spill(entry);
+		return true;
+	}
+
+	bool PartitionStore::spill(Entry &entry)
+	{
+		if (!ensure_spill_capacity(entry.data.size()))
+			return false;
+		memcpy(spill_memory + spill_used, entry.data.data(), entry.data.size());
+		entry.spill_offset = spill_used;
+		entry.spill_length = static_cast<uint32_t>(entry.data.size());
+		entry.spilled = true;
+		spill_used += entry.data.size();
+		resident_bytes -= entry.data.size();
+		std::string().swap(entry.data);
+		spills++;
+		return true;
+	}
+
+	void PartitionStore::release_spilled(Entry &entry)
+	{
+		entry.spilled = false;
+		spill_garbage += entry.spill_length;
+		entry.spill_length = 0;
+	}
+
+	bool PartitionStore::ensure_spill_capacity(uint64_t length)
+	{
+		if (spill_garbage * 2 > spill_used)
+			compact_spill_file();
+		uint64_t required = spill_used + length;
+		if (required <= spill_capacity)
+			return true;
+
+		uint64_t capacity = std::max<uint64_t>(spill_capacity, MIN_SPILL_FILE_SIZE);
+		while (capacity < required)
+			capacity *= 2;
+		// the file is mapped again at the new size before the old view is released, so the 
+		// spilled partitions stay readable if the file cannot be extended
+		char *memory = reinterpret_cast<char *>(platform::map_file(spill_file_name.c_str(), static_cast<size_t>(capacity)));
+		if (memory == NULL)
+		{
+			error = "Cannot map the partition spill file '" + spill_file_name + "'";
+			return false;
+		}
+		if (spill_memory != NULL)
+			platform::unmap_file(spill_memory, static_cast<size_t>(spill_capacity));
+		spill_memory = memory;
+		spill_capacity = capacity;
+		return true;
+	}
+
+	void PartitionStore::compact_spill_file()
+	{
+		std::vector<std::pair<uint64_t, uint32_t> > spilled;
+		for (uint32_t index = 0; index < entries.size(); index++)
+			if (entries[index].spilled)
+				spilled.push_back(std::make_pair(entries[index].spill_offset, index));
+		std::sort(spilled.begin(), spilled.end());
+
+		uint64_t position = 0;
+		for (size_t i = 0; i < spilled.size(); i++)
+		{
+			Entry &entry = entries[spilled[i].second];
+			if (entry.spill_offset != position)
+				memmove(spill_memory + position, spill_memory + entry.spill_offset, entry.spill_length);
+			entry.spill_offset = position;
+			position += entry.spill_length;
+		}
+		spill_used = position;
+		spill_garbage = 0;
+	}
+
+	void PartitionStore::close_spill_file()
+	{
+		if (spill_memory != NULL)
+			platform::unmap_file(spill_memory, static_cast<size_t>(spill_capacity));
+		spill_memory = NULL;
+		spill_capacity = 0;
+	}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+namespace js1 
+{
+	class JsonWriter;
+	class ChunkSink;
+
+	// Keeps the states of the partitions of a by-stream projection inside the isolate so 
+	// that switching partitions does not go through JSON.  
+	//
+	// Partitions are looked up in an open addressing hash table.  The most recently used 
+	// max_materialized partitions are kept as V8 objects; older ones are serialized in the 
+	// binary state format and, once their total size exceeds max_resident_bytes, moved to 
+	// a memory mapped spill file.  The spill file is scratch space and is compacted when 
+	// more than half of it is unused.  All methods taking handles must be called within 
+	// the context of the query.
+	class PartitionStore 
+	{
+	public:
+		PartitionStore();
+		~PartitionStore();
+
+		// spill_file_name may be empty to keep all serialized partitions in memory
+		bool configure(size_t max_materialized, uint64_t max_resident_bytes, const std::string &spill_file_name);
+
+		// stores current_state as the state of the current partition and makes key current.
+		// Returns 1 with state set if the partition is known, 0 if it is new (its state is 
+		// taken from the query when the next partition is selected, so the caller must give 
+		// the query a new state object) and -1 with error set if a state could not be 
+		// serialized or loaded, in which case the current partition does not change.  
+		// loaded is set when state was deserialized rather than kept materialized.
+		int select(const std::string &key, v8::Handle<v8::Value> current_state, v8::Handle<v8::Value> &state, bool &loaded);
+
+		void clear();
+		void write_statistics(JsonWriter &writer);
+
+		// writes all the partitions as a JSON object keyed by partition, current_state is 
+		// the state of the current partition.  Returns false with error set or an exception 
+		// left in the caller's TryCatch.
+		bool write_json(v8::Handle<v8::Value> current_state, ChunkSink &sink);
+
+		// shard of a partition key; uses the high bits of the hash the table probes with the low bits of
+		static uint32_t shard_of(const std::string &key, uint32_t shard_count);
+
+		const std::string &get_error() const
+		{
+			return error;
+		}
+
+	private:
+		struct Entry 
+		{
+			std::string key;
+			uint32_t hash;
+			bool materialized;
+			bool spilled;
+			v8::Persistent<v8::Value> state;
+			std::list<uint32_t>::iterator lru_position;
+			std::string data;
+			uint64_t spill_offset;
+			uint32_t spill_length;
+		};
+
+		static const uint32_t NO_ENTRY = 0xffffffff;
+		static const size_t MIN_SPILL_FILE_SIZE = 16 * 1024 * 1024;
+
+		std::vector<Entry> entries;
+		std::vector<uint32_t> slots;
+		std::list<uint32_t> lru;
+		uint32_t current;
+		std::string error;
+
+		size_t max_materialized;
+		uint64_t max_resident_bytes;
+		uint64_t resident_bytes;
+
+		std::string spill_file_name;
+		char *spill_memory;
+		uint64_t spill_capacity;
+		uint64_t spill_used;
+		uint64_t spill_garbage;
+
+		uint64_t hits;
+		uint64_t loads;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t spills;
+
+		uint32_t find(const std::string &key, uint32_t hash);
+		uint32_t insert(const std::string &key, uint32_t hash);
+		void grow();
+		static uint32_t hash_key(const std::string &key);
+
+		void materialize(uint32_t index, v8::Handle<v8::Value> value);
+		v8::Handle<v8::Value> load(uint32_t index);
+		// evicts the least recently used partitions other than keep down to max_materialized
+		bool evict_excess(uint32_t keep);
+		bool evict();
+		bool spill(Entry &entry);
+		void release_spilled(Entry &entry);
+		bool ensure_spill_capacity(uint64_t length);
+		void compact_spill_file();
+		void close_spill_file();
+
+		PartitionStore(const PartitionStore &);
+		PartitionStore& operator=(const PartitionStore &);
+	};
+
+}
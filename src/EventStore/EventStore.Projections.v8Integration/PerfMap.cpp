@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "PerfMap.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+	bool PerfMap::enabled = false;
+	FILE *PerfMap::file = NULL;
+	uint64_t PerfMap::last_flush_us = 0;
+	std::map<void *, PerfMap::CodeEntry> PerfMap::code;
+	platform::Mutex PerfMap::lock;
+
+	bool PerfMap::enable(bool enabled_)
+	{
+#if __GNUC__ >= 4
+		platform::ScopedLock scoped_lock(lock);
+		if (enabled_ && file == NULL)
+		{
+			char file_name[64];
+			sprintf(file_name, "/tmp/perf-%u.map", platform::process_id());
+			file = fopen(file_name, "a");
+			if (file == NULL)
+				return false;
+			setvbuf(file, NULL, _IOFBF, 64 * 1024);
+			last_flush_us = platform::now_us();
+		}
+		else if (!enabled_ && file != NULL)
+		{
+			// closing flushes the buffered entries
+			fclose(file);
+			file = NULL;
+			code.clear();
+		}
+		enabled = enabled_;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void PerfMap::flush()
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (file == NULL)
+			return;
+		fflush(file);
+		last_flush_us = platform::now_us();
+	}
+
+	void PerfMap::install()
+	{
+		if (!enabled)
+			return;
+		v8::V8::SetJitCodeEventHandler(v8::kJitCodeEventEnumExisting, jit_code_event);
+	}
+
+	void PerfMap::jit_code_event(const v8::JitCodeEvent *event)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (!enabled)
+			return;
+
+		switch (event->type)
+		{
+		case v8::JitCodeEvent::CODE_ADDED:
+			{
+				CodeEntry &entry = code[event->code_start];
+				entry.length = event->code_len;
+				entry.name.assign(event->name.str, event->name.len);
+				write_entry(event->code_start, entry);
+				break;
+			}
+		case v8::JitCodeEvent::CODE_MOVED:
+			{
+				// perf uses the last entry covering an address, so a moved code object is just written again
+				std::map<void *, CodeEntry>::iterator it = code.find(event->code_start);
+				if (it == code.end())
+					break;
+				CodeEntry entry = it->second;
+				code.erase(it);
+				code[event->new_code_start] = entry;
+				write_entry(event->new_code_start, entry);
+				break;
+			}
+		case v8::JitCodeEvent::CODE_REMOVED:
+			code.erase(event->code_start);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void PerfMap::write_entry(void *start, const CodeEntry &entry)
+	{
+		fprintf(file, "%lx %lx %s\n", 
+			static_cast<unsigned long>(reinterpret_cast<uintptr_t>(start)), 
+			static_cast<unsigned long>(entry.length), entry.name.c_str());
+		uint64_t now_us = platform::now_us();
+		if (now_us - last_flush_us >= 1000000)
+		{
+			fflush(file);
+			last_flush_us = now_us;
+		}
+	}
+
+}
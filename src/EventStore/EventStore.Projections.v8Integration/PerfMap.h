@@ -0,0 +1,41 @@
+#pragma once
+#include "platform.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+
+	// Keeps /tmp/perf-<pid>.map up to date with the JIT code of all the isolates 
+	// created while it has been enabled, so that Linux perf can symbolize JS frames.  
+	// Entries are buffered and flushed at most once a second while code is added, 
+	// on every idle tick of the host and on disable, so a burst of compilations 
+	// costs no more than a few writes and the last functions compiled before 
+	// going quiet still reach the file.  Not supported on Windows.
+	class PerfMap 
+	{
+	public:
+		static bool enable(bool enabled);
+		static void flush();
+
+		// installs the JIT code event handler into the current isolate
+		static void install();
+
+	private:
+		struct CodeEntry 
+		{
+			size_t length;
+			std::string name;
+		};
+
+		static bool enabled;
+		static FILE *file;
+		static uint64_t last_flush_us;
+		static std::map<void *, CodeEntry> code;
+		static platform::Mutex lock;
+
+		static void jit_code_event(const v8::JitCodeEvent *event);
+		static void write_entry(void *start, const CodeEntry &entry);
+	};
+
+}
@@ -4,12 +4,26 @@
 #include "PreludeScript.h"
 #include "QueryScript.h"
 #include "EventHandler.h"
+#include "GcStatistics.h"
+#include "CounterTable.h"
+#include "PerfMap.h"
+#include "TraceLog.h"
+#include "LogPipeline.h"
+#include "encoding.h"
+#include "HyperLogLog.h"
+#include "CountMinSketch.h"
+#include "TopK.h"
+#include "TDigest.h"
+#include "TimeWindow.h"
+#include "Timestamp.h"
 
 namespace js1 
 {
 
 	PreludeScript::~PreludeScript()
 	{
+		// the log callback must not be called once the prelude is disposed
+		LogPipeline::flush(log_handler);
 		global_template_factory.Dispose();
 		isolate_release(isolate);
 	}
@@ -17,6 +31,9 @@ namespace js1
 
 	bool PreludeScript::compile_script(const uint16_t *prelude_source, const uint16_t *prelude_file_name)
 	{
+		initialize_isolate();
+		this->prelude_source.source.assign(prelude_source, prelude_source + utf16_length(prelude_source) + 1);
+		this->prelude_source.file_name.assign(prelude_file_name, prelude_file_name + utf16_length(prelude_file_name) + 1);
 		return CompiledScript::compile_script(prelude_source, prelude_file_name);
 	}
 
@@ -81,6 +98,14 @@ namespace js1
 		return result;
 	}
 
+	void PreludeScript::initialize_isolate()
+	{
+		// the prelude owns the isolate and is the first script compiled in it
+		GcStatistics::install();
+		CounterTable::install();
+		PerfMap::install();
+	}
+
 	v8::Isolate *PreludeScript::get_isolate()
 	{
 		return isolate;
@@ -92,6 +117,14 @@ namespace js1
 		v8::Persistent<v8::ObjectTemplate> prelude = v8::Persistent<v8::ObjectTemplate>::New(v8::ObjectTemplate::New());
 		prelude->Set(v8::String::New("$log"), v8::FunctionTemplate::New(log_callback, v8::External::Wrap(this)));
 		prelude->Set(v8::String::New("$load_module"), v8::FunctionTemplate::New(load_module_callback, v8::External::Wrap(this)));
+		prelude->Set(v8::String::New("$HyperLogLog"), HyperLogLog::create_template());
+		prelude->Set(v8::String::New("$CountMinSketch"), CountMinSketch::create_template());
+		prelude->Set(v8::String::New("$TopK"), TopK::create_template());
+		prelude->Set(v8::String::New("$TDigest"), TDigest::create_template());
+		prelude->Set(v8::String::New("$SlidingWindow"), TimeWindow::create_sliding_template());
+		prelude->Set(v8::String::New("$TumblingWindow"), TimeWindow::create_tumbling_template());
+		prelude->Set(v8::String::New("$parseTimestamp"), v8::FunctionTemplate::New(parse_timestamp_callback));
+		prelude->Set(v8::String::New("$timeBucket"), v8::FunctionTemplate::New(time_bucket_callback));
 		return prelude;
 	}
 
@@ -102,17 +135,41 @@ namespace js1
 		// string passed as arguments into C++ are much easy to handle
 
 		void *module_handle = load_module_handler(module_name);
-		return reinterpret_cast<ModuleScript *>(module_handle);
+		ModuleScript *module = reinterpret_cast<ModuleScript *>(module_handle);
+		if (module != NULL)
+		{
+			Source &source = module_sources[utf16_to_utf8(module_name)];
+			source.source = module->get_source();
+			source.file_name = module->get_file_name();
+		}
+		return module;
+	}
+
+	const PreludeScript::Source *PreludeScript::find_module_source(const std::string &module_name) const
+	{
+		std::map<std::string, Source>::const_iterator it = module_sources.find(module_name);
+		return it == module_sources.end() ? NULL : &it->second;
 	}
 
 	v8::Handle<v8::Value> PreludeScript::log_callback(const v8::Arguments& args) 
 	{
-		if (args.Length() != 1) 
-			return v8::ThrowException(v8::Exception::Error(v8::String::New("The 'log' handler expects 1 argument")));
+		if (args.Length() < 1 || args.Length() > 2) 
+			return v8::ThrowException(v8::Exception::Error(v8::String::New("The 'log' handler expects 1 or 2 arguments")));
 
 		if (args[0].IsEmpty()) 
 			return v8::ThrowException(v8::Exception::Error(v8::String::New("The 'log' handler argument cannot be empty")));
 
+		// the level is checked before the message is converted
+		int32_t level = LogPipeline::LEVEL_INFO;
+		if (args.Length() == 2)
+		{
+			if (!args[1]->IsInt32())
+				return v8::ThrowException(v8::Exception::Error(v8::String::New("The 'log' handler level must be an integer")));
+			level = args[1]->Int32Value();
+		}
+		if (!LogPipeline::is_accepted(level))
+			return v8::Undefined();
+
 		// TODO: do we need to check argument data type?
 
 		v8::Handle<v8::Value> data = args.Data();
@@ -121,7 +178,8 @@ namespace js1
 		//TODO: make sure correct value type passed
 		v8::String::Value message(args[0].As<v8::String>());
 
-		prelude->log_handler(*message);
+		TraceSpan trace_span("log", "js1.callback", prelude);
+		LogPipeline::write(prelude->log_handler, *message, message.length());
 		return v8::Undefined();
 	};
 
@@ -20,6 +20,25 @@ namespace js1 {
 		bool compile_script(const uint16_t *prelude_source, const uint16_t *prelude_file_name);
 		bool run();
 		v8::Persistent<v8::ObjectTemplate> get_template(std::vector<v8::Handle<v8::Value> > &prelude_arguments);
+
+		// sources of the prelude and of the modules it has loaded, used to recreate it in other isolates
+		struct Source 
+		{
+			std::vector<uint16_t> source;
+			std::vector<uint16_t> file_name;
+		};
+
+		const Source &get_source() const
+		{
+			return prelude_source;
+		}
+
+		const Source *find_module_source(const std::string &module_name) const;
+
+		LOG_CALLBACK get_log_handler() const
+		{
+			return log_handler;
+		}
 	protected:
 		virtual v8::Isolate *get_isolate();
 		virtual v8::Persistent<v8::ObjectTemplate> create_global_template();
@@ -29,7 +48,10 @@ namespace js1 {
 		v8::Persistent<v8::Function> global_template_factory;
 		LOAD_MODULE_CALLBACK load_module_handler;
 		LOG_CALLBACK log_handler;
+		Source prelude_source;
+		std::map<std::string, Source> module_sources;
 		ModuleScript *load_module(uint16_t *module_name);
+		void initialize_isolate();
 
 		static v8::Handle<v8::Value> log_callback(const v8::Arguments& args); 
 		static v8::Handle<v8::Value> load_module_callback(const v8::Arguments& args); 
@@ -4,6 +4,16 @@
 #include "PreludeScript.h"
 #include "QueryScript.h"
 #include "EventHandler.h"
+#include "IsolateData.h"
+#include "JsonWriter.h"
+#include "platform.h"
+#include "TraceLog.h"
+#include "encoding.h"
+#include "StateSerializer.h"
+#include "StateLoader.h"
+#include "BinaryState.h"
+#include "ExecuteResult.h"
+#include "StatePath.h"
 
 #include <string>
 
@@ -19,6 +29,8 @@ namespace js1
 		{
 			delete *it;
 		}
+		delete state_loader;
+		invalidate_state_cache();
 		isolate_release(isolate);
 	}
 
@@ -35,37 +47,500 @@ namespace js1
 		return run_script(get_context());
 	}
 
-	v8::Persistent<v8::String> QueryScript::execute_handler(void *event_handler_handle, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length) 
+	ExecuteResult *QueryScript::execute_handler(void *event_handler_handle, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length) 
 	{
 		EventHandler *event_handler = reinterpret_cast<EventHandler *>(event_handler_handle);
+		IsolateData *isolate_data = IsolateData::current();
+		isolate_data->idle_gc_policy.record_activity();
+		if (isolate_data->cpu_profile_session.is_running())
+			isolate_data->cpu_profile_session.check_deadline();
+		uint64_t started_us = platform::now_us();
+		if (!event_handler->is_read_only())
+			invalidate_state_cache();
 
 		v8::HandleScope handle_scope;
 		v8::Context::Scope local(get_context());
 
 		v8::Handle<v8::String> data_json_handle = v8::String::New(data_json);
+		size_t bytes_in = data_json_handle->Length();
 		v8::Handle<v8::Value> argv[10];
 		argv[0] = data_json_handle;
 
 		for (int i = 0; i < other_length; i++) {
 			v8::Handle<v8::String> data_other_handle = v8::String::New(data_other[i]);
+			bytes_in += data_other_handle->Length();
 			argv[1 + i] = data_other_handle;
 		}
 
 		v8::Handle<v8::Object> global = get_context()->Global();
 
 		v8::TryCatch try_catch;
+		uint64_t call_started_us = platform::now_us();
 		v8::Handle<v8::Value> result = event_handler->get_handler()->Call(global, 1 + other_length, argv);
+		uint64_t call_completed_us = platform::now_us();
 		set_last_error(result.IsEmpty(), try_catch);
-		v8::Handle<v8::String> empty;
-		if (result.IsEmpty())
+		v8::Handle<v8::String> result_string;
+		if (!result.IsEmpty()) 
 		{
-			return v8::Persistent<v8::String>::New(empty);
+			if (result->IsString())
+				result_string = result.As<v8::String>();
+			else
+				set_last_error(v8::String::New("Handler must return string data"));
 		}
-		if (!result->IsString()) {
-			set_last_error(v8::String::New("Handler must return string data"));
-			return v8::Persistent<v8::String>::New(empty);
+		size_t bytes_out = result_string.IsEmpty() ? 0 : result_string->Length();
+		ExecuteResult *execute_result = result_string.IsEmpty() ? NULL : ExecuteResult::create(result_string);
+
+		HandlerStatistics::Outcome outcome = result.IsEmpty() ? HandlerStatistics::THREW 
+			: result_string.IsEmpty() ? HandlerStatistics::INVALID_RESULT : HandlerStatistics::SUCCEEDED;
+		event_handler->get_statistics().record(
+			(call_started_us - started_us) + (platform::now_us() - call_completed_us), 
+			call_completed_us - call_started_us, 
+			bytes_in * sizeof(uint16_t), bytes_out * sizeof(uint16_t), outcome);
+		if (execute_result == NULL)
+			return NULL;
+
+		if (event_handler == get_state_handler)
+		{
+			invalidate_state_cache();
+			cached_state = execute_result->add_ref();
+		}
+		return execute_result;
+	}
+
+	ExecuteResult *QueryScript::get_cached_result(void *event_handler_handle)
+	{
+		// a pending error must be reported by running the handler again
+		if (cached_state == NULL || event_handler_handle != get_state_handler || has_last_error())
+			return NULL;
+		return cached_state->add_ref();
+	}
+
+	void QueryScript::invalidate_state_cache()
+	{
+		if (cached_state != NULL)
+		{
+			cached_state->release();
+			cached_state = NULL;
+		}
+	}
+
+	void QueryScript::write_handler_statistics(JsonWriter &writer)
+	{
+		writer.begin_object();
+		writer.member("unit", "us");
+		writer.key("handlers");
+		writer.begin_object();
+		for (std::list<EventHandler *>::iterator it = registred_handlers.begin(); it != registred_handlers.end(); it++)
+		{
+			writer.key((*it)->get_name());
+			(*it)->get_statistics().write_json(writer);
+		}
+		writer.end_object();
+		writer.end_object();
+	}
+
+	void QueryScript::reset_handler_statistics()
+	{
+		for (std::list<EventHandler *>::iterator it = registred_handlers.begin(); it != registred_handlers.end(); it++)
+		{
+			(*it)->get_statistics().reset();
+		}
+	}
+
+	bool QueryScript::get_state_at(const uint16_t *path, std::string &json)
+	{
+		StatePath state_path;
+		if (!state_path.parse(path))
+		{
+			set_last_error(v8::String::New(state_path.get_error().c_str()));
+			return false;
+		}
+
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state = get_state_object();
+		v8::Handle<v8::Value> value;
+		if (!state.IsEmpty())
+			value = state_path.resolve(state);
+		if (value.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else if (!state_path.get_error().empty())
+				set_last_error(v8::String::New(state_path.get_error().c_str()));
+			return false;
+		}
+
+		StringChunkSink sink(json);
+		StateSerializer serializer(sink, 64 * 1024);
+		if (!serializer.serialize(value))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(serializer.get_error().c_str()));
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	bool QueryScript::get_state_delta(bool full, int32_t full_snapshot_every, std::string &delta)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state = get_state_object();
+		if (state.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		bool written = state_delta.write(state, full, full_snapshot_every, delta);
+		set_last_error(!written, try_catch);
+		return written;
+	}
+
+	bool QueryScript::apply_state_delta(const uint16_t *delta_json)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state = get_state_object();
+		if (state.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		std::string error;
+		v8::Handle<v8::Value> new_state = state_delta.apply(state, delta_json, error);
+		if (new_state.IsEmpty())
+		{
+			if (error.empty())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(error.c_str()));
+			return false;
+		}
+		if (!set_state_object(new_state, true))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	bool QueryScript::write_state(ChunkSink &sink, size_t chunk_size)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state = get_state_object();
+		if (state.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		StateSerializer serializer(sink, chunk_size);
+		if (!serializer.serialize(state))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(serializer.get_error().c_str()));
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	void QueryScript::begin_state_load()
+	{
+		delete state_loader;
+		state_loader = new StateLoader();
+	}
+
+	bool QueryScript::append_state_chunk(const char *data, size_t length)
+	{
+		if (state_loader == NULL)
+		{
+			set_last_error(v8::String::New("State load has not been started"));
+			return false;
+		}
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		if (!state_loader->append(data, length))
+		{
+			set_last_error(v8::String::New(state_loader->get_error().c_str()));
+			delete state_loader;
+			state_loader = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	bool QueryScript::end_state_load()
+	{
+		if (state_loader == NULL)
+		{
+			set_last_error(v8::String::New("State load has not been started"));
+			return false;
+		}
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state;
+		bool loaded = state_loader->end(state);
+		if (!loaded)
+			set_last_error(v8::String::New(state_loader->get_error().c_str()));
+		else if (!set_state_object(state, true))
+		{
+			loaded = false;
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+		}
+		else
+			set_last_error(false, try_catch);
+		delete state_loader;
+		state_loader = NULL;
+		return loaded;
+	}
+
+	bool QueryScript::export_state(ChunkSink &sink, size_t chunk_size)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> state = get_state_object();
+		if (state.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		BinaryStateWriter writer(sink, chunk_size);
+		if (!writer.serialize(state))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(writer.get_error().c_str()));
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	bool QueryScript::import_state(const char *data, size_t length)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		BinaryStateReader reader(data, length);
+		v8::Handle<v8::Value> state = reader.deserialize();
+		if (state.IsEmpty())
+		{
+			set_last_error(v8::String::New(reader.get_error().c_str()));
+			return false;
+		}
+		if (!set_state_object(state, true))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	bool QueryScript::configure_partition_store(size_t max_materialized, uint64_t max_resident_bytes, const std::string &spill_file_name)
+	{
+		if (!partition_store.configure(max_materialized, max_resident_bytes, spill_file_name))
+		{
+			set_last_error(v8::String::New(partition_store.get_error().c_str()));
+			return false;
+		}
+		return true;
+	}
+
+	int32_t QueryScript::select_partition(const uint16_t *partition)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> current_state = get_state_object();
+		if (current_state.IsEmpty())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return -1;
+		}
+		v8::Handle<v8::Value> state;
+		bool loaded;
+		int32_t result = partition_store.select(utf16_to_utf8(partition), current_state, state, loaded);
+		if (result < 0)
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(partition_store.get_error().c_str()));
+			return -1;
+		}
+		if (result > 0 && !set_state_object(state, loaded))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return -1;
+		}
+		// a new partition starts from the initial state instead of sharing the state object 
+		// just stored for the previous partition
+		if (result == 0 && !initialize_state())
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			return -1;
+		}
+		set_last_error(false, try_catch);
+		return result;
+	}
+
+	void QueryScript::clear_partition_store()
+	{
+		partition_store.clear();
+	}
+
+	void QueryScript::write_partition_store_statistics(JsonWriter &writer)
+	{
+		partition_store.write_statistics(writer);
+	}
+
+	bool QueryScript::write_partitions(ChunkSink &sink)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Value> current_state = get_state_object();
+		if (current_state.IsEmpty() || !partition_store.write_json(current_state, sink))
+		{
+			if (try_catch.HasCaught())
+				set_last_error(true, try_catch);
+			else
+				set_last_error(v8::String::New(partition_store.get_error().c_str()));
+			return false;
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	bool QueryScript::load_partitions(const uint16_t *partitions_json, uint32_t shard, uint32_t shard_count)
+	{
+		v8::HandleScope handle_scope;
+		v8::Context::Scope local(get_context());
+		v8::TryCatch try_catch;
+
+		v8::Handle<v8::Object> global = get_context()->Global();
+		v8::Handle<v8::Object> json = global->Get(v8::String::New("JSON")).As<v8::Object>();
+		v8::Handle<v8::Value> argv[1] = { v8::String::New(partitions_json) };
+		v8::Handle<v8::Value> parsed = json->Get(v8::String::New("parse")).As<v8::Function>()->Call(json, 1, argv);
+		if (parsed.IsEmpty())
+		{
+			set_last_error(true, try_catch);
+			return false;
+		}
+		if (!parsed->IsObject() || parsed->IsArray())
+		{
+			set_last_error(v8::String::New("Partitioned state must be an object keyed by partition"));
+			return false;
+		}
+
+		v8::Handle<v8::Object> partitions = parsed.As<v8::Object>();
+		v8::Handle<v8::Array> names = partitions->GetOwnPropertyNames();
+		for (uint32_t i = 0; i < names->Length(); i++)
+		{
+			v8::HandleScope partition_scope;
+			v8::Handle<v8::String> name = names->Get(i)->ToString();
+			v8::String::Utf8Value utf8(name);
+			std::string key(*utf8, utf8.length());
+			if (PartitionStore::shard_of(key, shard_count) != shard)
+				continue;
+
+			v8::Handle<v8::Value> current_state = get_state_object();
+			v8::Handle<v8::Value> state;
+			bool loaded;
+			if (current_state.IsEmpty() 
+				|| partition_store.select(key, current_state, state, loaded) < 0 
+				|| !set_state_object(partitions->Get(name), true))
+			{
+				if (try_catch.HasCaught())
+					set_last_error(true, try_catch);
+				else
+					set_last_error(v8::String::New(partition_store.get_error().c_str()));
+				return false;
+			}
+		}
+		set_last_error(false, try_catch);
+		return true;
+	}
+
+	EventHandler *QueryScript::find_handler(const char *name)
+	{
+		for (std::list<EventHandler *>::iterator it = registred_handlers.begin(); it != registred_handlers.end(); it++)
+		{
+			if ((*it)->get_name() == name)
+				return *it;
+		}
+		return NULL;
+	}
+
+	v8::Handle<v8::Value> QueryScript::get_state_object()
+	{
+		EventHandler *handler = find_handler("get_state_object");
+		if (handler == NULL)
+		{
+			set_last_error(v8::String::New("'get_state_object' command handler has not been registered"));
+			return v8::Handle<v8::Value>();
+		}
+		return handler->get_handler()->Call(get_context()->Global(), 0, NULL);
+	}
+
+	bool QueryScript::set_state_object(v8::Handle<v8::Value> state, bool revive)
+	{
+		EventHandler *handler = find_handler("set_state_object");
+		if (handler == NULL)
+		{
+			set_last_error(v8::String::New("'set_state_object' command handler has not been registered"));
+			return false;
+		}
+		invalidate_state_cache();
+		v8::Handle<v8::Value> argv[2] = { state, v8::Boolean::New(revive) };
+		return !handler->get_handler()->Call(get_context()->Global(), 2, argv).IsEmpty();
+	}
+
+	bool QueryScript::initialize_state()
+	{
+		EventHandler *handler = find_handler("initialize");
+		if (handler == NULL)
+		{
+			set_last_error(v8::String::New("'initialize' command handler has not been registered"));
+			return false;
 		}
-		return v8::Persistent<v8::String>::New(result.As<v8::String>());
+		invalidate_state_cache();
+		return !handler->get_handler()->Call(get_context()->Global(), 0, NULL).IsEmpty();
 	}
 
 	v8::Isolate *QueryScript::get_isolate()
@@ -106,6 +581,11 @@ namespace js1
 		v8::Handle<v8::String> name(args[0].As<v8::String>());
 		v8::Handle<v8::Function> handler(args[1].As<v8::Function>());
 		EventHandler *event_handler = new EventHandler(name, handler);
+		const std::string &handler_name = event_handler->get_name();
+		event_handler->set_read_only(
+			handler_name == "get_state" || handler_name == "get_statistics" || handler_name == "get_sources" || handler_name == "get_state_object");
+		if (handler_name == "get_state")
+			get_state_handler = event_handler;
 		registred_handlers.push_back(event_handler);
 		v8::String::Value uname(name);
 		this->register_command_handler_callback(*uname, event_handler);
@@ -132,6 +612,9 @@ namespace js1
 		v8::String::Value name_value(name);
 		v8::String::Value body_value(body);
 
+		TraceSpan trace_span("notify", "js1.callback", this);
+		if (trace_span.is_enabled())
+			trace_span.set_argument("command", utf16_to_utf8(*name_value));
 		this->reverse_command_callback(*name_value, *body_value);
 
 		return v8::Undefined();
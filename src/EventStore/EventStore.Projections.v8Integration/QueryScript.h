@@ -2,10 +2,16 @@
 #include "js1.h"
 #include "CompiledScript.h"
 #include "PreludeScript.h"
+#include "StateDelta.h"
+#include "PartitionStore.h"
 
 namespace js1 {
 
 	class EventHandler;
+	class JsonWriter;
+	class ChunkSink;
+	class StateLoader;
+	class ExecuteResult;
 	class QueryScript;
 	class PreludeScript;
 
@@ -20,7 +26,10 @@ namespace js1 {
 			isolate(v8::Isolate::GetCurrent()),
 			prelude(prelude_), 
 			register_command_handler_callback(register_command_handler_callback_),
-			reverse_command_callback(reverse_command_callback_)
+			reverse_command_callback(reverse_command_callback_),
+			state_loader(NULL),
+			get_state_handler(NULL),
+			cached_state(NULL)
 
 		{
 			isolate_add_ref(isolate);
@@ -30,7 +39,32 @@ namespace js1 {
 
 		bool compile_script(const uint16_t *query_source, const uint16_t *file_name);
 		v8::Handle<v8::Value> run();
-		v8::Persistent<v8::String> execute_handler(void* event_handler_handle, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length);
+		ExecuteResult *execute_handler(void* event_handler_handle, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length);
+		// returns a new reference to the cached get_state result or NULL, does not require the isolate
+		ExecuteResult *get_cached_result(void *event_handler_handle);
+		void write_handler_statistics(JsonWriter &writer);
+		void reset_handler_statistics();
+
+		bool get_state_at(const uint16_t *path, std::string &json);
+
+		bool get_state_delta(bool full, int32_t full_snapshot_every, std::string &delta);
+		bool apply_state_delta(const uint16_t *delta_json);
+
+		bool write_state(ChunkSink &sink, size_t chunk_size);
+		void begin_state_load();
+		bool append_state_chunk(const char *data, size_t length);
+		bool end_state_load();
+
+		bool export_state(ChunkSink &sink, size_t chunk_size);
+		bool import_state(const char *data, size_t length);
+
+		bool configure_partition_store(size_t max_materialized, uint64_t max_resident_bytes, const std::string &spill_file_name);
+		int32_t select_partition(const uint16_t *partition);
+		void clear_partition_store();
+		void write_partition_store_statistics(JsonWriter &writer);
+		// all partitions as one JSON object, and loading those of the given shard back from it
+		bool write_partitions(ChunkSink &sink);
+		bool load_partitions(const uint16_t *partitions_json, uint32_t shard, uint32_t shard_count);
 
 	protected:
 		virtual v8::Isolate *get_isolate();
@@ -43,6 +77,21 @@ namespace js1 {
 		REVERSE_COMMAND_CALLBACK reverse_command_callback;
 
 		PreludeScript *prelude;
+		StateDelta state_delta;
+		StateLoader *state_loader;
+		PartitionStore partition_store;
+		EventHandler *get_state_handler;
+		ExecuteResult *cached_state;
+
+		void invalidate_state_cache();
+
+		EventHandler *find_handler(const char *name);
+		// the state accessors must be called within a handle scope, the query context and a try catch
+		v8::Handle<v8::Value> get_state_object();
+		// revive restores the native objects of a state rebuilt from its serialized form
+		bool set_state_object(v8::Handle<v8::Value> state, bool revive);
+		// replaces the state with the one returned by $init
+		bool initialize_state();
 
 		v8::Handle<v8::Value> on(const v8::Arguments& args);
 		v8::Handle<v8::Value> notify(const v8::Arguments& args);
@@ -0,0 +1,506 @@
+#include "stdafx.h"
+#include "ShardedQuery.h"
+#include "PreludeScope.h"
+#include "PreludeScript.h"
+#include "QueryScript.h"
+#include "ModuleScript.h"
+#include "ExecuteResult.h"
+#include "PartitionStore.h"
+#include "StateSerializer.h"
+#include "JsonWriter.h"
+#include "encoding.h"
+#include "defines.h"
+
+namespace js1 
+{
+	namespace 
+	{
+		THREADSTATIC void *current_shard = NULL;
+		THREADSTATIC std::string *reported_error = NULL;
+
+		// shards create and compile, and later dispose, their isolates one at a time; the 
+		// isolate of the calling thread is not covered
+		platform::Mutex isolate_lock;
+
+		void STDCALL capture_error(const int /*error_code*/, const uint16_t *error_message)
+		{
+			if (reported_error != NULL)
+				*reported_error = utf16_to_utf8(error_message);
+		}
+
+		// must be called within the isolate of the script
+		std::string capture_errors(CompiledScript *script)
+		{
+			std::string message;
+			reported_error = &message;
+			script->report_errors(capture_error);
+			reported_error = NULL;
+			return message;
+		}
+
+		void STDCALL ignore_command_handler(const uint16_t * /*event_name*/, void * /*handler_handle*/)
+		{
+		}
+
+		void STDCALL ignore_reverse_command(const uint16_t * /*command_name*/, const uint16_t * /*command_arguments*/)
+		{
+		}
+
+		void copy_string(const uint16_t *value, std::vector<uint16_t> &target)
+		{
+			target.assign(value, value + utf16_length(value) + 1);
+		}
+	}
+
+	class ShardedQuery::Shard 
+	{
+	public:
+		Shard(ShardedQuery *owner_, uint32_t index_) : 
+			owner(owner_), index(index_), prelude(NULL), query(NULL), start_completion(NULL), processed(0), max_queued(0)
+		{
+		}
+
+		bool start(Completion *completion)
+		{
+			start_completion = completion;
+			return thread.start(thread_main, this);
+		}
+
+		void stop()
+		{
+			if (!thread.is_started())
+				return;
+			Command *command = new Command();
+			command->type = STOP;
+			command->completion = NULL;
+			enqueue(command);
+			thread.join();
+		}
+
+		// blocks while the queue is full
+		void enqueue(Command *command)
+		{
+			platform::ScopedLock guard(lock);
+			while (queue.size() >= QUEUE_CAPACITY)
+				not_full.wait(lock);
+			queue.push_back(command);
+			if (queue.size() > max_queued)
+				max_queued = queue.size();
+			not_empty.notify_one();
+		}
+
+		void write_statistics(JsonWriter &writer)
+		{
+			platform::ScopedLock guard(lock);
+			writer.begin_object();
+			writer.member("processed", static_cast<uint64_t>(processed));
+			writer.member("queued", static_cast<uint64_t>(queue.size()));
+			writer.member("max_queued", static_cast<uint64_t>(max_queued));
+			writer.end_object();
+		}
+
+	private:
+		ShardedQuery *owner;
+		uint32_t index;
+		platform::Thread thread;
+		platform::Mutex lock;
+		platform::ConditionVariable not_empty;
+		platform::ConditionVariable not_full;
+		std::deque<Command *> queue;
+
+		PreludeScript *prelude;
+		QueryScript *query;
+		std::vector<ModuleScript *> modules;
+		std::map<std::string, void *> handlers;
+		Completion *start_completion;
+
+		volatile uint64_t processed;
+		size_t max_queued;
+
+		static Shard *current()
+		{
+			return reinterpret_cast<Shard *>(current_shard);
+		}
+
+		static void thread_main(void *argument)
+		{
+			reinterpret_cast<Shard *>(argument)->run();
+		}
+
+		void run()
+		{
+			current_shard = this;
+			compile();
+			complete(start_completion);
+
+			for (;;)
+			{
+				Command *command = pop();
+				if (command->type == STOP)
+				{
+					delete command;
+					break;
+				}
+				if (query != NULL && !owner->has_failed())
+					execute(command);
+				if (command->completion != NULL)
+					complete(command->completion);
+				else
+					delete command;
+			}
+			dispose();
+			current_shard = NULL;
+		}
+
+		Command *pop()
+		{
+			platform::ScopedLock guard(lock);
+			while (queue.empty())
+				not_empty.wait(lock);
+			Command *command = queue.front();
+			queue.pop_front();
+			not_full.notify_one();
+			return command;
+		}
+
+		void compile()
+		{
+			platform::ScopedLock guard(isolate_lock);
+			const PreludeScript::Source &source = owner->prelude->get_source();
+			prelude = new PreludeScript(load_module, owner->prelude->get_log_handler());
+			std::string message;
+			{
+				PreludeScope prelude_scope(prelude);
+				v8::HandleScope scope;
+				if (prelude->compile_script(&source.source[0], &source.file_name[0]))
+					prelude->run();
+				message = capture_errors(prelude);
+			}
+			if (message.empty())
+			{
+				PreludeScope prelude_scope(prelude);
+				v8::HandleScope scope;
+				query = new QueryScript(prelude, register_command_handler, reverse_command);
+				if (query->compile_script(&owner->script[0], &owner->file_name[0]))
+					query->run();
+				message = capture_errors(query);
+			}
+			if (!message.empty())
+				fail(message);
+		}
+
+		void execute(Command *command)
+		{
+			PreludeScope prelude_scope(query);
+			switch (command->type)
+			{
+			case PROCESS_EVENT:
+				{
+					const uint16_t *data_other[9];
+					int32_t other_length = static_cast<int32_t>(command->arguments.size()) - 2;
+					for (int32_t i = 0; i < other_length; i++)
+						data_other[i] = &command->arguments[2 + i][0];
+
+					// a new partition is initialized by select_partition
+					if (query->select_partition(&command->arguments[0][0]) < 0)
+						fail(capture_errors(query));
+					else if (execute_handler("process_event", &command->arguments[1][0], data_other, other_length))
+						platform::atomic_increment(&processed);
+				}
+				break;
+			case INITIALIZE:
+				query->clear_partition_store();
+				break;
+			case GET_STATE:
+				{
+					StringChunkSink sink(command->result);
+					if (!query->write_partitions(sink))
+						fail(capture_errors(query));
+				}
+				break;
+			case SET_STATE:
+				query->clear_partition_store();
+				if (!query->load_partitions(&command->arguments[0][0], index, static_cast<uint32_t>(owner->shards.size())))
+					fail(capture_errors(query));
+				break;
+			default:
+				break;
+			}
+		}
+
+		bool execute_handler(const char *name, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length)
+		{
+			std::map<std::string, void *>::iterator it = handlers.find(name);
+			if (it == handlers.end())
+			{
+				fail(std::string("'") + name + "' command handler has not been registered");
+				return false;
+			}
+			ExecuteResult *result = query->execute_handler(it->second, data_json, data_other, other_length);
+			if (result == NULL)
+			{
+				fail(capture_errors(query));
+				return false;
+			}
+			result->release();
+			return true;
+		}
+
+		void fail(const std::string &message)
+		{
+			char prefix[32];
+			sprintf(prefix, "Shard %u: ", index);
+			owner->fail(prefix + (message.empty() ? std::string("Unknown error") : message));
+		}
+
+		void dispose()
+		{
+			platform::ScopedLock guard(isolate_lock);
+			if (query != NULL)
+			{
+				PreludeScope prelude_scope(query);
+				delete query;
+			}
+			for (size_t i = 0; i < modules.size(); i++)
+			{
+				PreludeScope prelude_scope(modules[i]);
+				delete modules[i];
+			}
+			if (prelude != NULL)
+			{
+				PreludeScope prelude_scope(prelude);
+				delete prelude;
+			}
+		}
+
+		static void complete(Completion *completion)
+		{
+			platform::ScopedLock guard(completion->lock);
+			if (--completion->remaining == 0)
+				completion->completed.notify_all();
+		}
+
+		// modules are compiled from the sources recorded by the prelude of the calling thread
+		static void * STDCALL load_module(const uint16_t *module_name)
+		{
+			Shard *shard = current();
+			const PreludeScript::Source *source = shard->owner->prelude->find_module_source(utf16_to_utf8(module_name));
+			if (source == NULL)
+				return NULL;
+			v8::HandleScope scope;
+			ModuleScript *module = new ModuleScript(shard->prelude);
+			if (module->compile_script(&source->source[0], &source->file_name[0]))
+				module->run();
+			shard->modules.push_back(module);
+			return module;
+		}
+
+		static void STDCALL register_command_handler(const uint16_t *event_name, void *handler_handle)
+		{
+			current()->handlers[utf16_to_utf8(event_name)] = handler_handle;
+		}
+
+		static void STDCALL reverse_command(const uint16_t *command_name, const uint16_t *command_arguments)
+		{
+			ShardedQuery *owner = current()->owner;
+			platform::ScopedLock guard(owner->callback_lock);
+			owner->reverse_command_callback(command_name, command_arguments);
+		}
+
+		Shard(const Shard &);
+		Shard& operator=(const Shard &);
+	};
+
+	ShardedQuery::ShardedQuery(PreludeScript *prelude_, REVERSE_COMMAND_CALLBACK reverse_command_callback_) : 
+		prelude(prelude_), reverse_command_callback(reverse_command_callback_), failed(false)
+	{
+	}
+
+	ShardedQuery::~ShardedQuery()
+	{
+		stop();
+	}
+
+	bool ShardedQuery::start(const uint16_t *script_source, const uint16_t *script_file_name, int32_t shard_count)
+	{
+		if (shard_count < 1)
+		{
+			fail("At least one shard is required");
+			return false;
+		}
+		copy_string(script_source, script);
+		copy_string(script_file_name, file_name);
+		if (!compile_on_calling_thread())
+			return false;
+
+		Completion completion;
+		completion.remaining = static_cast<size_t>(shard_count);
+		for (int32_t i = 0; i < shard_count; i++)
+		{
+			Shard *shard = new Shard(this, static_cast<uint32_t>(i));
+			shards.push_back(shard);
+			if (!shard->start(&completion))
+			{
+				fail("Cannot start a shard thread");
+				platform::ScopedLock guard(completion.lock);
+				completion.remaining--;
+			}
+		}
+		platform::ScopedLock guard(completion.lock);
+		while (completion.remaining > 0)
+			completion.completed.wait(completion.lock);
+		return !has_failed();
+	}
+
+	bool ShardedQuery::process_event(const uint16_t *partition, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length)
+	{
+		if (shards.empty() || has_failed())
+			return false;
+		if (other_length < 0 || other_length > 9)
+		{
+			fail("Too many event arguments");
+			return false;
+		}
+
+		Command *command = new Command();
+		command->type = PROCESS_EVENT;
+		command->completion = NULL;
+		command->arguments.resize(2 + other_length);
+		copy_string(partition, command->arguments[0]);
+		copy_string(data_json, command->arguments[1]);
+		for (int32_t i = 0; i < other_length; i++)
+			copy_string(data_other[i], command->arguments[2 + i]);
+
+		uint32_t shard = PartitionStore::shard_of(utf16_to_utf8(partition), static_cast<uint32_t>(shards.size()));
+		shards[shard]->enqueue(command);
+		return true;
+	}
+
+	bool ShardedQuery::initialize()
+	{
+		std::vector<Command> commands;
+		return broadcast(INITIALIZE, NULL, commands);
+	}
+
+	bool ShardedQuery::get_state(std::string &json)
+	{
+		std::vector<Command> commands;
+		if (!broadcast(GET_STATE, NULL, commands))
+			return false;
+
+		// shards own disjoint partitions, so their objects are merged by concatenating the members
+		json = "{";
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			const std::string &result = commands[i].result;
+			if (result.size() <= 2)
+				continue;
+			if (json.size() > 1)
+				json.push_back(',');
+			json.append(result, 1, result.size() - 2);
+		}
+		json.push_back('}');
+		return true;
+	}
+
+	bool ShardedQuery::set_state(const uint16_t *state_json)
+	{
+		std::vector<Command> commands;
+		return broadcast(SET_STATE, state_json, commands);
+	}
+
+	void ShardedQuery::report_errors(REPORT_ERROR_CALLBACK report_error_callback)
+	{
+		std::string message;
+		{
+			platform::ScopedLock guard(lock);
+			if (!failed)
+				return;
+			message = error;
+		}
+		report_error_callback(1, &utf8_to_utf16(message)[0]);
+	}
+
+	void ShardedQuery::write_statistics(JsonWriter &writer)
+	{
+		writer.begin_object();
+		writer.member("shards", static_cast<uint64_t>(shards.size()));
+		writer.key("shard_statistics");
+		writer.begin_array();
+		for (size_t i = 0; i < shards.size(); i++)
+			shards[i]->write_statistics(writer);
+		writer.end_array();
+		writer.end_object();
+	}
+
+	void ShardedQuery::fail(const std::string &message)
+	{
+		platform::ScopedLock guard(lock);
+		if (failed)
+			return;
+		error = message;
+		failed = true;
+	}
+
+	bool ShardedQuery::has_failed()
+	{
+		return failed;
+	}
+
+	bool ShardedQuery::broadcast(CommandType type, const uint16_t *argument, std::vector<Command> &commands)
+	{
+		if (shards.empty() || has_failed())
+			return false;
+
+		Completion completion;
+		completion.remaining = shards.size();
+		commands.resize(shards.size());
+		for (size_t i = 0; i < shards.size(); i++)
+		{
+			commands[i].type = type;
+			commands[i].completion = &completion;
+			if (argument != NULL)
+			{
+				commands[i].arguments.resize(1);
+				copy_string(argument, commands[i].arguments[0]);
+			}
+			shards[i]->enqueue(&commands[i]);
+		}
+
+		platform::ScopedLock guard(completion.lock);
+		while (completion.remaining > 0)
+			completion.completed.wait(completion.lock);
+		return !has_failed();
+	}
+
+	bool ShardedQuery::compile_on_calling_thread()
+	{
+		std::string message;
+		{
+			PreludeScope prelude_scope(prelude);
+			v8::HandleScope scope;
+			QueryScript *query = new QueryScript(prelude, ignore_command_handler, ignore_reverse_command);
+			if (query->compile_script(&script[0], &file_name[0]))
+				query->run();
+			message = capture_errors(query);
+			delete query;
+		}
+		if (!message.empty())
+		{
+			fail(message);
+			return false;
+		}
+		return true;
+	}
+
+	void ShardedQuery::stop()
+	{
+		for (size_t i = 0; i < shards.size(); i++)
+		{
+			shards[i]->stop();
+			delete shards[i];
+		}
+		shards.clear();
+	}
+
+}
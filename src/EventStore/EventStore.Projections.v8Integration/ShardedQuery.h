@@ -0,0 +1,96 @@
+#pragma once
+#include "js1.h"
+#include "platform.h"
+
+#include <deque>
+
+namespace js1 
+{
+	class PreludeScript;
+	class QueryScript;
+	class ModuleScript;
+	class JsonWriter;
+
+	// Runs a by-stream query on several isolates, each of them owned by its own thread.  
+	//
+	// Events are routed to shards by the hash of their partition, so the events of one 
+	// partition are processed in order by the same shard, which keeps the partition 
+	// states in its PartitionStore.  The state of the query is the union of the shard 
+	// states as one JSON object keyed by partition.  process_event only queues the event; 
+	// initialize, get_state and set_state wait for all the queued events to be processed.
+	//
+	// The query is compiled once on the calling thread first, which reports compilation 
+	// errors and loads the modules the shards then compile from the sources recorded by 
+	// the prelude.  Reverse commands are delivered on the shard threads one at a time and 
+	// must not call the methods which wait for the shards; $log messages are delivered on 
+	// the shard threads unless asynchronous logging is on.
+	// The first error of any shard stops the processing and is reported by report_errors.
+	class ShardedQuery 
+	{
+	public:
+		ShardedQuery(PreludeScript *prelude_, REVERSE_COMMAND_CALLBACK reverse_command_callback_);
+		~ShardedQuery();
+
+		bool start(const uint16_t *script, const uint16_t *file_name, int32_t shard_count);
+		bool process_event(const uint16_t *partition, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length);
+		bool initialize();
+		bool get_state(std::string &json);
+		bool set_state(const uint16_t *state_json);
+		void report_errors(REPORT_ERROR_CALLBACK report_error_callback);
+		void write_statistics(JsonWriter &writer);
+
+	private:
+		enum CommandType 
+		{
+			PROCESS_EVENT,
+			INITIALIZE,
+			GET_STATE,
+			SET_STATE,
+			STOP
+		};
+
+		struct Completion 
+		{
+			platform::Mutex lock;
+			platform::ConditionVariable completed;
+			size_t remaining;
+		};
+
+		// arguments of PROCESS_EVENT are the partition, the event data and the other data
+		struct Command 
+		{
+			CommandType type;
+			std::vector<std::vector<uint16_t> > arguments;
+			std::string result;
+			Completion *completion;
+		};
+
+		class Shard;
+		friend class Shard;
+
+		static const size_t QUEUE_CAPACITY = 4096;
+
+		PreludeScript *prelude;
+		REVERSE_COMMAND_CALLBACK reverse_command_callback;
+		std::vector<Shard *> shards;
+		std::vector<uint16_t> script;
+		std::vector<uint16_t> file_name;
+
+		// guards error; the reverse command callback is serialized by callback_lock instead, so 
+		// that failing shards and report_errors do not wait for a running callback
+		platform::Mutex lock;
+		platform::Mutex callback_lock;
+		std::string error;
+		volatile bool failed;
+
+		void fail(const std::string &message);
+		bool has_failed();
+		bool broadcast(CommandType type, const uint16_t *argument, std::vector<Command> &commands);
+		bool compile_on_calling_thread();
+		void stop();
+
+		ShardedQuery(const ShardedQuery &);
+		ShardedQuery& operator=(const ShardedQuery &);
+	};
+
+}
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "StateDelta.h"
+#include "JsonWriter.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+	namespace 
+	{
+		uint64_t hash(const char *data, size_t length)
+		{
+			// FNV-1a
+			uint64_t result = 14695981039346656037ULL;
+			for (size_t i = 0; i < length; i++)
+			{
+				result ^= static_cast<unsigned char>(data[i]);
+				result *= 1099511628211ULL;
+			}
+			return result;
+		}
+
+		v8::Handle<v8::Function> json_function(const char *name)
+		{
+			v8::Handle<v8::Object> json = v8::Context::GetCurrent()->Global()->Get(v8::String::New("JSON")).As<v8::Object>();
+			return json->Get(v8::String::New(name)).As<v8::Function>();
+		}
+
+		bool is_plain_object(v8::Handle<v8::Value> value)
+		{
+			return value->IsObject() && !value->IsArray() && !value->IsFunction() && !value->IsDate();
+		}
+	}
+
+	bool StateDelta::write(v8::Handle<v8::Value> state, bool full, int32_t full_snapshot_every, std::string &delta)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::Function> stringify = json_function("stringify");
+		v8::Handle<v8::Object> global = v8::Context::GetCurrent()->Global();
+		bool plain_object = is_plain_object(state);
+		full = full || force_full || !plain_object || (full_snapshot_every > 0 && checkpoints_since_full + 1 >= full_snapshot_every);
+
+		JsonWriter writer;
+		writer.begin_object();
+		writer.member("full", full);
+		writer.member("sequence", sequence + 1);
+		if (!plain_object)
+		{
+			v8::Handle<v8::Value> argv[1] = { state };
+			v8::Handle<v8::Value> json = stringify->Call(global, 1, argv);
+			if (json.IsEmpty())
+				return false;
+			writer.key("state");
+			writer.raw_value(json->IsString() ? *v8::String::Utf8Value(json) : "null");
+			key_hashes.clear();
+		}
+		else
+		{
+			if (!full)
+			{
+				writer.member("previous", sequence);
+				writer.key("set");
+			}
+			else
+				writer.key("state");
+			writer.begin_object();
+
+			v8::Handle<v8::Object> object = state.As<v8::Object>();
+			v8::Handle<v8::Array> names = object->GetOwnPropertyNames();
+			std::map<std::string, uint64_t> hashes;
+			for (uint32_t i = 0; i < names->Length(); i++)
+			{
+				v8::HandleScope member_scope;
+				v8::Handle<v8::Value> name = names->Get(i);
+				v8::Handle<v8::Value> argv[1] = { object->Get(name) };
+				v8::Handle<v8::Value> json = stringify->Call(global, 1, argv);
+				if (json.IsEmpty())
+					return false;
+				// members which JSON.stringify omits (undefined, functions) are not part of the state
+				if (!json->IsString())
+					continue;
+
+				v8::String::Utf8Value key(name);
+				v8::String::Utf8Value value(json);
+				std::string key_string(*key, key.length());
+				uint64_t value_hash = hash(*value, value.length());
+				hashes[key_string] = value_hash;
+				std::map<std::string, uint64_t>::const_iterator previous = key_hashes.find(key_string);
+				if (full || previous == key_hashes.end() || previous->second != value_hash)
+				{
+					writer.key(key_string);
+					writer.raw_value(std::string(*value, value.length()));
+				}
+			}
+			writer.end_object();
+
+			if (!full)
+			{
+				writer.key("removed");
+				writer.begin_array();
+				for (std::map<std::string, uint64_t>::const_iterator it = key_hashes.begin(); it != key_hashes.end(); ++it)
+					if (hashes.find(it->first) == hashes.end())
+						writer.value(it->first);
+				writer.end_array();
+			}
+			key_hashes.swap(hashes);
+		}
+		writer.end_object();
+
+		sequence++;
+		checkpoints_since_full = full ? 0 : checkpoints_since_full + 1;
+		force_full = false;
+		delta = writer.str();
+		return true;
+	}
+
+	v8::Handle<v8::Value> StateDelta::apply(v8::Handle<v8::Value> current_state, const uint16_t *delta_json, std::string &error)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::Object> global = v8::Context::GetCurrent()->Global();
+		v8::Handle<v8::Value> argv[1] = { v8::String::New(delta_json) };
+		v8::Handle<v8::Value> parsed = json_function("parse")->Call(global, 1, argv);
+		if (parsed.IsEmpty())
+			return v8::Handle<v8::Value>();
+		if (!is_plain_object(parsed))
+		{
+			error = "State delta must be an object";
+			return v8::Handle<v8::Value>();
+		}
+
+		v8::Handle<v8::Object> delta = parsed.As<v8::Object>();
+		uint64_t delta_sequence = static_cast<uint64_t>(delta->Get(v8::String::New("sequence"))->IntegerValue());
+		v8::Handle<v8::Value> result;
+		if (delta->Get(v8::String::New("full"))->BooleanValue())
+			result = delta->Get(v8::String::New("state"));
+		else
+		{
+			uint64_t previous = static_cast<uint64_t>(delta->Get(v8::String::New("previous"))->IntegerValue());
+			if (applied_sequence == 0 || previous != applied_sequence)
+			{
+				char message[128];
+				sprintf(message, "State delta %llu does not follow the last applied state %llu", 
+					static_cast<unsigned long long>(delta_sequence), static_cast<unsigned long long>(applied_sequence));
+				error = message;
+				return v8::Handle<v8::Value>();
+			}
+
+			v8::Handle<v8::Object> target = is_plain_object(current_state) ? current_state.As<v8::Object>() : v8::Object::New();
+			v8::Handle<v8::Value> set = delta->Get(v8::String::New("set"));
+			if (set->IsObject())
+			{
+				v8::Handle<v8::Object> set_object = set.As<v8::Object>();
+				v8::Handle<v8::Array> names = set_object->GetOwnPropertyNames();
+				for (uint32_t i = 0; i < names->Length(); i++)
+				{
+					v8::Handle<v8::Value> name = names->Get(i);
+					target->Set(name, set_object->Get(name));
+				}
+			}
+			v8::Handle<v8::Value> removed = delta->Get(v8::String::New("removed"));
+			if (removed->IsArray())
+			{
+				v8::Handle<v8::Array> removed_array = removed.As<v8::Array>();
+				for (uint32_t i = 0; i < removed_array->Length(); i++)
+					target->Delete(removed_array->Get(i)->ToString());
+			}
+			result = target;
+		}
+
+		// the next checkpoint after recovery starts a new chain of deltas
+		applied_sequence = delta_sequence;
+		sequence = delta_sequence;
+		force_full = true;
+		key_hashes.clear();
+		return handle_scope.Close(result);
+	}
+
+}
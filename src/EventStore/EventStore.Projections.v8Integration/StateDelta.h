@@ -0,0 +1,45 @@
+#pragma once
+
+namespace js1 
+{
+
+	// Produces checkpoint deltas of a projection state against the previous checkpoint 
+	// and applies them back.  
+	//
+	// Top-level keys of an object state are serialized separately and compared by hash 
+	// with the previous checkpoint.  A delta is written as
+	//   {"full":false,"sequence":n,"previous":n-1,"set":{"key":value,...},"removed":["key",...]}
+	// and a full snapshot as
+	//   {"full":true,"sequence":n,"state":state}
+	// Full snapshots are written every full_snapshot_every checkpoints, after a delta has 
+	// been applied and for states which are not plain objects.  Recovery applies the last 
+	// full snapshot followed by the deltas with consecutive sequence numbers.
+	//
+	// The previous checkpoint is assumed to be stored once write returns; if it was not 
+	// the host must request a full snapshot.  All methods must be called within the 
+	// context of the query.
+	class StateDelta 
+	{
+	public:
+		StateDelta() : sequence(0), checkpoints_since_full(0), applied_sequence(0), force_full(true) 
+		{
+		}
+
+		// returns false if serialization threw, the exception is left in the caller's TryCatch
+		bool write(v8::Handle<v8::Value> state, bool full, int32_t full_snapshot_every, std::string &delta);
+
+		// returns the new state or an empty handle with error set if the delta cannot be applied
+		v8::Handle<v8::Value> apply(v8::Handle<v8::Value> current_state, const uint16_t *delta_json, std::string &error);
+
+	private:
+		std::map<std::string, uint64_t> key_hashes;
+		uint64_t sequence;
+		int32_t checkpoints_since_full;
+		uint64_t applied_sequence;
+		bool force_full;
+
+		StateDelta(const StateDelta &);
+		StateDelta& operator=(const StateDelta &);
+	};
+
+}
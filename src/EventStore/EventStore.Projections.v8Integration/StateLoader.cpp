@@ -0,0 +1,392 @@
+#include "stdafx.h"
+#include "StateLoader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace js1 
+{
+	namespace 
+	{
+		bool is_whitespace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+		}
+
+		int hex_value(char c)
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		}
+
+		bool is_digit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+		bool is_json_number(const std::string &token)
+		{
+			size_t i = 0;
+			size_t size = token.size();
+			if (i < size && token[i] == '-')
+				i++;
+			if (i < size && token[i] == '0')
+				i++;
+			else if (i < size && token[i] >= '1' && token[i] <= '9')
+				while (i < size && is_digit(token[i]))
+					i++;
+			else
+				return false;
+			if (i < size && token[i] == '.')
+			{
+				i++;
+				if (i == size || !is_digit(token[i]))
+					return false;
+				while (i < size && is_digit(token[i]))
+					i++;
+			}
+			if (i < size && (token[i] == 'e' || token[i] == 'E'))
+			{
+				i++;
+				if (i < size && (token[i] == '+' || token[i] == '-'))
+					i++;
+				if (i == size || !is_digit(token[i]))
+					return false;
+				while (i < size && is_digit(token[i]))
+					i++;
+			}
+			return i == size;
+		}
+	}
+
+	StateLoader::StateLoader() : 
+		state(EXPECT_VALUE), string_is_key(false), unicode_escape(0), unicode_digits(0), high_surrogate(0), offset(0)
+	{
+	}
+
+	StateLoader::~StateLoader()
+	{
+		for (size_t i = 0; i < stack.size(); i++)
+			stack[i].container.Dispose();
+		root.Dispose();
+	}
+
+	bool StateLoader::append(const char *data, size_t length)
+	{
+		if (!error.empty())
+			return false;
+		v8::HandleScope handle_scope;
+		for (size_t i = 0; i < length; )
+		{
+			bool consumed = true;
+			if (!process(data[i], consumed))
+				return false;
+			if (consumed)
+			{
+				i++;
+				offset++;
+			}
+		}
+		return true;
+	}
+
+	bool StateLoader::end(v8::Handle<v8::Value> &result)
+	{
+		if (!error.empty())
+			return false;
+		// a number or literal at the root is only terminated by the end of the text
+		if (stack.empty() && state == IN_NUMBER && !complete_number())
+			return false;
+		if (stack.empty() && state == IN_LITERAL && !complete_literal())
+			return false;
+		if (state != EXPECT_END)
+			return fail("Unexpected end of state JSON");
+		result = v8::Local<v8::Value>::New(root);
+		return true;
+	}
+
+	bool StateLoader::process(char c, bool &consumed)
+	{
+		switch (state)
+		{
+		case IN_STRING:
+			if (c == '"')
+				return complete_string();
+			if (c == '\\')
+				state = IN_STRING_ESCAPE;
+			else if (static_cast<unsigned char>(c) < 0x20)
+				return fail("Control character in string");
+			else
+			{
+				flush_high_surrogate();
+				token.push_back(c);
+			}
+			return true;
+
+		case IN_STRING_ESCAPE:
+			state = IN_STRING;
+			if (c == 'u')
+			{
+				state = IN_STRING_UNICODE;
+				unicode_escape = 0;
+				unicode_digits = 0;
+				return true;
+			}
+			flush_high_surrogate();
+			switch (c)
+			{
+			case '"': token.push_back('"'); break;
+			case '\\': token.push_back('\\'); break;
+			case '/': token.push_back('/'); break;
+			case 'b': token.push_back('\b'); break;
+			case 'f': token.push_back('\f'); break;
+			case 'n': token.push_back('\n'); break;
+			case 'r': token.push_back('\r'); break;
+			case 't': token.push_back('\t'); break;
+			default: return fail("Invalid escape sequence");
+			}
+			return true;
+
+		case IN_STRING_UNICODE:
+			{
+				int digit = hex_value(c);
+				if (digit < 0)
+					return fail("Invalid unicode escape sequence");
+				unicode_escape = (unicode_escape << 4) | digit;
+				if (++unicode_digits == 4)
+				{
+					append_code_point(unicode_escape);
+					state = IN_STRING;
+				}
+				return true;
+			}
+
+		case IN_NUMBER:
+			if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+			{
+				token.push_back(c);
+				return true;
+			}
+			consumed = false;
+			return complete_number();
+
+		case IN_LITERAL:
+			if (c >= 'a' && c <= 'z')
+			{
+				token.push_back(c);
+				return true;
+			}
+			consumed = false;
+			return complete_literal();
+
+		default:
+			break;
+		}
+
+		if (is_whitespace(c))
+			return true;
+
+		switch (state)
+		{
+		case EXPECT_VALUE:
+		case EXPECT_VALUE_OR_ARRAY_END:
+			if (c == ']' && state == EXPECT_VALUE_OR_ARRAY_END)
+				return end_container(true);
+			token.clear();
+			if (c == '"')
+			{
+				state = IN_STRING;
+				string_is_key = false;
+				high_surrogate = 0;
+				return true;
+			}
+			if (c == '{')
+				return begin_container(false);
+			if (c == '[')
+				return begin_container(true);
+			if (c == '-' || (c >= '0' && c <= '9'))
+			{
+				state = IN_NUMBER;
+				token.push_back(c);
+				return true;
+			}
+			if (c >= 'a' && c <= 'z')
+			{
+				state = IN_LITERAL;
+				token.push_back(c);
+				return true;
+			}
+			return fail("Unexpected character");
+
+		case EXPECT_KEY:
+		case EXPECT_KEY_OR_OBJECT_END:
+			if (c == '}' && state == EXPECT_KEY_OR_OBJECT_END)
+				return end_container(false);
+			if (c != '"')
+				return fail("Expected a property name");
+			token.clear();
+			state = IN_STRING;
+			string_is_key = true;
+			high_surrogate = 0;
+			return true;
+
+		case EXPECT_COLON:
+			if (c != ':')
+				return fail("Expected ':'");
+			state = EXPECT_VALUE;
+			return true;
+
+		case EXPECT_SEPARATOR:
+			if (c == ',')
+			{
+				state = stack.back().is_array ? EXPECT_VALUE : EXPECT_KEY;
+				return true;
+			}
+			if (c == ']' || c == '}')
+				return end_container(c == ']');
+			return fail("Expected ',' or the end of the container");
+
+		default:
+			return fail("Unexpected data after the end of state JSON");
+		}
+	}
+
+	void StateLoader::flush_high_surrogate()
+	{
+		// a high surrogate which is not followed by a low one
+		if (high_surrogate == 0)
+			return;
+		high_surrogate = 0;
+		append_code_point(0xFFFD);
+	}
+
+	void StateLoader::append_code_point(uint32_t code_point)
+	{
+		if (code_point >= 0xD800 && code_point < 0xDC00)
+		{
+			flush_high_surrogate();
+			high_surrogate = code_point;
+			return;
+		}
+		if (code_point >= 0xDC00 && code_point < 0xE000)
+		{
+			code_point = high_surrogate == 0 ? 0xFFFD : 0x10000 + ((high_surrogate - 0xD800) << 10) + (code_point - 0xDC00);
+			high_surrogate = 0;
+		}
+		else
+			flush_high_surrogate();
+
+		if (code_point < 0x80)
+			token.push_back(static_cast<char>(code_point));
+		else if (code_point < 0x800)
+		{
+			token.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+			token.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+		else if (code_point < 0x10000)
+		{
+			token.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+			token.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+			token.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+		else
+		{
+			token.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+			token.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+			token.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+			token.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+	}
+
+	bool StateLoader::complete_string()
+	{
+		flush_high_surrogate();
+		if (string_is_key)
+		{
+			stack.back().key.swap(token);
+			token.clear();
+			state = EXPECT_COLON;
+			return true;
+		}
+		return complete_value(v8::String::New(token.data(), static_cast<int>(token.size())));
+	}
+
+	bool StateLoader::complete_number()
+	{
+		if (!is_json_number(token))
+			return fail("Invalid number");
+		return complete_value(v8::Number::New(strtod(token.c_str(), NULL)));
+	}
+
+	bool StateLoader::complete_literal()
+	{
+		if (token == "true")
+			return complete_value(v8::True());
+		if (token == "false")
+			return complete_value(v8::False());
+		if (token == "null")
+			return complete_value(v8::Null());
+		return fail("Invalid literal");
+	}
+
+	bool StateLoader::complete_value(v8::Handle<v8::Value> value)
+	{
+		token.clear();
+		if (stack.empty())
+		{
+			root.Dispose();
+			root = v8::Persistent<v8::Value>::New(value);
+			state = EXPECT_END;
+			return true;
+		}
+		Frame &frame = stack.back();
+		if (frame.is_array)
+			frame.container->Set(frame.length++, value);
+		else
+			// ForceSet defines an own property the way JSON.parse does, so "__proto__" does not replace the prototype
+			frame.container->ForceSet(v8::String::New(frame.key.data(), static_cast<int>(frame.key.size())), value);
+		state = EXPECT_SEPARATOR;
+		return true;
+	}
+
+	bool StateLoader::begin_container(bool is_array)
+	{
+		if (stack.size() >= static_cast<size_t>(MAX_DEPTH))
+			return fail("State JSON is nested too deeply");
+		v8::Handle<v8::Object> container;
+		if (is_array)
+			container = v8::Array::New();
+		else
+			container = v8::Object::New();
+		stack.push_back(Frame());
+		Frame &frame = stack.back();
+		frame.container = v8::Persistent<v8::Object>::New(container);
+		frame.is_array = is_array;
+		frame.length = 0;
+		state = is_array ? EXPECT_VALUE_OR_ARRAY_END : EXPECT_KEY_OR_OBJECT_END;
+		return true;
+	}
+
+	bool StateLoader::end_container(bool is_array)
+	{
+		Frame &frame = stack.back();
+		if (frame.is_array != is_array)
+			return fail("Mismatched container end");
+		v8::Handle<v8::Object> container = v8::Local<v8::Object>::New(frame.container);
+		frame.container.Dispose();
+		stack.pop_back();
+		return complete_value(container);
+	}
+
+	bool StateLoader::fail(const char *message)
+	{
+		char position[64];
+		sprintf(position, " at byte %llu", static_cast<unsigned long long>(offset));
+		error = std::string(message) + position;
+		return false;
+	}
+
+}
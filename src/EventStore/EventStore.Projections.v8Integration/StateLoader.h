@@ -0,0 +1,80 @@
+#pragma once
+
+namespace js1 
+{
+
+	// Incremental JSON parser which builds V8 values from UTF-8 chunks as they arrive, so 
+	// that a state can be restored without holding its whole JSON text in memory.  
+	// Containers under construction are kept in persistent handles between chunks.  
+	// append and end must be called within the context the state belongs to.
+	class StateLoader 
+	{
+	public:
+		StateLoader();
+		~StateLoader();
+
+		// returns false on a syntax error, after which the loader must be discarded
+		bool append(const char *data, size_t length);
+
+		// returns false if the JSON text is incomplete, the result is created in the caller's handle scope
+		bool end(v8::Handle<v8::Value> &result);
+
+		const std::string &get_error() const
+		{
+			return error;
+		}
+
+	private:
+		enum State 
+		{
+			EXPECT_VALUE,
+			EXPECT_VALUE_OR_ARRAY_END,
+			EXPECT_KEY,
+			EXPECT_KEY_OR_OBJECT_END,
+			EXPECT_COLON,
+			EXPECT_SEPARATOR,
+			EXPECT_END,
+			IN_STRING,
+			IN_STRING_ESCAPE,
+			IN_STRING_UNICODE,
+			IN_NUMBER,
+			IN_LITERAL
+		};
+
+		struct Frame 
+		{
+			v8::Persistent<v8::Object> container;
+			bool is_array;
+			uint32_t length;
+			std::string key;
+		};
+
+		static const int MAX_DEPTH = 4096;
+
+		State state;
+		bool string_is_key;
+		std::string token;
+		uint32_t unicode_escape;
+		int unicode_digits;
+		uint32_t high_surrogate;
+		std::vector<Frame> stack;
+		v8::Persistent<v8::Value> root;
+		uint64_t offset;
+		std::string error;
+
+		bool process(char c, bool &consumed);
+		bool complete_value(v8::Handle<v8::Value> value);
+		bool complete_string();
+		bool complete_number();
+		bool complete_literal();
+		bool begin_container(bool is_array);
+		bool end_container(bool is_array);
+		void append_code_point(uint32_t code_point);
+		void flush_high_surrogate();
+		bool fail(const char *message);
+
+		StateLoader(const StateLoader &);
+		StateLoader& operator=(const StateLoader &);
+	};
+
+}
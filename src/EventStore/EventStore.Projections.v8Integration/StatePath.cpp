@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "StatePath.h"
+#include "StateWalker.h"
+#include "encoding.h"
+
+namespace js1 
+{
+
+	bool StatePath::parse(const uint16_t *path)
+	{
+		text = utf16_to_utf8(path);
+		tokens.clear();
+		error.clear();
+		if (text.empty())
+			return true;
+		if (text[0] != '/')
+		{
+			tokens.push_back(text);
+			return true;
+		}
+
+		std::string token;
+		for (size_t i = 1; i <= text.size(); i++)
+		{
+			if (i == text.size() || text[i] == '/')
+			{
+				tokens.push_back(token);
+				token.clear();
+			}
+			else if (text[i] == '~')
+			{
+				if (i + 1 == text.size() || (text[i + 1] != '0' && text[i + 1] != '1'))
+				{
+					error = "Invalid escape in state path '" + text + "'";
+					return false;
+				}
+				token.push_back(text[++i] == '0' ? '~' : '/');
+			}
+			else
+				token.push_back(text[i]);
+		}
+		return true;
+	}
+
+	v8::Handle<v8::Value> StatePath::resolve(v8::Handle<v8::Value> state)
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::String> to_json_name = v8::String::NewSymbol("toJSON");
+		v8::Handle<v8::Value> value = StateWalker::to_json(state, v8::String::Empty(), to_json_name);
+		for (size_t i = 0; i < tokens.size() && !value.IsEmpty(); i++)
+		{
+			const std::string &token = tokens[i];
+			v8::Handle<v8::String> key = v8::String::New(token.data(), static_cast<int>(token.size()));
+			v8::Handle<v8::Value> member;
+			if (value->IsArray())
+			{
+				uint32_t index;
+				if (is_array_index(token, value.As<v8::Array>()->Length(), index))
+					member = value.As<v8::Array>()->Get(index);
+			}
+			else if (value->IsObject() && value.As<v8::Object>()->HasOwnProperty(key))
+				member = value.As<v8::Object>()->Get(key);
+
+			if (member.IsEmpty())
+			{
+				error = "State path '" + text + "' does not exist";
+				return v8::Handle<v8::Value>();
+			}
+			value = StateWalker::to_json(member, key, to_json_name);
+			// undefined and functions are not serialized, so they do not exist either
+			if (!value.IsEmpty() && !StateWalker::is_serializable(value))
+			{
+				error = "State path '" + text + "' does not exist";
+				return v8::Handle<v8::Value>();
+			}
+		}
+		if (value.IsEmpty())
+			return value;
+		return handle_scope.Close(value);
+	}
+
+	bool StatePath::is_array_index(const std::string &token, uint32_t length, uint32_t &index)
+	{
+		if (token.empty() || token.size() > 10 || (token.size() > 1 && token[0] == '0'))
+			return false;
+		uint64_t value = 0;
+		for (size_t i = 0; i < token.size(); i++)
+		{
+			if (token[i] < '0' || token[i] > '9')
+				return false;
+			value = value * 10 + (token[i] - '0');
+		}
+		if (value >= length)
+			return false;
+		index = static_cast<uint32_t>(value);
+		return true;
+	}
+
+}
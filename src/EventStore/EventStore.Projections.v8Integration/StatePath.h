@@ -0,0 +1,33 @@
+#pragma once
+
+namespace js1 
+{
+
+	// A path into a projection state.  A path starting with '/' is a JSON pointer 
+	// (RFC 6901, with the "~0" and "~1" escapes), anything else is a single top-level 
+	// key and the empty path refers to the whole state.  Values are resolved the way 
+	// they are serialized, so toJSON is applied to every object on the way.
+	class StatePath 
+	{
+	public:
+		// returns false with error set if the path is not a valid JSON pointer
+		bool parse(const uint16_t *path);
+
+		// must be called within a context, returns an empty handle if the path does not 
+		// exist or a toJSON threw (the exception is left in the caller's TryCatch)
+		v8::Handle<v8::Value> resolve(v8::Handle<v8::Value> state);
+
+		const std::string &get_error() const
+		{
+			return error;
+		}
+
+	private:
+		std::string text;
+		std::vector<std::string> tokens;
+		std::string error;
+
+		static bool is_array_index(const std::string &token, uint32_t length, uint32_t &index);
+	};
+
+}
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+#include "StateSerializer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+namespace js1 
+{
+
+	StateSerializer::StateSerializer(ChunkSink &sink_, size_t chunk_size_) : 
+		StateWalker("JSON"), sink(sink_), chunk_size(chunk_size_ > 0 ? chunk_size_ : 1)
+	{
+		buffer.reserve(chunk_size + 16);
+	}
+
+	bool StateSerializer::serialize(v8::Handle<v8::Value> value)
+	{
+		if (!walk(value))
+			return false;
+		if (!buffer.empty())
+			flush();
+		return !failed;
+	}
+
+	void StateSerializer::write_null()
+	{
+		append("null", 4);
+	}
+
+	void StateSerializer::write_boolean(bool value)
+	{
+		if (value)
+			append("true", 4);
+		else
+			append("false", 5);
+	}
+
+	void StateSerializer::begin_object()
+	{
+		append('{');
+	}
+
+	void StateSerializer::write_key(v8::Handle<v8::String> name, bool first)
+	{
+		if (!first)
+			append(',');
+		write_string(name);
+		append(':');
+	}
+
+	void StateSerializer::end_object()
+	{
+		append('}');
+	}
+
+	void StateSerializer::begin_array()
+	{
+		append('[');
+	}
+
+	void StateSerializer::begin_element(bool first)
+	{
+		if (!first)
+			append(',');
+	}
+
+	void StateSerializer::end_array()
+	{
+		append(']');
+	}
+
+	void StateSerializer::write_number(double number)
+	{
+		if (number != number || number - number != 0) // NaN or infinity
+		{
+			append("null", 4);
+			return;
+		}
+		char text[32];
+		if (number == floor(number) && fabs(number) < 9007199254740992.0) // exact integers
+		{
+			if (number == 0)
+				number = 0; // -0 is written as 0
+			sprintf(text, "%.0f", number);
+			append(text, strlen(text));
+			return;
+		}
+
+		// the shortest digits which read back as the same double; any decimal of up to 15 
+		// digits survives a round trip through a normal double, so shorter ones end in zeros 
+		// here, while denormals have fewer significant digits and are searched from one
+		for (int precision = fabs(number) < DBL_MIN ? 1 : 15; precision <= 17; precision++)
+		{
+			sprintf(text, "%.*e", precision - 1, number);
+			if (strtod(text, NULL) == number)
+				break;
+		}
+		const char *position = text;
+		if (*position == '-')
+		{
+			append('-');
+			position++;
+		}
+		char digits[20];
+		int count = 0;
+		for (; *position != 'e'; position++)
+			if (*position != '.')
+				digits[count++] = *position;
+		while (count > 1 && digits[count - 1] == '0')
+			count--;
+		// the value is 0.digits * 10^point
+		int point = atoi(position + 1) + 1;
+
+		// laid out as ECMAScript Number::toString does
+		if (count <= point && point <= 21)
+		{
+			append(digits, count);
+			for (int i = count; i < point; i++)
+				append('0');
+		}
+		else if (0 < point && point <= 21)
+		{
+			append(digits, point);
+			append('.');
+			append(digits + point, count - point);
+		}
+		else if (-6 < point && point <= 0)
+		{
+			append("0.", 2);
+			for (int i = point; i < 0; i++)
+				append('0');
+			append(digits, count);
+		}
+		else
+		{
+			append(digits[0]);
+			if (count > 1)
+			{
+				append('.');
+				append(digits + 1, count - 1);
+			}
+			sprintf(text, "e%c%d", point > 0 ? '+' : '-', abs(point - 1));
+			append(text, strlen(text));
+		}
+	}
+
+	void StateSerializer::write_string(v8::Handle<v8::String> string)
+	{
+		static const char hex[] = "0123456789abcdef";
+		uint16_t piece[STRING_PIECE];
+		int length = string->Length();
+		uint32_t high_surrogate = 0;
+		append('"');
+		for (int start = 0; start < length; start += STRING_PIECE)
+		{
+			int count = string->Write(piece, start, STRING_PIECE, v8::String::NO_NULL_TERMINATION);
+			for (int i = 0; i < count; i++)
+			{
+				uint32_t c = piece[i];
+				if (high_surrogate != 0)
+				{
+					if (c >= 0xDC00 && c < 0xE000)
+					{
+						uint32_t code_point = 0x10000 + ((high_surrogate - 0xD800) << 10) + (c - 0xDC00);
+						char utf8[4] = { 
+							static_cast<char>(0xF0 | (code_point >> 18)), static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)),
+							static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)), static_cast<char>(0x80 | (code_point & 0x3F)) };
+						append(utf8, 4);
+						high_surrogate = 0;
+						continue;
+					}
+					// a lone surrogate cannot be encoded in UTF-8
+					append("\xEF\xBF\xBD", 3);
+					high_surrogate = 0;
+				}
+
+				if (c == '"' || c == '\\')
+				{
+					char escaped[2] = { '\\', static_cast<char>(c) };
+					append(escaped, 2);
+				}
+				else if (c < 0x20)
+				{
+					switch (c)
+					{
+					case '\b': append("\\b", 2); break;
+					case '\f': append("\\f", 2); break;
+					case '\n': append("\\n", 2); break;
+					case '\r': append("\\r", 2); break;
+					case '\t': append("\\t", 2); break;
+					default:
+						{
+							char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+							append(escaped, 6);
+						}
+					}
+				}
+				else if (c < 0x80)
+					append(static_cast<char>(c));
+				else if (c < 0x800)
+				{
+					char utf8[2] = { static_cast<char>(0xC0 | (c >> 6)), static_cast<char>(0x80 | (c & 0x3F)) };
+					append(utf8, 2);
+				}
+				else if (c >= 0xD800 && c < 0xDC00)
+					high_surrogate = c;
+				else if (c >= 0xDC00 && c < 0xE000)
+					append("\xEF\xBF\xBD", 3);
+				else
+				{
+					char utf8[3] = { 
+						static_cast<char>(0xE0 | (c >> 12)), static_cast<char>(0x80 | ((c >> 6) & 0x3F)), static_cast<char>(0x80 | (c & 0x3F)) };
+					append(utf8, 3);
+				}
+			}
+		}
+		if (high_surrogate != 0)
+			append("\xEF\xBF\xBD", 3);
+		append('"');
+	}
+
+	void StateSerializer::flush()
+	{
+		if (!failed && !sink.write(buffer.data(), buffer.size()))
+			fail("State serialization has been aborted");
+		buffer.clear();
+	}
+
+}
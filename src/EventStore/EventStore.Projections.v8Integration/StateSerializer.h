@@ -0,0 +1,109 @@
+#pragma once
+#include "js1.h"
+#include "StateWalker.h"
+
+namespace js1 
+{
+
+	// Receives the output of StateSerializer; returning false aborts serialization
+	class ChunkSink 
+	{
+	public:
+		virtual ~ChunkSink() 
+		{
+		}
+		virtual bool write(const char *data, size_t length) = 0;
+	};
+
+	class StringChunkSink : public ChunkSink 
+	{
+	public:
+		StringChunkSink(std::string &output_) : output(output_) 
+		{
+		}
+
+		virtual bool write(const char *data, size_t length)
+		{
+			output.append(data, length);
+			return true;
+		}
+
+	private:
+		std::string &output;
+	};
+
+	class CallbackChunkSink : public ChunkSink 
+	{
+	public:
+		CallbackChunkSink(WRITE_CHUNK_CALLBACK callback_) : callback(callback_) 
+		{
+		}
+
+		virtual bool write(const char *data, size_t length)
+		{
+			return callback(reinterpret_cast<const uint8_t *>(data), static_cast<int32_t>(length));
+		}
+
+	private:
+		WRITE_CHUNK_CALLBACK callback;
+	};
+
+	// Serializes V8 values to UTF-8 JSON the way JSON.stringify does without 
+	// materializing the result as a V8 string.  Output is buffered and passed to the sink 
+	// in chunks of at most chunk_size bytes.  Must be called within a context.
+	class StateSerializer : private StateWalker 
+	{
+	public:
+		StateSerializer(ChunkSink &sink_, size_t chunk_size_);
+
+		// returns false if the sink aborted, a toJSON threw (the exception is left in 
+		// the caller's TryCatch) or the value cannot be serialized
+		bool serialize(v8::Handle<v8::Value> value);
+
+		using StateWalker::get_error;
+
+	private:
+		static const int STRING_PIECE = 4096;
+
+		ChunkSink &sink;
+		size_t chunk_size;
+		std::string buffer;
+
+		virtual void write_null();
+		virtual void write_boolean(bool value);
+		virtual void write_number(double number);
+		virtual void write_string(v8::Handle<v8::String> string);
+		virtual void begin_object();
+		virtual void write_key(v8::Handle<v8::String> name, bool first);
+		virtual void end_object();
+		virtual void begin_array();
+		virtual void begin_element(bool first);
+		virtual void end_array();
+
+		void append(char c)
+		{
+			buffer.push_back(c);
+			if (buffer.size() >= chunk_size)
+				flush();
+		}
+		void append(const char *data, size_t length)
+		{
+			while (length > 0)
+			{
+				size_t piece = chunk_size - buffer.size();
+				if (piece > length)
+					piece = length;
+				buffer.append(data, piece);
+				data += piece;
+				length -= piece;
+				if (buffer.size() >= chunk_size)
+					flush();
+			}
+		}
+		void flush();
+
+		StateSerializer(const StateSerializer &);
+		StateSerializer& operator=(const StateSerializer &);
+	};
+
+}
@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "StateWalker.h"
+
+namespace js1 
+{
+
+	v8::Handle<v8::Value> StateWalker::to_json(
+		v8::Handle<v8::Value> value, v8::Handle<v8::Value> key, v8::Handle<v8::String> to_json_name)
+	{
+		if (!value->IsObject())
+			return value;
+		v8::Handle<v8::Object> object = value.As<v8::Object>();
+		v8::Handle<v8::Value> to_json_function = object->Get(to_json_name);
+		if (!to_json_function->IsFunction())
+			return value;
+		v8::Handle<v8::Value> argv[1] = { key };
+		return to_json_function.As<v8::Function>()->Call(object, 1, argv);
+	}
+
+	bool StateWalker::walk(v8::Handle<v8::Value> value)
+	{
+		v8::HandleScope handle_scope;
+		to_json_name = v8::String::NewSymbol("toJSON");
+		value = to_json(value, v8::String::Empty(), to_json_name);
+		if (value.IsEmpty())
+			return false;
+		if (!is_serializable(value))
+			write_null();
+		else if (!walk_value(value))
+			return false;
+		return !failed;
+	}
+
+	bool StateWalker::walk_value(v8::Handle<v8::Value> value)
+	{
+		if (failed)
+			return false;
+		if (value->IsString() || value->IsStringObject())
+			write_string(value->ToString());
+		else if (value->IsNumber() || value->IsNumberObject())
+			write_number(value->NumberValue());
+		else if (value->IsBoolean())
+			write_boolean(value->BooleanValue());
+		else if (value->IsBooleanObject())
+			// any object is truthy, a Boolean object is written as the value it holds
+			write_boolean(v8::BooleanObject::Cast(*value)->BooleanValue());
+		else if (value->IsNull())
+			write_null();
+		else if (value->IsArray())
+			return walk_array(value.As<v8::Array>());
+		else if (value->IsObject())
+			return walk_object(value.As<v8::Object>());
+		return !failed;
+	}
+
+	bool StateWalker::walk_object(v8::Handle<v8::Object> object)
+	{
+		if (!enter(object))
+			return false;
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::Array> names = object->GetOwnPropertyNames();
+		begin_object();
+		bool first = true;
+		for (uint32_t i = 0; i < names->Length(); i++)
+		{
+			v8::HandleScope member_scope;
+			v8::Handle<v8::String> name = names->Get(i)->ToString();
+			v8::Handle<v8::Value> member = to_json(object->Get(name), name, to_json_name);
+			if (member.IsEmpty())
+				return false;
+			if (!is_serializable(member))
+				continue;
+			write_key(name, first);
+			first = false;
+			if (!walk_value(member))
+				return false;
+		}
+		end_object();
+		stack.pop_back();
+		return !failed;
+	}
+
+	bool StateWalker::walk_array(v8::Handle<v8::Array> array)
+	{
+		if (!enter(array))
+			return false;
+		v8::HandleScope handle_scope;
+		begin_array();
+		for (uint32_t i = 0; i < array->Length(); i++)
+		{
+			v8::HandleScope element_scope;
+			begin_element(i == 0);
+			v8::Handle<v8::Value> element = to_json(
+				array->Get(i), v8::Integer::NewFromUnsigned(i)->ToString(), to_json_name);
+			if (element.IsEmpty())
+				return false;
+			if (!is_serializable(element))
+				write_null();
+			else if (!walk_value(element))
+				return false;
+		}
+		end_array();
+		stack.pop_back();
+		return !failed;
+	}
+
+	bool StateWalker::enter(v8::Handle<v8::Object> object)
+	{
+		if (stack.size() >= static_cast<size_t>(MAX_DEPTH))
+		{
+			fail("State is nested too deeply to be serialized");
+			return false;
+		}
+		for (size_t i = 0; i < stack.size(); i++)
+			if (stack[i] == object)
+			{
+				fail(std::string("Converting circular structure to ") + format);
+				return false;
+			}
+		stack.push_back(object);
+		return true;
+	}
+
+}
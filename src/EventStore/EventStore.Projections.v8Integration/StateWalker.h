@@ -0,0 +1,82 @@
+#pragma once
+#include "js1.h"
+
+namespace js1 
+{
+
+	// Walks a V8 value with the JSON.stringify rules (toJSON is honoured, undefined and 
+	// functions are omitted from objects and written as null in arrays, circular and too 
+	// deeply nested structures are rejected) and passes what it finds to the output 
+	// methods of the derived class.  Must be called within a context.
+	class StateWalker 
+	{
+	public:
+		virtual ~StateWalker() 
+		{
+		}
+
+		const std::string &get_error() const
+		{
+			return error;
+		}
+
+		// calls toJSON(key) on value if it has one
+		static v8::Handle<v8::Value> to_json(
+			v8::Handle<v8::Value> value, v8::Handle<v8::Value> key, v8::Handle<v8::String> to_json_name);
+
+		// returns false for values JSON.stringify omits
+		static bool is_serializable(v8::Handle<v8::Value> value)
+		{
+			return !value->IsUndefined() && !value->IsFunction();
+		}
+
+	protected:
+		bool failed;
+
+		// format is used in the error reported for circular structures
+		explicit StateWalker(const char *format_) : failed(false), format(format_) 
+		{
+		}
+
+		// returns false if the output failed, a toJSON threw (the exception is left in 
+		// the caller's TryCatch) or the value cannot be serialized
+		bool walk(v8::Handle<v8::Value> value);
+
+		void fail(const std::string &message)
+		{
+			if (!failed)
+				error = message;
+			failed = true;
+		}
+
+		virtual void write_null() = 0;
+		virtual void write_boolean(bool value) = 0;
+		virtual void write_number(double value) = 0;
+		virtual void write_string(v8::Handle<v8::String> value) = 0;
+		virtual void begin_object() = 0;
+		// called before the value of every member which is written
+		virtual void write_key(v8::Handle<v8::String> name, bool first) = 0;
+		virtual void end_object() = 0;
+		virtual void begin_array() = 0;
+		// called before every element
+		virtual void begin_element(bool first) = 0;
+		virtual void end_array() = 0;
+
+	private:
+		static const int MAX_DEPTH = 4096;
+
+		const char *format;
+		std::vector<v8::Handle<v8::Object> > stack;
+		v8::Handle<v8::String> to_json_name;
+		std::string error;
+
+		bool walk_value(v8::Handle<v8::Value> value);
+		bool walk_object(v8::Handle<v8::Object> object);
+		bool walk_array(v8::Handle<v8::Array> array);
+		bool enter(v8::Handle<v8::Object> object);
+
+		StateWalker(const StateWalker &);
+		StateWalker& operator=(const StateWalker &);
+	};
+
+}
@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "TDigest.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace js1 
+{
+
+	const NativeType TDigest::TYPE = { "TDigest" };
+
+	namespace 
+	{
+		const uint8_t SERIALIZATION_VERSION = 1;
+		const double DEFAULT_COMPRESSION = 100;
+		const double MIN_COMPRESSION = 10;
+		const double MAX_COMPRESSION = 10000;
+		const double PI = 3.14159265358979323846;
+	}
+
+	v8::Handle<v8::FunctionTemplate> TDigest::create_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(TYPE, constructor_callback);
+		set_method(result, "add", add_callback);
+		set_method(result, "merge", merge_callback);
+		set_method(result, "quantile", quantile_callback);
+		set_method(result, "count", count_callback);
+		set_method(result, "toJSON", to_json_callback);
+		return handle_scope.Close(result);
+	}
+
+	TDigest::TDigest(double compression_) : 
+		NativeObject(TYPE), compression(compression_), count(0), min(0), max(0), 
+		buffer_capacity(static_cast<size_t>(compression_ * 5))
+	{
+		// the k1 scale function keeps at most about compression * pi / 2 centroids
+		size_t max_centroids = static_cast<size_t>(compression * PI / 2) + 1;
+		centroids.reserve(max_centroids);
+		buffer.reserve(buffer_capacity);
+		set_external_size((max_centroids + buffer_capacity) * sizeof(Centroid));
+	}
+
+	void TDigest::add(double value, uint64_t weight)
+	{
+		if (weight == 0)
+			return;
+		if (count == 0 || value < min)
+			min = value;
+		if (count == 0 || value > max)
+			max = value;
+		Centroid centroid = { value, weight };
+		buffer.push_back(centroid);
+		count += weight;
+		if (buffer.size() >= buffer_capacity)
+			flush();
+	}
+
+	void TDigest::merge(TDigest &other)
+	{
+		if (&other == this)
+		{
+			flush();
+			for (size_t i = 0; i < centroids.size(); i++)
+				centroids[i].weight *= 2;
+			count *= 2;
+			return;
+		}
+		other.flush();
+		if (other.count == 0)
+			return;
+		if (count == 0 || other.min < min)
+			min = other.min;
+		if (count == 0 || other.max > max)
+			max = other.max;
+		count += other.count;
+		buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+		flush();
+	}
+
+	double TDigest::scale(double q) const
+	{
+		return compression / (2 * PI) * asin(2 * q - 1);
+	}
+
+	double TDigest::inverse_scale(double k) const
+	{
+		if (k >= compression / 4)
+			return 1;
+		return (sin(k * 2 * PI / compression) + 1) / 2;
+	}
+
+	void TDigest::flush()
+	{
+		if (buffer.empty())
+			return;
+		buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+		std::sort(buffer.begin(), buffer.end());
+		centroids.clear();
+
+		// neighbours are merged while the merged centroid stays within one unit of the scale function
+		double total = static_cast<double>(count);
+		double so_far = 0;
+		double q_limit = inverse_scale(scale(0) + 1) * total;
+		Centroid current = buffer[0];
+		for (size_t i = 1; i < buffer.size(); i++)
+		{
+			const Centroid &next = buffer[i];
+			if (so_far + current.weight + next.weight <= q_limit)
+			{
+				uint64_t weight = current.weight + next.weight;
+				current.mean += (next.mean - current.mean) * next.weight / weight;
+				current.weight = weight;
+			}
+			else
+			{
+				so_far += current.weight;
+				centroids.push_back(current);
+				q_limit = inverse_scale(scale(so_far / total) + 1) * total;
+				current = next;
+			}
+		}
+		centroids.push_back(current);
+		buffer.clear();
+	}
+
+	double TDigest::quantile(double q)
+	{
+		flush();
+		if (centroids.empty() || q < 0 || q > 1)
+			return std::numeric_limits<double>::quiet_NaN();
+		if (centroids.size() == 1)
+			return centroids[0].mean;
+
+		// interpolates between the centres of the centroids, and min and max at the ends
+		double index = q * count;
+		double first_centre = centroids[0].weight / 2.0;
+		if (index <= first_centre)
+			return min + (centroids[0].mean - min) * (first_centre > 0 ? index / first_centre : 0);
+
+		double centre = first_centre;
+		for (size_t i = 0; i + 1 < centroids.size(); i++)
+		{
+			double next_centre = centre + (centroids[i].weight + centroids[i + 1].weight) / 2.0;
+			if (index <= next_centre)
+			{
+				double fraction = (index - centre) / (next_centre - centre);
+				return centroids[i].mean + (centroids[i + 1].mean - centroids[i].mean) * fraction;
+			}
+			centre = next_centre;
+		}
+
+		double remaining = count - centre;
+		const Centroid &last = centroids.back();
+		return last.mean + (max - last.mean) * (remaining > 0 ? (index - centre) / remaining : 0);
+	}
+
+	void TDigest::serialize(std::string &data)
+	{
+		flush();
+		NativeWriter writer(data);
+		writer.write_byte(SERIALIZATION_VERSION);
+		writer.write_double(compression);
+		writer.write_double(min);
+		writer.write_double(max);
+		writer.write_varint(centroids.size());
+		for (size_t i = 0; i < centroids.size(); i++)
+		{
+			writer.write_double(centroids[i].mean);
+			writer.write_varint(centroids[i].weight);
+		}
+	}
+
+	TDigest *TDigest::deserialize(const std::string &data)
+	{
+		NativeReader reader(data);
+		if (reader.read_byte() != SERIALIZATION_VERSION)
+			return NULL;
+		double compression = reader.read_double();
+		if (reader.has_failed() || !(compression >= MIN_COMPRESSION && compression <= MAX_COMPRESSION))
+			return NULL;
+
+		TDigest *result = new TDigest(compression);
+		result->min = reader.read_double();
+		result->max = reader.read_double();
+		uint64_t size = reader.read_varint();
+		bool valid = !reader.has_failed() && size <= data.size();
+		for (uint64_t i = 0; valid && i < size; i++)
+		{
+			Centroid centroid;
+			centroid.mean = reader.read_double();
+			centroid.weight = reader.read_varint();
+			valid = !reader.has_failed() && centroid.weight > 0
+				&& (result->centroids.empty() || result->centroids.back().mean <= centroid.mean);
+			result->centroids.push_back(centroid);
+			result->count += centroid.weight;
+		}
+		if (!valid || !reader.at_end())
+		{
+			delete result;
+			return NULL;
+		}
+		return result;
+	}
+
+	v8::Handle<v8::Value> TDigest::constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("TDigest must be called with new");
+
+		TDigest *digest = NULL;
+		if (args.Length() == 0 || args[0]->IsUndefined())
+			digest = new TDigest(DEFAULT_COMPRESSION);
+		else if (args[0]->IsNumber())
+		{
+			double compression = args[0]->NumberValue();
+			if (!(compression >= MIN_COMPRESSION && compression <= MAX_COMPRESSION))
+				return throw_error("TDigest compression must be between 10 and 10000");
+			digest = new TDigest(compression);
+		}
+		else
+		{
+			std::string data;
+			if (!from_json_object(args[0], TYPE, data) || (digest = deserialize(data)) == NULL)
+				return throw_error("Invalid TDigest state");
+		}
+		digest->wrap(args.This());
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> TDigest::add_callback(const v8::Arguments& args)
+	{
+		TDigest *digest = unwrap_this(args);
+		uint64_t weight;
+		if (args.Length() < 1 || !args[0]->IsNumber() || !read_count(args, 1, weight))
+			return throw_error("TDigest.add expects a number and an optional non-negative integer weight");
+		double value = args[0]->NumberValue();
+		if (value != value)
+			return throw_error("TDigest.add cannot add NaN");
+		digest->add(value, weight);
+		return v8::Undefined();
+	}
+
+	v8::Handle<v8::Value> TDigest::merge_callback(const v8::Arguments& args)
+	{
+		TDigest *digest = unwrap_this(args);
+		TDigest *other = static_cast<TDigest *>(unwrap(args[0], TYPE));
+		if (other == NULL)
+			return throw_error("TDigest.merge expects a TDigest");
+		digest->merge(*other);
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> TDigest::quantile_callback(const v8::Arguments& args)
+	{
+		TDigest *digest = unwrap_this(args);
+		if (args.Length() != 1 || !args[0]->IsNumber())
+			return throw_error("TDigest.quantile expects a number between 0 and 1");
+		return v8::Number::New(digest->quantile(args[0]->NumberValue()));
+	}
+
+	v8::Handle<v8::Value> TDigest::count_callback(const v8::Arguments& args)
+	{
+		return v8::Number::New(static_cast<double>(unwrap_this(args)->get_count()));
+	}
+
+	v8::Handle<v8::Value> TDigest::to_json_callback(const v8::Arguments& args)
+	{
+		std::string data;
+		unwrap_this(args)->serialize(data);
+		return to_json_object(TYPE, data);
+	}
+
+	TDigest *TDigest::unwrap_this(const v8::Arguments& args)
+	{
+		// the signature guarantees the receiver is a TDigest
+		return static_cast<TDigest *>(unwrap(args.Holder(), TYPE));
+	}
+
+}
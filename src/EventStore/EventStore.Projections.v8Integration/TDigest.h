@@ -0,0 +1,69 @@
+#pragma once
+#include "NativeObject.h"
+
+namespace js1 
+{
+
+	// Merging t-digest exposed to query scripts as TDigest.
+	//
+	// new TDigest([compression]) summarizes a stream of numbers in at most about 
+	// compression centroids (default 100, accurate to a fraction of a percent at the 
+	// tails).  add(value, [weight]) buffers values which are merged into the centroids 
+	// when the buffer fills, quantile(q) returns the estimated q-quantile (NaN while 
+	// empty), merge(other) adds another digest and count() is the total weight.
+	class TDigest : public NativeObject 
+	{
+	public:
+		static const NativeType TYPE;
+
+		static v8::Handle<v8::FunctionTemplate> create_template();
+
+		explicit TDigest(double compression);
+
+		void add(double value, uint64_t weight);
+		void merge(TDigest &other);
+		double quantile(double q);
+
+		uint64_t get_count() const
+		{
+			return count;
+		}
+
+		void serialize(std::string &data);
+		static TDigest *deserialize(const std::string &data);
+
+	private:
+		struct Centroid 
+		{
+			double mean;
+			uint64_t weight;
+
+			bool operator<(const Centroid &other) const
+			{
+				return mean < other.mean;
+			}
+		};
+
+		double compression;
+		uint64_t count;
+		double min;
+		double max;
+		std::vector<Centroid> centroids;
+		std::vector<Centroid> buffer;
+		size_t buffer_capacity;
+
+		void flush();
+		double scale(double q) const;
+		double inverse_scale(double k) const;
+
+		static v8::Handle<v8::Value> constructor_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> add_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> merge_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> quantile_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> count_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> to_json_callback(const v8::Arguments& args);
+
+		static TDigest *unwrap_this(const v8::Arguments& args);
+	};
+
+}
@@ -0,0 +1,408 @@
+#include "stdafx.h"
+#include "TimeWindow.h"
+#include "Timestamp.h"
+
+#include <math.h>
+
+namespace js1 
+{
+
+	const NativeType TimeWindow::SLIDING_TYPE = { "SlidingWindow" };
+	const NativeType TimeWindow::TUMBLING_TYPE = { "TumblingWindow" };
+
+	namespace 
+	{
+		const uint8_t SERIALIZATION_VERSION = 1;
+		const uint32_t MAX_BUCKET_COUNT = 100000;
+		// timestamps are limited to the range of Date so bucket numbers always fit
+		const double MAX_TIMESTAMP = 8.64e15;
+
+		bool read_duration(v8::Handle<v8::Value> value, int64_t &duration)
+		{
+			if (value.IsEmpty() || !value->IsNumber())
+				return false;
+			double number = value->NumberValue();
+			if (!(number >= 1 && number <= MAX_TIMESTAMP) || number != floor(number))
+				return false;
+			duration = static_cast<int64_t>(number);
+			return true;
+		}
+	}
+
+	v8::Handle<v8::FunctionTemplate> TimeWindow::create_sliding_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(SLIDING_TYPE, sliding_constructor_callback);
+		set_common_methods(result);
+		set_method(result, "buckets", buckets_callback);
+		return handle_scope.Close(result);
+	}
+
+	v8::Handle<v8::FunctionTemplate> TimeWindow::create_tumbling_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(TUMBLING_TYPE, tumbling_constructor_callback);
+		set_common_methods(result);
+		set_method(result, "current", current_callback);
+		set_method(result, "closed", closed_callback);
+		return handle_scope.Close(result);
+	}
+
+	void TimeWindow::set_common_methods(v8::Handle<v8::FunctionTemplate> class_template)
+	{
+		set_method(class_template, "add", add_callback);
+		set_method(class_template, "advance", advance_callback);
+		set_method(class_template, "count", count_callback);
+		set_method(class_template, "sum", sum_callback);
+		set_method(class_template, "toJSON", to_json_callback);
+	}
+
+	TimeWindow::TimeWindow(const NativeType &type, int64_t bucket_ms_, uint32_t bucket_count_) : 
+		NativeObject(type), bucket_ms(bucket_ms_), bucket_count(bucket_count_), started(false), head(0), first(0), 
+		total_count(0), total_sum(0), has_dropped(false), dropped_number(0)
+	{
+		Bucket empty = { 0, 0 };
+		dropped = empty;
+		buckets.assign(bucket_count, empty);
+		set_external_size(buckets.size() * sizeof(Bucket));
+	}
+
+	bool TimeWindow::is_tumbling() const
+	{
+		return &get_type() == &TUMBLING_TYPE;
+	}
+
+	int64_t TimeWindow::bucket_of(double timestamp) const
+	{
+		return static_cast<int64_t>(floor(timestamp / static_cast<double>(bucket_ms)));
+	}
+
+	TimeWindow::Bucket &TimeWindow::bucket_at(int64_t number)
+	{
+		int64_t index = number % static_cast<int64_t>(bucket_count);
+		return buckets[static_cast<size_t>(index < 0 ? index + bucket_count : index)];
+	}
+
+	const TimeWindow::Bucket &TimeWindow::bucket_at(int64_t number) const
+	{
+		return const_cast<TimeWindow *>(this)->bucket_at(number);
+	}
+
+	void TimeWindow::advance_to(int64_t number)
+	{
+		if (!started)
+		{
+			started = true;
+			head = number;
+			first = number;
+			return;
+		}
+		if (number <= head)
+			return;
+
+		// the current window closes and leaves the ring at once when the advance skips the whole history
+		const Bucket &current = bucket_at(head);
+		has_dropped = is_tumbling() && number - head >= static_cast<int64_t>(bucket_count) && current.count != 0;
+		if (has_dropped)
+		{
+			dropped_number = head;
+			dropped = current;
+		}
+
+		if (number - head >= static_cast<int64_t>(bucket_count))
+		{
+			Bucket empty = { 0, 0 };
+			buckets.assign(bucket_count, empty);
+			total_count = 0;
+			total_sum = 0;
+		}
+		else
+		{
+			// each bucket entering the window expires the one that was there
+			for (int64_t next = head + 1; next <= number; next++)
+			{
+				Bucket &bucket = bucket_at(next);
+				total_count -= bucket.count;
+				total_sum -= bucket.sum;
+				bucket.count = 0;
+				bucket.sum = 0;
+			}
+			if (total_count == 0)
+				total_sum = 0;
+		}
+		head = number;
+	}
+
+	bool TimeWindow::add(double timestamp, double value)
+	{
+		int64_t number = bucket_of(timestamp);
+		advance_to(number);
+		if (number <= head - static_cast<int64_t>(bucket_count))
+			return false;
+		if (number < first)
+			first = number;
+		Bucket &bucket = bucket_at(number);
+		bucket.count++;
+		bucket.sum += value;
+		total_count++;
+		total_sum += value;
+		return true;
+	}
+
+	void TimeWindow::advance(double timestamp)
+	{
+		advance_to(bucket_of(timestamp));
+	}
+
+	void TimeWindow::serialize(std::string &data) const
+	{
+		NativeWriter writer(data);
+		writer.write_byte(SERIALIZATION_VERSION);
+		writer.write_varint(static_cast<uint64_t>(bucket_ms));
+		writer.write_varint(bucket_count);
+		writer.write_byte(started ? 1 : 0);
+		if (!started)
+			return;
+		writer.write_double(static_cast<double>(head));
+		writer.write_double(static_cast<double>(first));
+		// oldest first, empty buckets take a single byte
+		for (int64_t number = head - bucket_count + 1; number <= head; number++)
+		{
+			const Bucket &bucket = bucket_at(number);
+			writer.write_varint(bucket.count);
+			if (bucket.count != 0)
+				writer.write_double(bucket.sum);
+		}
+		writer.write_byte(has_dropped ? 1 : 0);
+		if (has_dropped)
+		{
+			writer.write_double(static_cast<double>(dropped_number));
+			writer.write_varint(dropped.count);
+			writer.write_double(dropped.sum);
+		}
+	}
+
+	TimeWindow *TimeWindow::deserialize(const NativeType &type, const std::string &data)
+	{
+		NativeReader reader(data);
+		if (reader.read_byte() != SERIALIZATION_VERSION)
+			return NULL;
+		uint64_t bucket_ms = reader.read_varint();
+		uint64_t bucket_count = reader.read_varint();
+		uint8_t started = reader.read_byte();
+		if (reader.has_failed() || bucket_ms == 0 || bucket_ms > static_cast<uint64_t>(MAX_TIMESTAMP) 
+			|| bucket_count == 0 || bucket_count > MAX_BUCKET_COUNT || started > 1)
+			return NULL;
+
+		TimeWindow *result = new TimeWindow(type, static_cast<int64_t>(bucket_ms), static_cast<uint32_t>(bucket_count));
+		bool valid = true;
+		if (started)
+		{
+			double head = reader.read_double();
+			double first = reader.read_double();
+			double limit = MAX_TIMESTAMP / bucket_ms + 1;
+			valid = !reader.has_failed() && head == floor(head) && first == floor(first) 
+				&& fabs(head) <= limit && fabs(first) <= limit && first <= head;
+			if (valid)
+			{
+				result->started = true;
+				result->head = static_cast<int64_t>(head);
+				result->first = static_cast<int64_t>(first);
+				for (int64_t number = result->head - result->bucket_count + 1; number <= result->head && !reader.has_failed(); number++)
+				{
+					Bucket &bucket = result->bucket_at(number);
+					bucket.count = reader.read_varint();
+					if (bucket.count != 0)
+						bucket.sum = reader.read_double();
+					result->total_count += bucket.count;
+					result->total_sum += bucket.sum;
+				}
+				if (reader.read_byte() != 0)
+				{
+					double dropped_number = reader.read_double();
+					result->dropped.count = reader.read_varint();
+					result->dropped.sum = reader.read_double();
+					valid = dropped_number == floor(dropped_number) && dropped_number >= first 
+						&& dropped_number <= head - result->bucket_count && result->dropped.count != 0;
+					if (valid)
+					{
+						result->has_dropped = true;
+						result->dropped_number = static_cast<int64_t>(dropped_number);
+					}
+				}
+			}
+		}
+		if (!valid || reader.has_failed() || !reader.at_end())
+		{
+			delete result;
+			return NULL;
+		}
+		return result;
+	}
+
+	v8::Handle<v8::Object> TimeWindow::bucket_object(int64_t number, const Bucket &bucket) const
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::Object> result = v8::Object::New();
+		result->Set(v8::String::NewSymbol("start"), v8::Number::New(static_cast<double>(number * bucket_ms)));
+		result->Set(v8::String::NewSymbol("count"), v8::Number::New(static_cast<double>(bucket.count)));
+		result->Set(v8::String::NewSymbol("sum"), v8::Number::New(bucket.sum));
+		return handle_scope.Close(result);
+	}
+
+	v8::Handle<v8::Array> TimeWindow::bucket_array(int64_t from, int64_t to) const
+	{
+		v8::HandleScope handle_scope;
+		if (!started)
+			return handle_scope.Close(v8::Array::New(0));
+		// buckets before the first event are not reported
+		if (from < first)
+			from = first;
+		int length = from <= to ? static_cast<int>(to - from + 1) : 0;
+		v8::Handle<v8::Array> result = v8::Array::New(length);
+		for (int i = 0; i < length; i++)
+			result->Set(static_cast<uint32_t>(i), bucket_object(from + i, bucket_at(from + i)));
+		return handle_scope.Close(result);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::construct(const v8::Arguments& args, const NativeType &type, int64_t bucket_ms, uint32_t bucket_count)
+	{
+		TimeWindow *window = new TimeWindow(type, bucket_ms, bucket_count);
+		window->wrap(args.This());
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> TimeWindow::sliding_constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("SlidingWindow must be called with new");
+		if (args.Length() == 1 && args[0]->IsObject())
+		{
+			std::string data;
+			TimeWindow *window = NULL;
+			if (!from_json_object(args[0], SLIDING_TYPE, data) || (window = deserialize(SLIDING_TYPE, data)) == NULL)
+				return throw_error("Invalid SlidingWindow state");
+			window->wrap(args.This());
+			return args.This();
+		}
+
+		int64_t size_ms, bucket_ms;
+		if (args.Length() != 2 || !read_duration(args[0], size_ms) || !read_duration(args[1], bucket_ms) 
+			|| size_ms % bucket_ms != 0 || size_ms / bucket_ms > MAX_BUCKET_COUNT)
+			return throw_error("SlidingWindow expects a size and a bucket width in milliseconds, the size must be a multiple of at most 100000 buckets");
+		return construct(args, SLIDING_TYPE, bucket_ms, static_cast<uint32_t>(size_ms / bucket_ms));
+	}
+
+	v8::Handle<v8::Value> TimeWindow::tumbling_constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("TumblingWindow must be called with new");
+		if (args.Length() == 1 && args[0]->IsObject())
+		{
+			std::string data;
+			TimeWindow *window = NULL;
+			if (!from_json_object(args[0], TUMBLING_TYPE, data) || (window = deserialize(TUMBLING_TYPE, data)) == NULL)
+				return throw_error("Invalid TumblingWindow state");
+			window->wrap(args.This());
+			return args.This();
+		}
+
+		int64_t size_ms;
+		int32_t history = 1;
+		if (args.Length() > 1 && !args[1]->IsUndefined())
+			history = args[1]->IsNumber() ? args[1]->Int32Value() : -1;
+		if (args.Length() < 1 || !read_duration(args[0], size_ms) || history < 0 || static_cast<uint32_t>(history) >= MAX_BUCKET_COUNT)
+			return throw_error("TumblingWindow expects a size in milliseconds and an optional number of closed windows to keep");
+		// the current window is the newest bucket and the closed ones are kept behind it
+		return construct(args, TUMBLING_TYPE, size_ms, static_cast<uint32_t>(history) + 1);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::add_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		double timestamp;
+		if (args.Length() < 1 || !read_timestamp(args[0], timestamp))
+			return throw_error("add expects a timestamp and an optional value");
+		double value = 1;
+		if (args.Length() > 1 && !args[1]->IsUndefined())
+		{
+			if (!args[1]->IsNumber())
+				return throw_error("add expects a numeric value");
+			value = args[1]->NumberValue();
+		}
+		return v8::Boolean::New(window->add(timestamp, value));
+	}
+
+	v8::Handle<v8::Value> TimeWindow::advance_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		double timestamp;
+		if (args.Length() != 1 || !read_timestamp(args[0], timestamp))
+			return throw_error("advance expects a timestamp");
+		window->advance(timestamp);
+		return v8::Undefined();
+	}
+
+	v8::Handle<v8::Value> TimeWindow::count_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		if (!window->is_tumbling())
+			return v8::Number::New(static_cast<double>(window->total_count));
+		return v8::Number::New(window->started ? static_cast<double>(window->bucket_at(window->head).count) : 0);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::sum_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		if (!window->is_tumbling())
+			return v8::Number::New(window->total_sum);
+		return v8::Number::New(window->started ? window->bucket_at(window->head).sum : 0);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::buckets_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		return window->bucket_array(window->head - window->bucket_count + 1, window->head);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::current_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		if (!window->started)
+			return v8::Null();
+		return window->bucket_object(window->head, window->bucket_at(window->head));
+	}
+
+	v8::Handle<v8::Value> TimeWindow::closed_callback(const v8::Arguments& args)
+	{
+		v8::HandleScope handle_scope;
+		TimeWindow *window = unwrap_this(args);
+		v8::Handle<v8::Array> result = window->bucket_array(window->head - window->bucket_count + 1, window->head - 1);
+		if (!window->has_dropped)
+			return handle_scope.Close(result);
+		// the dropped window is older than all the kept ones
+		v8::Handle<v8::Array> with_dropped = v8::Array::New(result->Length() + 1);
+		with_dropped->Set(0, window->bucket_object(window->dropped_number, window->dropped));
+		for (uint32_t i = 0; i < result->Length(); i++)
+			with_dropped->Set(i + 1, result->Get(i));
+		return handle_scope.Close(with_dropped);
+	}
+
+	v8::Handle<v8::Value> TimeWindow::to_json_callback(const v8::Arguments& args)
+	{
+		TimeWindow *window = unwrap_this(args);
+		std::string data;
+		window->serialize(data);
+		return to_json_object(window->is_tumbling() ? TUMBLING_TYPE : SLIDING_TYPE, data);
+	}
+
+	TimeWindow *TimeWindow::unwrap_this(const v8::Arguments& args)
+	{
+		// the signatures guarantee the receiver is one of the window types
+		NativeObject *window = unwrap(args.Holder(), SLIDING_TYPE);
+		if (window == NULL)
+			window = unwrap(args.Holder(), TUMBLING_TYPE);
+		return static_cast<TimeWindow *>(window);
+	}
+
+}
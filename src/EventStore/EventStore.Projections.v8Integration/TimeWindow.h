@@ -0,0 +1,86 @@
+#pragma once
+#include "NativeObject.h"
+
+namespace js1 
+{
+
+	// Ring of fixed width time buckets shared by the window types exposed to query scripts.
+	//
+	// Timestamps are epoch milliseconds, Dates or ISO-8601 strings.  Adding a timestamp past 
+	// the newest bucket advances the ring, clearing the buckets it skips, so each 
+	// bucket is expired once and advancing is O(1) per event amortized.  Timestamps 
+	// older than the oldest bucket are late and rejected.
+	//
+	//   new SlidingWindow(size_ms, bucket_ms) aggregates the last size_ms in 
+	//   bucket_ms steps: add(timestamp, [value]) where value defaults to 1, 
+	//   advance(timestamp), count(), sum() and buckets() returning 
+	//   [{ start, count, sum }] oldest first.
+	//
+	//   new TumblingWindow(size_ms, [history]) aggregates consecutive size_ms windows 
+	//   and keeps the last history (default 1) closed ones: add, advance, count() and 
+	//   sum() of the current window, current() and closed() in the same form as buckets().  
+	//   closed() also reports the window the last advance closed when the advance 
+	//   skipped past the kept history, so no window with events goes unreported.
+	class TimeWindow : public NativeObject 
+	{
+	public:
+		static const NativeType SLIDING_TYPE;
+		static const NativeType TUMBLING_TYPE;
+
+		static v8::Handle<v8::FunctionTemplate> create_sliding_template();
+		static v8::Handle<v8::FunctionTemplate> create_tumbling_template();
+
+		TimeWindow(const NativeType &type, int64_t bucket_ms, uint32_t bucket_count);
+
+		bool add(double timestamp, double value);
+		void advance(double timestamp);
+
+		void serialize(std::string &data) const;
+		static TimeWindow *deserialize(const NativeType &type, const std::string &data);
+
+	private:
+		struct Bucket 
+		{
+			uint64_t count;
+			double sum;
+		};
+
+		int64_t bucket_ms;
+		uint32_t bucket_count;
+		bool started;
+		// numbers (timestamp / bucket_ms) of the newest bucket and of the first one ever added to
+		int64_t head;
+		int64_t first;
+		std::vector<Bucket> buckets;
+		uint64_t total_count;
+		double total_sum;
+		// the window closed by the last advance when it is already behind the kept history
+		bool has_dropped;
+		int64_t dropped_number;
+		Bucket dropped;
+
+		int64_t bucket_of(double timestamp) const;
+		Bucket &bucket_at(int64_t number);
+		const Bucket &bucket_at(int64_t number) const;
+		void advance_to(int64_t number);
+		bool is_tumbling() const;
+		v8::Handle<v8::Object> bucket_object(int64_t number, const Bucket &bucket) const;
+		v8::Handle<v8::Array> bucket_array(int64_t first, int64_t last) const;
+
+		static v8::Handle<v8::Value> sliding_constructor_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> tumbling_constructor_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> add_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> advance_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> count_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> sum_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> buckets_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> current_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> closed_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> to_json_callback(const v8::Arguments& args);
+
+		static void set_common_methods(v8::Handle<v8::FunctionTemplate> class_template);
+		static v8::Handle<v8::Value> construct(const v8::Arguments& args, const NativeType &type, int64_t bucket_ms, uint32_t bucket_count);
+		static TimeWindow *unwrap_this(const v8::Arguments& args);
+	};
+
+}
@@ -0,0 +1,292 @@
+#include "stdafx.h"
+#include "Timestamp.h"
+#include "IsolateData.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace js1 
+{
+
+	namespace 
+	{
+		const int MAX_TIMESTAMP_LENGTH = 64;
+		const double MAX_TIME = 8.64e15;
+		const int64_t MS_PER_MINUTE = 60 * 1000;
+		const int64_t MS_PER_HOUR = 60 * MS_PER_MINUTE;
+		const int64_t MS_PER_DAY = 24 * MS_PER_HOUR;
+
+		// days since 1970-01-01 of a proleptic Gregorian date and back
+		int64_t days_from_civil(int64_t year, int month, int day)
+		{
+			year -= month <= 2;
+			int64_t era = (year >= 0 ? year : year - 399) / 400;
+			int64_t year_of_era = year - era * 400;
+			int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+			int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+			return era * 146097 + day_of_era - 719468;
+		}
+
+		void civil_from_days(int64_t days, int64_t &year, int &month, int &day)
+		{
+			days += 719468;
+			int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+			int64_t day_of_era = days - era * 146097;
+			int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+			int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+			int64_t month_part = (5 * day_of_year + 2) / 153;
+			day = static_cast<int>(day_of_year - (153 * month_part + 2) / 5 + 1);
+			month = static_cast<int>(month_part < 10 ? month_part + 3 : month_part - 9);
+			year = year_of_era + era * 400 + (month <= 2);
+		}
+
+		int days_in_month(int64_t year, int month)
+		{
+			static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+			bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+			return month == 2 && leap ? 29 : days[month - 1];
+		}
+
+		class TimestampScanner 
+		{
+		public:
+			TimestampScanner(const uint16_t *text_, int length_) : text(text_), length(length_), position(0) 
+			{
+			}
+
+			bool digits(int count, int &value)
+			{
+				value = 0;
+				for (int i = 0; i < count; i++)
+				{
+					if (position >= length || text[position] < '0' || text[position] > '9')
+						return false;
+					value = value * 10 + (text[position++] - '0');
+				}
+				return true;
+			}
+
+			bool accept(char c)
+			{
+				if (position < length && text[position] == c)
+				{
+					position++;
+					return true;
+				}
+				return false;
+			}
+
+			bool is_digit() const
+			{
+				return position < length && text[position] >= '0' && text[position] <= '9';
+			}
+
+			bool at_end() const
+			{
+				return position == length;
+			}
+
+		private:
+			const uint16_t *text;
+			int length;
+			int position;
+		};
+	}
+
+	bool parse_timestamp(const uint16_t *text, int length, double &timestamp)
+	{
+		TimestampScanner scanner(text, length);
+		int year, month, day;
+		if (!scanner.digits(4, year) || !scanner.accept('-') || !scanner.digits(2, month) || !scanner.accept('-') || !scanner.digits(2, day))
+			return false;
+		if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month))
+			return false;
+
+		int hour = 0, minute = 0, second = 0, millisecond = 0;
+		int offset_minutes = 0;
+		if (!scanner.at_end())
+		{
+			if (!scanner.accept('T') && !scanner.accept('t') && !scanner.accept(' '))
+				return false;
+			if (!scanner.digits(2, hour) || !scanner.accept(':') || !scanner.digits(2, minute))
+				return false;
+			if (scanner.accept(':'))
+			{
+				if (!scanner.digits(2, second))
+					return false;
+				if (scanner.accept('.') || scanner.accept(','))
+				{
+					if (!scanner.is_digit())
+						return false;
+					// digits past the millisecond are truncated
+					int digit;
+					for (int scale = 100; scanner.is_digit() && scanner.digits(1, digit); scale /= 10)
+						millisecond += digit * scale;
+				}
+			}
+			// a leap second is kept as the first second of the next minute
+			if (hour > 23 || minute > 59 || second > 60)
+				return false;
+
+			int sign = scanner.accept('+') ? 1 : scanner.accept('-') ? -1 : 0;
+			if (sign != 0)
+			{
+				int offset_hour, offset_minute;
+				if (!scanner.digits(2, offset_hour))
+					return false;
+				scanner.accept(':');
+				if (!scanner.digits(2, offset_minute) || offset_hour > 23 || offset_minute > 59)
+					return false;
+				offset_minutes = sign * (offset_hour * 60 + offset_minute);
+			}
+			else if (!scanner.accept('Z'))
+				scanner.accept('z');
+		}
+		if (!scanner.at_end())
+			return false;
+
+		int64_t days = days_from_civil(year, month, day);
+		int64_t ms = days * MS_PER_DAY + hour * MS_PER_HOUR + (minute - offset_minutes) * MS_PER_MINUTE + second * 1000 + millisecond;
+		timestamp = static_cast<double>(ms);
+		return true;
+	}
+
+	bool read_timestamp(v8::Handle<v8::Value> value, double &timestamp)
+	{
+		if (value.IsEmpty())
+			return false;
+		if (value->IsNumber() || value->IsDate())
+			timestamp = value->NumberValue();
+		else if (value->IsString())
+		{
+			// short strings are read into the stack so parsing does not allocate
+			v8::Handle<v8::String> text = value.As<v8::String>();
+			uint16_t buffer[MAX_TIMESTAMP_LENGTH];
+			int length = text->Length();
+			if (length > MAX_TIMESTAMP_LENGTH)
+				return false;
+			text->Write(buffer, 0, length, v8::String::NO_NULL_TERMINATION);
+			if (!parse_timestamp(buffer, length, timestamp))
+				return false;
+		}
+		else
+			return false;
+		return fabs(timestamp) <= MAX_TIME;
+	}
+
+	TimeBucketCache::TimeBucketCache()
+	{
+		for (int i = 0; i < GRANULARITY_COUNT; i++)
+		{
+			entries[i].valid = false;
+			entries[i].bucket = 0;
+		}
+	}
+
+	TimeBucketCache::~TimeBucketCache()
+	{
+		for (int i = 0; i < GRANULARITY_COUNT; i++)
+		{
+			entries[i].key.Dispose();
+			names[i].Dispose();
+		}
+	}
+
+	bool TimeBucketCache::find_granularity(v8::Handle<v8::String> name, TimeGranularity &granularity)
+	{
+		static const char *texts[GRANULARITY_COUNT] = { "minute", "hour", "day", "month" };
+
+		for (int i = 0; i < GRANULARITY_COUNT; i++)
+		{
+			if (names[i].IsEmpty())
+				names[i] = v8::Persistent<v8::String>::New(v8::String::NewSymbol(texts[i]));
+			if (name->Equals(names[i]))
+			{
+				granularity = static_cast<TimeGranularity>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	v8::Handle<v8::String> TimeBucketCache::key(double timestamp, TimeGranularity granularity)
+	{
+		int64_t days = static_cast<int64_t>(floor(timestamp / MS_PER_DAY));
+		int64_t year;
+		int month, day;
+		civil_from_days(days, year, month, day);
+		if (year < 0 || year > 9999)
+			return v8::Handle<v8::String>();
+
+		int64_t bucket;
+		switch (granularity)
+		{
+		case GRANULARITY_MINUTE: bucket = static_cast<int64_t>(floor(timestamp / MS_PER_MINUTE)); break;
+		case GRANULARITY_HOUR: bucket = static_cast<int64_t>(floor(timestamp / MS_PER_HOUR)); break;
+		case GRANULARITY_DAY: bucket = days; break;
+		default: bucket = year * 12 + month; break;
+		}
+		Entry &entry = entries[granularity];
+		if (entry.valid && entry.bucket == bucket)
+			return entry.key;
+
+		int64_t ms_of_day = static_cast<int64_t>(floor(timestamp)) - days * MS_PER_DAY;
+		int hour = static_cast<int>(ms_of_day / MS_PER_HOUR);
+		int minute = static_cast<int>(ms_of_day % MS_PER_HOUR / MS_PER_MINUTE);
+		char text[20];
+		int length;
+		switch (granularity)
+		{
+		case GRANULARITY_MINUTE: 
+			length = sprintf(text, "%04d-%02d-%02dT%02d:%02d", static_cast<int>(year), month, day, hour, minute); 
+			break;
+		case GRANULARITY_HOUR: 
+			length = sprintf(text, "%04d-%02d-%02dT%02d", static_cast<int>(year), month, day, hour); 
+			break;
+		case GRANULARITY_DAY: 
+			length = sprintf(text, "%04d-%02d-%02d", static_cast<int>(year), month, day); 
+			break;
+		default: 
+			length = sprintf(text, "%04d-%02d", static_cast<int>(year), month); 
+			break;
+		}
+
+		entry.key.Dispose();
+		entry.key = v8::Persistent<v8::String>::New(v8::String::NewSymbol(text, length));
+		entry.bucket = bucket;
+		entry.valid = true;
+		return entry.key;
+	}
+
+	v8::Handle<v8::Value> parse_timestamp_callback(const v8::Arguments& args)
+	{
+		if (args.Length() != 1)
+			return v8::ThrowException(v8::Exception::Error(v8::String::New("parseTimestamp expects 1 argument")));
+		double timestamp;
+		if (!args[0]->IsString() || !read_timestamp(args[0], timestamp))
+			return v8::Null();
+		return v8::Number::New(timestamp);
+	}
+
+	v8::Handle<v8::Value> time_bucket_callback(const v8::Arguments& args)
+	{
+		double timestamp;
+		if (args.Length() != 2 || !read_timestamp(args[0], timestamp))
+			return v8::ThrowException(v8::Exception::Error(v8::String::New("timeBucket expects a timestamp and a granularity")));
+
+		// toString of an object granularity may throw, the exception is left pending
+		v8::Handle<v8::String> name = args[1]->ToString();
+		if (name.IsEmpty())
+			return name;
+		TimeBucketCache &time_buckets = IsolateData::current()->time_buckets;
+		TimeGranularity granularity;
+		if (!time_buckets.find_granularity(name, granularity))
+			return v8::ThrowException(v8::Exception::Error(v8::String::New("timeBucket granularity must be 'minute', 'hour', 'day' or 'month'")));
+
+		v8::Handle<v8::String> key = time_buckets.key(timestamp, granularity);
+		if (key.IsEmpty())
+			return v8::ThrowException(v8::Exception::Error(v8::String::New("timeBucket timestamp must be within years 0 to 9999")));
+		return key;
+	}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+namespace js1 
+{
+
+	// parses an ISO-8601 / RFC 3339 date or date-time into epoch milliseconds: 
+	// YYYY-MM-DD[(T|t| )hh:mm[:ss[.fraction]][Z|z|(+|-)hh[:]mm]], no offset meaning UTC
+	bool parse_timestamp(const uint16_t *text, int length, double &timestamp);
+
+	// reads a timestamp argument given as epoch milliseconds, a Date or an ISO-8601 string
+	bool read_timestamp(v8::Handle<v8::Value> value, double &timestamp);
+
+	enum TimeGranularity 
+	{
+		GRANULARITY_MINUTE,
+		GRANULARITY_HOUR,
+		GRANULARITY_DAY,
+		GRANULARITY_MONTH,
+		GRANULARITY_COUNT
+	};
+
+	// Bucket keys ("2013-01-31T14:05", "2013-01-31T14", "2013-01-31" and "2013-01") are 
+	// symbols so equal keys share one string, and the last key of each granularity is 
+	// kept so events of the same bucket return it without formatting.  The granularity 
+	// names are kept as symbols too so reading them does not create any strings.
+	class TimeBucketCache 
+	{
+	public:
+		TimeBucketCache();
+		~TimeBucketCache();
+
+		// empty if the timestamp is outside years 0 to 9999
+		v8::Handle<v8::String> key(double timestamp, TimeGranularity granularity);
+		// false if name is not "minute", "hour", "day" or "month"
+		bool find_granularity(v8::Handle<v8::String> name, TimeGranularity &granularity);
+
+	private:
+		struct Entry 
+		{
+			bool valid;
+			int64_t bucket;
+			v8::Persistent<v8::String> key;
+		};
+
+		Entry entries[GRANULARITY_COUNT];
+		// created on first use as the cache is built before the isolate is entered
+		v8::Persistent<v8::String> names[GRANULARITY_COUNT];
+
+		TimeBucketCache(const TimeBucketCache &);
+		TimeBucketCache& operator=(const TimeBucketCache &);
+	};
+
+	// parseTimestamp(text) returns epoch milliseconds or null if text is not a timestamp
+	v8::Handle<v8::Value> parse_timestamp_callback(const v8::Arguments& args);
+	// timeBucket(timestamp, granularity) returns the bucket key of "minute", "hour", "day" or "month"
+	v8::Handle<v8::Value> time_bucket_callback(const v8::Arguments& args);
+
+}
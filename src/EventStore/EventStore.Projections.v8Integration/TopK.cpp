@@ -0,0 +1,339 @@
+#include "stdafx.h"
+#include "TopK.h"
+
+#include <algorithm>
+
+namespace js1 
+{
+
+	const NativeType TopK::TYPE = { "TopK" };
+
+	namespace 
+	{
+		const uint8_t SERIALIZATION_VERSION = 1;
+		const uint32_t DEFAULT_CAPACITY = 100;
+		const uint32_t MAX_CAPACITY = 100000;
+		// estimated footprint of a tracked value besides its string
+		const size_t COUNTER_OVERHEAD = 96;
+	}
+
+	v8::Handle<v8::FunctionTemplate> TopK::create_template()
+	{
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::FunctionTemplate> result = create_class_template(TYPE, constructor_callback);
+		set_method(result, "add", add_callback);
+		set_method(result, "count", count_callback);
+		set_method(result, "top", top_callback);
+		set_method(result, "merge", merge_callback);
+		set_method(result, "toJSON", to_json_callback);
+		return handle_scope.Close(result);
+	}
+
+	TopK::TopK(uint32_t capacity_) : 
+		NativeObject(TYPE), capacity(capacity_)
+	{
+		heap.reserve(capacity);
+		set_external_size(capacity * COUNTER_OVERHEAD);
+	}
+
+	uint64_t TopK::add(const std::string &value, uint64_t count)
+	{
+		PositionMap::iterator it = positions.find(value);
+		if (it != positions.end())
+		{
+			size_t index = it->second;
+			heap[index].count += count;
+			uint64_t result = heap[index].count;
+			sift_down(index);
+			return result;
+		}
+		if (heap.size() < capacity)
+		{
+			insert(value, count, 0);
+			return count;
+		}
+
+		// the least counted value is replaced and its count becomes the error of the new one
+		Counter &replaced = heap[0];
+		positions.erase(replaced.position);
+		replaced.position = positions.insert(std::make_pair(value, static_cast<size_t>(0))).first;
+		replaced.error = replaced.count;
+		replaced.count += count;
+		uint64_t result = replaced.count;
+		sift_down(0);
+		return result;
+	}
+
+	uint64_t TopK::count_of(const std::string &value) const
+	{
+		PositionMap::const_iterator it = positions.find(value);
+		return it == positions.end() ? 0 : heap[it->second].count;
+	}
+
+	void TopK::merge(const TopK &other)
+	{
+		// a value missing from a full summary may have been counted up to its minimum there
+		uint64_t own_min = heap.size() < capacity ? 0 : min_count();
+		uint64_t other_min = other.heap.size() < other.capacity ? 0 : other.min_count();
+
+		std::map<std::string, std::pair<uint64_t, uint64_t> > merged;
+		for (size_t i = 0; i < heap.size(); i++)
+		{
+			const std::string &value = heap[i].position->first;
+			std::pair<uint64_t, uint64_t> &counter = merged[value];
+			counter.first = heap[i].count;
+			counter.second = heap[i].error;
+			PositionMap::const_iterator it = other.positions.find(value);
+			if (it == other.positions.end())
+			{
+				counter.first += other_min;
+				counter.second += other_min;
+			}
+			else
+			{
+				counter.first += other.heap[it->second].count;
+				counter.second += other.heap[it->second].error;
+			}
+		}
+		for (size_t i = 0; i < other.heap.size(); i++)
+		{
+			const std::string &value = other.heap[i].position->first;
+			if (positions.find(value) != positions.end())
+				continue;
+			std::pair<uint64_t, uint64_t> &counter = merged[value];
+			counter.first = other.heap[i].count + own_min;
+			counter.second = other.heap[i].error + own_min;
+		}
+
+		heap.clear();
+		positions.clear();
+		for (std::map<std::string, std::pair<uint64_t, uint64_t> >::iterator it = merged.begin(); it != merged.end(); it++)
+		{
+			if (heap.size() < capacity)
+				insert(it->first, it->second.first, it->second.second);
+			else if (it->second.first > heap[0].count)
+			{
+				positions.erase(heap[0].position);
+				heap[0].position = positions.insert(std::make_pair(it->first, static_cast<size_t>(0))).first;
+				heap[0].count = it->second.first;
+				heap[0].error = it->second.second;
+				sift_down(0);
+			}
+		}
+	}
+
+	void TopK::serialize(std::string &data) const
+	{
+		NativeWriter writer(data);
+		writer.write_byte(SERIALIZATION_VERSION);
+		writer.write_varint(capacity);
+		writer.write_varint(heap.size());
+		for (size_t i = 0; i < heap.size(); i++)
+		{
+			writer.write_string(heap[i].position->first);
+			writer.write_varint(heap[i].count);
+			writer.write_varint(heap[i].error);
+		}
+	}
+
+	TopK *TopK::deserialize(const std::string &data)
+	{
+		NativeReader reader(data);
+		if (reader.read_byte() != SERIALIZATION_VERSION)
+			return NULL;
+		uint64_t capacity = reader.read_varint();
+		uint64_t size = reader.read_varint();
+		if (reader.has_failed() || capacity == 0 || capacity > MAX_CAPACITY || size > capacity)
+			return NULL;
+
+		TopK *result = new TopK(static_cast<uint32_t>(capacity));
+		for (uint64_t i = 0; i < size && !reader.has_failed(); i++)
+		{
+			std::string value = reader.read_string();
+			uint64_t count = reader.read_varint();
+			uint64_t error = reader.read_varint();
+			if (reader.has_failed() || result->positions.find(value) != result->positions.end())
+				break;
+			result->insert(value, count, error);
+		}
+		if (reader.has_failed() || result->heap.size() != size || !reader.at_end())
+		{
+			delete result;
+			return NULL;
+		}
+		return result;
+	}
+
+	void TopK::insert(const std::string &value, uint64_t count, uint64_t error)
+	{
+		Counter counter;
+		counter.position = positions.insert(std::make_pair(value, heap.size())).first;
+		counter.count = count;
+		counter.error = error;
+		heap.push_back(counter);
+		sift_up(heap.size() - 1);
+	}
+
+	void TopK::sift_up(size_t index)
+	{
+		while (index > 0)
+		{
+			size_t parent = (index - 1) / 2;
+			if (heap[parent].count <= heap[index].count)
+				break;
+			swap(parent, index);
+			index = parent;
+		}
+	}
+
+	void TopK::sift_down(size_t index)
+	{
+		heap[index].position->second = index;
+		for (;;)
+		{
+			size_t smallest = index;
+			size_t left = index * 2 + 1;
+			size_t right = left + 1;
+			if (left < heap.size() && heap[left].count < heap[smallest].count)
+				smallest = left;
+			if (right < heap.size() && heap[right].count < heap[smallest].count)
+				smallest = right;
+			if (smallest == index)
+				break;
+			swap(smallest, index);
+			index = smallest;
+		}
+	}
+
+	void TopK::swap(size_t a, size_t b)
+	{
+		std::swap(heap[a], heap[b]);
+		heap[a].position->second = a;
+		heap[b].position->second = b;
+	}
+
+	uint64_t TopK::min_count() const
+	{
+		return heap.empty() ? 0 : heap[0].count;
+	}
+
+	// ties are broken by value so the order does not depend on the heap layout
+	struct ByDescendingCount 
+	{
+		template <typename T>
+		bool operator()(const T *a, const T *b) const
+		{
+			if (a->count != b->count)
+				return a->count > b->count;
+			return a->position->first < b->position->first;
+		}
+	};
+
+	void TopK::sorted(std::vector<const Counter *> &result) const
+	{
+		result.clear();
+		result.reserve(heap.size());
+		for (size_t i = 0; i < heap.size(); i++)
+			result.push_back(&heap[i]);
+		std::sort(result.begin(), result.end(), ByDescendingCount());
+	}
+
+	v8::Handle<v8::Value> TopK::constructor_callback(const v8::Arguments& args)
+	{
+		if (!args.IsConstructCall())
+			return throw_error("TopK must be called with new");
+
+		TopK *top_k = NULL;
+		if (args.Length() == 0 || args[0]->IsUndefined())
+			top_k = new TopK(DEFAULT_CAPACITY);
+		else if (args[0]->IsNumber())
+		{
+			int32_t capacity = args[0]->Int32Value();
+			if (capacity <= 0 || static_cast<uint32_t>(capacity) > MAX_CAPACITY)
+				return throw_error("TopK size must be between 1 and 100000");
+			top_k = new TopK(static_cast<uint32_t>(capacity));
+		}
+		else
+		{
+			std::string data;
+			if (!from_json_object(args[0], TYPE, data) || (top_k = deserialize(data)) == NULL)
+				return throw_error("Invalid TopK state");
+		}
+		top_k->wrap(args.This());
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> TopK::add_callback(const v8::Arguments& args)
+	{
+		TopK *top_k = unwrap_this(args);
+		uint64_t count;
+		if (args.Length() < 1 || !read_count(args, 1, count))
+			return throw_error("TopK.add expects a value and an optional non-negative integer count");
+		v8::String::Utf8Value value(args[0]);
+		return v8::Number::New(static_cast<double>(top_k->add(std::string(*value, value.length()), count)));
+	}
+
+	v8::Handle<v8::Value> TopK::count_callback(const v8::Arguments& args)
+	{
+		TopK *top_k = unwrap_this(args);
+		if (args.Length() != 1)
+			return throw_error("TopK.count expects 1 argument");
+		v8::String::Utf8Value value(args[0]);
+		return v8::Number::New(static_cast<double>(top_k->count_of(std::string(*value, value.length()))));
+	}
+
+	v8::Handle<v8::Value> TopK::top_callback(const v8::Arguments& args)
+	{
+		TopK *top_k = unwrap_this(args);
+		std::vector<const Counter *> counters;
+		top_k->sorted(counters);
+		size_t n = counters.size();
+		if (args.Length() > 0 && !args[0]->IsUndefined())
+		{
+			int32_t requested = args[0]->Int32Value();
+			if (requested < 0)
+				return throw_error("TopK.top expects a non-negative count");
+			n = std::min(n, static_cast<size_t>(requested));
+		}
+
+		v8::HandleScope handle_scope;
+		v8::Handle<v8::String> value_name = v8::String::NewSymbol("value");
+		v8::Handle<v8::String> count_name = v8::String::NewSymbol("count");
+		v8::Handle<v8::String> error_name = v8::String::NewSymbol("error");
+		v8::Handle<v8::Array> result = v8::Array::New(static_cast<int>(n));
+		for (size_t i = 0; i < n; i++)
+		{
+			const std::string &value = counters[i]->position->first;
+			v8::Handle<v8::Object> item = v8::Object::New();
+			item->Set(value_name, v8::String::New(value.data(), static_cast<int>(value.size())));
+			item->Set(count_name, v8::Number::New(static_cast<double>(counters[i]->count)));
+			item->Set(error_name, v8::Number::New(static_cast<double>(counters[i]->error)));
+			result->Set(static_cast<uint32_t>(i), item);
+		}
+		return handle_scope.Close(result);
+	}
+
+	v8::Handle<v8::Value> TopK::merge_callback(const v8::Arguments& args)
+	{
+		TopK *top_k = unwrap_this(args);
+		TopK *other = static_cast<TopK *>(unwrap(args[0], TYPE));
+		if (other == NULL)
+			return throw_error("TopK.merge expects a TopK");
+		top_k->merge(*other);
+		return args.This();
+	}
+
+	v8::Handle<v8::Value> TopK::to_json_callback(const v8::Arguments& args)
+	{
+		std::string data;
+		unwrap_this(args)->serialize(data);
+		return to_json_object(TYPE, data);
+	}
+
+	TopK *TopK::unwrap_this(const v8::Arguments& args)
+	{
+		// the signature guarantees the receiver is a TopK
+		return static_cast<TopK *>(unwrap(args.Holder(), TYPE));
+	}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "NativeObject.h"
+
+namespace js1 
+{
+
+	// Space-saving heavy hitters summary exposed to query scripts as TopK.
+	//
+	// new TopK([k]) tracks at most k values (default 100).  add(value, [count]) 
+	// returns the value's estimated count; when the summary is full a new value 
+	// replaces the least counted one and inherits its count as error, so any value 
+	// counted more than total / k times is always tracked.  Values are compared by 
+	// their string form.  top([n]) returns [{ value, count, error }] by descending 
+	// count and merge(other) combines two summaries.
+	class TopK : public NativeObject 
+	{
+	public:
+		static const NativeType TYPE;
+
+		static v8::Handle<v8::FunctionTemplate> create_template();
+
+		explicit TopK(uint32_t capacity);
+
+		uint64_t add(const std::string &value, uint64_t count);
+		uint64_t count_of(const std::string &value) const;
+		void merge(const TopK &other);
+
+		void serialize(std::string &data) const;
+		static TopK *deserialize(const std::string &data);
+
+	private:
+		typedef std::map<std::string, size_t> PositionMap;
+
+		struct Counter 
+		{
+			PositionMap::iterator position;
+			uint64_t count;
+			uint64_t error;
+		};
+
+		// min-heap by count, positions maps each tracked value to its heap index
+		uint32_t capacity;
+		std::vector<Counter> heap;
+		PositionMap positions;
+
+		void insert(const std::string &value, uint64_t count, uint64_t error);
+		void sift_up(size_t index);
+		void sift_down(size_t index);
+		void swap(size_t a, size_t b);
+		uint64_t min_count() const;
+		void sorted(std::vector<const Counter *> &result) const;
+
+		static v8::Handle<v8::Value> constructor_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> add_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> count_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> top_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> merge_callback(const v8::Arguments& args);
+		static v8::Handle<v8::Value> to_json_callback(const v8::Arguments& args);
+
+		static TopK *unwrap_this(const v8::Arguments& args);
+	};
+
+}
@@ -0,0 +1,199 @@
+#include "stdafx.h"
+#include "defines.h"
+#include "TraceLog.h"
+#include "JsonWriter.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+	namespace 
+	{
+		THREADSTATIC void *current_thread_buffer = NULL;
+	}
+
+	volatile bool TraceLog::enabled = false;
+	FILE *TraceLog::file = NULL;
+	platform::Mutex TraceLog::buffers_lock;
+	platform::Mutex TraceLog::lock;
+	platform::ConditionVariable TraceLog::chunk_ready;
+	std::list<TraceLog::Chunk> TraceLog::chunks;
+	std::list<TraceLog::ThreadBuffer *> TraceLog::buffers;
+	bool TraceLog::stopping = false;
+	platform::Thread TraceLog::writer_thread;
+	// defined last, so it is destroyed before the state it stops
+	TraceLog::Shutdown TraceLog::shutdown;
+
+	TraceLog::Shutdown::~Shutdown()
+	{
+		TraceLog::stop();
+		platform::ScopedLock scoped_buffers_lock(buffers_lock);
+		for (std::list<ThreadBuffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+			delete *it;
+		buffers.clear();
+	}
+
+	bool TraceLog::start(const std::string &file_name)
+	{
+		platform::ScopedLock scoped_buffers_lock(buffers_lock);
+		if (file != NULL)
+			return false;
+
+		// events recorded after the previous trace was stopped are dropped
+		for (std::list<ThreadBuffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+		{
+			platform::ScopedLock buffer_lock((*it)->lock);
+			(*it)->events.clear();
+		}
+
+		platform::ScopedLock scoped_lock(lock);
+		file = fopen(file_name.c_str(), "w");
+		if (file == NULL)
+			return false;
+		fprintf(file, "{\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"js1\"}}", platform::process_id());
+		chunks.clear();
+		stopping = false;
+		if (!writer_thread.start(writer, NULL))
+		{
+			fclose(file);
+			file = NULL;
+			return false;
+		}
+		enabled = true;
+		return true;
+	}
+
+	void TraceLog::stop()
+	{
+		platform::ScopedLock scoped_buffers_lock(buffers_lock);
+		if (file == NULL)
+			return;
+		enabled = false;
+		std::list<Chunk> remaining;
+		for (std::list<ThreadBuffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+		{
+			platform::ScopedLock buffer_lock((*it)->lock);
+			remaining.push_back(Chunk());
+			remaining.back().thread_id = (*it)->thread_id;
+			remaining.back().events.swap((*it)->events);
+		}
+		{
+			platform::ScopedLock scoped_lock(lock);
+			chunks.splice(chunks.end(), remaining);
+			stopping = true;
+			chunk_ready.notify_one();
+		}
+		writer_thread.join();
+
+		platform::ScopedLock scoped_lock(lock);
+		fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(file);
+		file = NULL;
+	}
+
+	void TraceLog::complete(const char *name, const char *category, uint64_t started_us, uint64_t duration_us, 
+		void *script, const char *argument_name, const std::string &argument)
+	{
+		if (!enabled)
+			return;
+		ThreadBuffer *buffer = get_thread_buffer();
+		platform::ScopedLock buffer_lock(buffer->lock);
+		buffer->events.push_back(Event());
+		Event &event = buffer->events.back();
+		event.name = name;
+		event.category = category;
+		event.started_us = started_us;
+		event.duration_us = duration_us;
+		event.script = script;
+		event.argument_name = argument_name;
+		event.argument = argument;
+		if (buffer->events.size() >= CHUNK_EVENTS)
+			hand_over(*buffer);
+	}
+
+	TraceLog::ThreadBuffer *TraceLog::get_thread_buffer()
+	{
+		ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(current_thread_buffer);
+		if (buffer == NULL)
+		{
+			buffer = new ThreadBuffer();
+			buffer->thread_id = platform::thread_id();
+			buffer->events.reserve(CHUNK_EVENTS);
+			platform::ScopedLock scoped_lock(buffers_lock);
+			buffers.push_back(buffer);
+			current_thread_buffer = buffer;
+		}
+		return buffer;
+	}
+
+	// the buffer must be locked by the caller
+	void TraceLog::hand_over(ThreadBuffer &buffer)
+	{
+		platform::ScopedLock scoped_lock(lock);
+		if (!enabled)
+			return;
+		chunks.push_back(Chunk());
+		chunks.back().thread_id = buffer.thread_id;
+		chunks.back().events.swap(buffer.events);
+		buffer.events.reserve(CHUNK_EVENTS);
+		chunk_ready.notify_one();
+	}
+
+	void TraceLog::write_chunk(const Chunk &chunk)
+	{
+		uint32_t process_id = platform::process_id();
+		for (std::vector<Event>::const_iterator it = chunk.events.begin(); it != chunk.events.end(); ++it)
+		{
+			JsonWriter writer;
+			writer.begin_object();
+			writer.member("name", it->name);
+			writer.member("cat", it->category);
+			writer.member("ph", "X");
+			writer.member("ts", it->started_us);
+			writer.member("dur", it->duration_us);
+			writer.member("pid", process_id);
+			writer.member("tid", chunk.thread_id);
+			if (it->script != NULL || it->argument_name != NULL)
+			{
+				writer.key("args");
+				writer.begin_object();
+				if (it->script != NULL)
+				{
+					char script[32];
+					sprintf(script, "%p", it->script);
+					writer.member("script", script);
+				}
+				if (it->argument_name != NULL)
+					writer.member(it->argument_name, it->argument);
+				writer.end_object();
+			}
+			writer.end_object();
+			fprintf(file, ",\n%s", writer.str().c_str());
+		}
+	}
+
+	void TraceLog::writer(void * /*argument*/)
+	{
+		std::list<Chunk> pending;
+		while (true)
+		{
+			bool stopped;
+			{
+				platform::ScopedLock scoped_lock(lock);
+				while (chunks.empty() && !stopping)
+					chunk_ready.wait(lock);
+				pending.splice(pending.end(), chunks);
+				stopped = stopping;
+			}
+			// the file is only written by this thread until it is joined
+			for (std::list<Chunk>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+				write_chunk(*it);
+			pending.clear();
+			if (stopped)
+				break;
+		}
+		fflush(file);
+	}
+
+}
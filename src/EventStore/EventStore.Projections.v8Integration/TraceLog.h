@@ -0,0 +1,126 @@
+#pragma once
+#include "platform.h"
+
+#include <stdio.h>
+
+namespace js1 
+{
+
+	// Writes spans of compile, execute, callback and GC phases to a Chrome trace-event 
+	// JSON file which can be loaded into chrome://tracing or Perfetto.  
+	//
+	// Each thread appends events to its own buffer which is handed over to a background 
+	// writer thread when full, so recording an event never waits for the file.  Thread 
+	// buffers are kept and reused by later traces until the library is unloaded, when 
+	// a running trace is stopped (and its file completed) and the buffers are freed.
+	class TraceLog 
+	{
+	public:
+		static bool start(const std::string &file_name);
+		static void stop();
+
+		static bool is_enabled()
+		{
+			return enabled;
+		}
+
+		// name, category and argument_name must be string literals
+		static void complete(const char *name, const char *category, uint64_t started_us, uint64_t duration_us, 
+			void *script, const char *argument_name, const std::string &argument);
+
+	private:
+		struct Event 
+		{
+			const char *name;
+			const char *category;
+			uint64_t started_us;
+			uint64_t duration_us;
+			void *script;
+			const char *argument_name;
+			std::string argument;
+		};
+
+		struct ThreadBuffer 
+		{
+			uint32_t thread_id;
+			platform::Mutex lock;
+			std::vector<Event> events;
+		};
+
+		struct Chunk 
+		{
+			uint32_t thread_id;
+			std::vector<Event> events;
+		};
+
+		// stops the trace and frees the thread buffers during static destruction
+		struct Shutdown 
+		{
+			~Shutdown();
+		};
+
+		static const size_t CHUNK_EVENTS = 1024;
+
+		static volatile bool enabled;
+		static FILE *file;
+		// lock order is buffers_lock, ThreadBuffer::lock, lock
+		static platform::Mutex buffers_lock;
+		static platform::Mutex lock;
+		static platform::ConditionVariable chunk_ready;
+		static std::list<Chunk> chunks;
+		static std::list<ThreadBuffer *> buffers;
+		static bool stopping;
+		static platform::Thread writer_thread;
+		static Shutdown shutdown;
+
+		static ThreadBuffer *get_thread_buffer();
+		static void hand_over(ThreadBuffer &buffer);
+		static void write_chunk(const Chunk &chunk);
+		static void writer(void *argument);
+	};
+
+	// Records a complete event from construction to destruction if tracing was enabled at construction
+	class TraceSpan 
+	{
+	public:
+		TraceSpan(const char *name_, const char *category_, void *script_ = NULL) : 
+			name(name_), category(category_), script(script_), argument_name(NULL), 
+			started_us(TraceLog::is_enabled() ? platform::now_us() : 0)
+		{
+		}
+
+		~TraceSpan()
+		{
+			if (started_us != 0)
+				TraceLog::complete(name, category, started_us, platform::now_us() - started_us, script, argument_name, argument);
+		}
+
+		bool is_enabled() const
+		{
+			return started_us != 0;
+		}
+
+		void set_script(void *script_)
+		{
+			script = script_;
+		}
+
+		void set_argument(const char *argument_name_, const std::string &argument_)
+		{
+			argument_name = argument_name_;
+			argument = argument_;
+		}
+
+	private:
+		const char *name;
+		const char *category;
+		void *script;
+		const char *argument_name;
+		std::string argument;
+		uint64_t started_us;
+
+		TraceSpan(const TraceSpan &);
+		TraceSpan& operator=(const TraceSpan &);
+	};
+
+}
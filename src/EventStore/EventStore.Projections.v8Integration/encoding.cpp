@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "encoding.h"
+
+namespace js1 
+{
+	namespace 
+	{
+		const uint16_t REPLACEMENT_CHARACTER = 0xFFFD;
+		const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	}
+
+	std::vector<uint16_t> utf8_to_utf16(const char *utf8, size_t length)
+	{
+		std::vector<uint16_t> result;
+		result.reserve(length + 1);
+		const unsigned char *p = reinterpret_cast<const unsigned char *>(utf8);
+		const unsigned char *end = p + length;
+		while (p < end)
+		{
+			uint32_t c = *p++;
+			int continuation = 0;
+			if (c >= 0xF0 && c < 0xF8) { c &= 0x07; continuation = 3; }
+			else if (c >= 0xE0) { c &= 0x0F; continuation = 2; }
+			else if (c >= 0xC0) { c &= 0x1F; continuation = 1; }
+			else if (c >= 0x80) { result.push_back(REPLACEMENT_CHARACTER); continue; }
+
+			bool valid = true;
+			for (int i = 0; i < continuation; i++)
+			{
+				if (p == end || (*p & 0xC0) != 0x80)
+				{
+					valid = false;
+					break;
+				}
+				c = (c << 6) | (*p++ & 0x3F);
+			}
+			if (!valid || c > 0x10FFFF)
+				result.push_back(REPLACEMENT_CHARACTER);
+			else if (c >= 0x10000)
+			{
+				c -= 0x10000;
+				result.push_back(static_cast<uint16_t>(0xD800 + (c >> 10)));
+				result.push_back(static_cast<uint16_t>(0xDC00 + (c & 0x3FF)));
+			}
+			else
+				result.push_back(static_cast<uint16_t>(c));
+		}
+		result.push_back(0);
+		return result;
+	}
+
+	std::vector<uint16_t> utf8_to_utf16(const std::string &utf8)
+	{
+		return utf8_to_utf16(utf8.data(), utf8.size());
+	}
+
+	std::string utf16_to_utf8(const uint16_t *utf16, size_t length)
+	{
+		std::string result;
+		result.reserve(length);
+		for (size_t i = 0; i < length; i++)
+		{
+			uint32_t c = utf16[i];
+			if (c >= 0xD800 && c < 0xDC00 && i + 1 < length && utf16[i + 1] >= 0xDC00 && utf16[i + 1] < 0xE000)
+			{
+				c = 0x10000 + ((c - 0xD800) << 10) + (utf16[i + 1] - 0xDC00);
+				i++;
+			}
+			else if (c >= 0xD800 && c < 0xE000)
+				c = REPLACEMENT_CHARACTER;
+
+			if (c < 0x80)
+				result += static_cast<char>(c);
+			else if (c < 0x800)
+			{
+				result += static_cast<char>(0xC0 | (c >> 6));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				result += static_cast<char>(0xE0 | (c >> 12));
+				result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				result += static_cast<char>(0xF0 | (c >> 18));
+				result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+				result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+		}
+		return result;
+	}
+
+	std::string utf16_to_utf8(const uint16_t *utf16)
+	{
+		return utf16_to_utf8(utf16, utf16_length(utf16));
+	}
+
+	size_t utf16_length(const uint16_t *utf16)
+	{
+		size_t length = 0;
+		while (utf16[length] != 0)
+			length++;
+		return length;
+	}
+
+	std::string base64_encode(const std::string &data)
+	{
+		std::string result;
+		result.reserve((data.size() + 2) / 3 * 4);
+		const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+		size_t i = 0;
+		for (; i + 2 < data.size(); i += 3)
+		{
+			uint32_t triple = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+			result.push_back(BASE64_ALPHABET[(triple >> 18) & 0x3f]);
+			result.push_back(BASE64_ALPHABET[(triple >> 12) & 0x3f]);
+			result.push_back(BASE64_ALPHABET[(triple >> 6) & 0x3f]);
+			result.push_back(BASE64_ALPHABET[triple & 0x3f]);
+		}
+		if (i < data.size())
+		{
+			uint32_t triple = p[i] << 16;
+			if (i + 1 < data.size())
+				triple |= p[i + 1] << 8;
+			result.push_back(BASE64_ALPHABET[(triple >> 18) & 0x3f]);
+			result.push_back(BASE64_ALPHABET[(triple >> 12) & 0x3f]);
+			result.push_back(i + 1 < data.size() ? BASE64_ALPHABET[(triple >> 6) & 0x3f] : '=');
+			result.push_back('=');
+		}
+		return result;
+	}
+
+	bool base64_decode(const char *base64, size_t length, std::string &data)
+	{
+		data.clear();
+		if (length % 4 != 0)
+			return false;
+		data.reserve(length / 4 * 3);
+		uint32_t quad = 0;
+		int count = 0;
+		int padding = 0;
+		for (size_t i = 0; i < length; i++)
+		{
+			char c = base64[i];
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else if (c == '=' && i + 2 >= length) { value = 0; padding++; }
+			else return false;
+			if (padding > 0 && c != '=')
+				return false;
+			quad = (quad << 6) | value;
+			if (++count == 4)
+			{
+				data.push_back(static_cast<char>((quad >> 16) & 0xff));
+				if (padding < 2)
+					data.push_back(static_cast<char>((quad >> 8) & 0xff));
+				if (padding < 1)
+					data.push_back(static_cast<char>(quad & 0xff));
+				quad = 0;
+				count = 0;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace js1 
+{
+	// returned UTF-16 buffers are null terminated and the terminator is included in their size
+	std::vector<uint16_t> utf8_to_utf16(const char *utf8, size_t length);
+	std::vector<uint16_t> utf8_to_utf16(const std::string &utf8);
+	std::string utf16_to_utf8(const uint16_t *utf16, size_t length);
+	std::string utf16_to_utf8(const uint16_t *utf16);
+	// number of code units before the null terminator
+	size_t utf16_length(const uint16_t *utf16);
+
+	std::string base64_encode(const std::string &data);
+	// returns false if the input is not valid base64
+	bool base64_decode(const char *base64, size_t length, std::string &data);
+}
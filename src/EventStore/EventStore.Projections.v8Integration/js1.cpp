@@ -7,6 +7,20 @@
 #include "PreludeScript.h"
 #include "QueryScript.h"
 #include "PreludeScope.h"
+#include "IsolateData.h"
+#include "JsonWriter.h"
+#include "CounterTable.h"
+#include "encoding.h"
+#include "HeapSnapshotWriter.h"
+#include "PerfMap.h"
+#include "Capture.h"
+#include "TraceLog.h"
+#include "LogPipeline.h"
+#include "StateSerializer.h"
+#include "EventHandler.h"
+#include "ExecuteResult.h"
+#include "ShardedQuery.h"
+#include "platform.h"
 
 extern "C" 
 {
@@ -21,15 +35,18 @@ extern "C"
 	//TODO: revise error reporting - it is no the best way to create faulted objects and then immediately dispose them
 	JS1_API void * STDCALL compile_module(void *prelude, const uint16_t *script, const uint16_t *file_name)
 	{
-		printf("compile_module\n");
 		js1::PreludeScript *prelude_script = reinterpret_cast<js1::PreludeScript *>(prelude);
 		js1::ModuleScript *module_script;
+		js1::TraceSpan trace_span("compile_module", "js1");
 
 		js1::PreludeScope prelude_scope(prelude_script);
 		v8::HandleScope scope;
 
 
 		module_script = new js1::ModuleScript(prelude_script);
+		trace_span.set_script(module_script);
+		if (js1::Capture::is_enabled())
+			js1::Capture::record_compile(js1::Capture::COMPILE_MODULE, module_script, prelude_script, file_name, script);
 
 		if (module_script->compile_script(script, file_name))
 			module_script->run();
@@ -38,9 +55,12 @@ extern "C"
 
 	JS1_API void * STDCALL compile_prelude(const uint16_t *prelude, const uint16_t *file_name, LOAD_MODULE_CALLBACK load_module_callback, LOG_CALLBACK log_callback)
 	{
-		printf("compile_prelude\n");
 		js1::PreludeScript *prelude_script;
+		js1::TraceSpan trace_span("compile_prelude", "js1");
 		prelude_script = new js1::PreludeScript(load_module_callback, log_callback);
+		trace_span.set_script(prelude_script);
+		if (js1::Capture::is_enabled())
+			js1::Capture::record_compile(js1::Capture::COMPILE_PRELUDE, prelude_script, NULL, file_name, prelude);
 		js1::PreludeScope prelude_scope(prelude_script);
 
 		v8::HandleScope scope;
@@ -62,12 +82,16 @@ extern "C"
 
 		js1::PreludeScript *prelude_script = reinterpret_cast<js1::PreludeScript *>(prelude);
 		js1::QueryScript *query_script;
+		js1::TraceSpan trace_span("compile_query", "js1");
 		js1::PreludeScope prelude_scope(prelude_script);
 
 		v8::HandleScope scope;
 
 
 		query_script = new js1::QueryScript(prelude_script, register_command_handler_callback, reverse_command_callback);
+		trace_span.set_script(query_script);
+		if (js1::Capture::is_enabled())
+			js1::Capture::record_compile(js1::Capture::COMPILE_QUERY, query_script, prelude_script, file_name, script);
 
 		if (query_script->compile_script(script, file_name))
 			query_script->run();
@@ -79,6 +103,8 @@ extern "C"
 		js1::CompiledScript *compiled_script;
 		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
 		js1::PreludeScope prelude_scope(compiled_script);
+		if (js1::Capture::is_enabled())
+			js1::Capture::record_dispose(compiled_script);
 		delete compiled_script;
 	};
 
@@ -89,25 +115,38 @@ extern "C"
 		//TODO: add v8::try_catch here (and move scope/context to this level) and make errors reportable to theC# level
 		
 		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
-		js1::PreludeScope prelude_scope(query_script);
+		js1::TraceSpan trace_span("execute_command_handler", "js1", query_script);
+		if (trace_span.is_enabled())
+			trace_span.set_argument("handler", reinterpret_cast<js1::EventHandler *>(event_handler_handle)->get_name());
+
+		// an unchanged state is served from the cache without entering the isolate (and is not captured)
+		js1::ExecuteResult *result = query_script->get_cached_result(event_handler_handle);
+		if (result == NULL) 
+		{
+			js1::PreludeScope prelude_scope(query_script);
 
-		v8::Persistent<v8::String> result = query_script->execute_handler(event_handler_handle, data_json, data_other, other_length);
-		if (result.IsEmpty()) {
+			bool capture = js1::Capture::is_enabled();
+			uint64_t started_us = capture ? js1::platform::now_us() : 0;
+			result = query_script->execute_handler(event_handler_handle, data_json, data_other, other_length);
+			if (capture)
+				js1::Capture::record_execute(query_script, reinterpret_cast<js1::EventHandler *>(event_handler_handle)->get_name(), 
+					data_json, data_other, other_length, result == NULL ? -1 : static_cast<int>(result->get_length()), js1::platform::now_us() - started_us);
+		}
+		if (result == NULL) {
 			*result_json = NULL;
 			return NULL;
 		}
 		//NOTE: incorrect return types are handled in execute_handler
-		v8::String::Value * result_buffer = new v8::String::Value(result);
-		result.Dispose();
-		*result_json = **result_buffer;
+		*result_json = result->get_data();
 
-		return result_buffer;
+		return result;
 	};
 
 	JS1_API void STDCALL free_result(void *result)
 	{
-		v8::String::Value * result_buffer = reinterpret_cast<v8::String::Value *>(result);		
-		delete result_buffer;
+		js1::ExecuteResult * execute_result = reinterpret_cast<js1::ExecuteResult *>(result);		
+		if (execute_result != NULL)
+			execute_result->release();
 	};
 
 	//TODO: revise error reporting completely (we are loosing error messages from the load_module this way)
@@ -119,5 +158,401 @@ extern "C"
 
 		query_script->report_errors(report_error_callback);
 	}
-}
 
+	// all the GC notifications below must be called on the thread the script is executed on
+	JS1_API bool STDCALL notify_idle(void *script_handle, int32_t idle_time_ms)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		return js1::IdleGcPolicy::notify_idle(idle_time_ms);
+	}
+
+	JS1_API void STDCALL notify_low_memory(void *script_handle)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::IdleGcPolicy::notify_low_memory();
+	}
+
+	JS1_API void STDCALL set_idle_gc_policy(void *script_handle, int32_t idle_after_ms, int32_t idle_time_ms, bool after_checkpoint)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::IsolateData::current()->idle_gc_policy.configure(idle_after_ms, idle_time_ms, after_checkpoint);
+	}
+
+	JS1_API void STDCALL notify_checkpoint(void *script_handle)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::IsolateData::current()->idle_gc_policy.record_checkpoint();
+	}
+
+	JS1_API bool STDCALL idle_tick(void *script_handle)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::IsolateData *isolate_data = js1::IsolateData::current();
+		// an idle projection executes no handlers, so the host tick is what ends its profile on time
+		isolate_data->cpu_profile_session.check_deadline();
+		// nothing is compiled while idle, so the perf map entries buffered so far are written out now
+		js1::PerfMap::flush();
+		return isolate_data->idle_gc_policy.tick();
+	}
+
+	JS1_API void STDCALL get_gc_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::JsonWriter writer;
+		js1::IsolateData::current()->gc_statistics.write_json(writer);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+
+	JS1_API void STDCALL reset_gc_statistics(void *script_handle)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::IsolateData::current()->gc_statistics.reset();
+	}
+
+	// handler statistics are not synchronized and must be read on the thread the query is executed on
+	JS1_API void STDCALL get_handler_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+
+		js1::JsonWriter writer;
+		query_script->write_handler_statistics(writer);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+
+	JS1_API void STDCALL reset_handler_statistics(void *script_handle)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+
+		query_script->reset_handler_statistics();
+	}
+
+	// must be called before compiling preludes whose counters are to be collected
+	JS1_API bool STDCALL enable_v8_counters(const uint16_t *map_file_name)
+	{
+		if (map_file_name == NULL)
+			return js1::CounterTable::enable(NULL);
+		return js1::CounterTable::enable(js1::utf16_to_utf8(map_file_name).c_str());
+	}
+
+	JS1_API void STDCALL get_v8_counters(REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::JsonWriter writer;
+		js1::CounterTable::write_json(writer);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+
+	JS1_API bool STDCALL start_cpu_profiling(void *script_handle, const uint16_t *title, int32_t max_duration_ms)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		return js1::IsolateData::current()->cpu_profile_session.start(title, max_duration_ms);
+	}
+
+	JS1_API bool STDCALL take_cpu_profile(void *script_handle, int32_t format, REPORT_STATISTICS_CALLBACK report_profile_callback)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		std::string profile;
+		if (!js1::IsolateData::current()->cpu_profile_session.take(static_cast<js1::CpuProfileSession::Format>(format), profile))
+			return false;
+		report_profile_callback(&js1::utf8_to_utf16(profile)[0]);
+		return true;
+	}
+
+	JS1_API bool STDCALL write_heap_snapshot(void *script_handle, const uint16_t *file_name)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		return js1::HeapSnapshotWriter::write_snapshot(js1::utf16_to_utf8(file_name).c_str());
+	}
+
+	JS1_API void STDCALL get_heap_summary(void *script_handle, int32_t top_count, REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::CompiledScript *compiled_script;
+		compiled_script = reinterpret_cast<js1::CompiledScript *>(script_handle);
+		js1::PreludeScope prelude_scope(compiled_script);
+
+		js1::JsonWriter writer;
+		js1::HeapSnapshotWriter::write_summary(writer, top_count);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+
+	// isolates created while enabled get the code event handler; re-enabling resumes writing for 
+	// the isolates that already have it, disabling stops writing immediately
+	JS1_API bool STDCALL enable_perf_map(bool enabled)
+	{
+		return js1::PerfMap::enable(enabled);
+	}
+
+	// captures compile and execute calls of all the scripts compiled after the call, see Capture.h
+	JS1_API bool STDCALL start_capture(const uint16_t *file_name, int64_t max_file_size, int32_t max_files)
+	{
+		return js1::Capture::start(js1::utf16_to_utf8(file_name), static_cast<uint64_t>(max_file_size), max_files);
+	}
+
+	// returns false if the capture has been ended early by a write failure
+	JS1_API bool STDCALL stop_capture()
+	{
+		return js1::Capture::stop();
+	}
+
+	// spans of all the threads are written to a Chrome trace-event JSON file, see TraceLog.h
+	JS1_API bool STDCALL start_trace(const uint16_t *file_name)
+	{
+		return js1::TraceLog::start(js1::utf16_to_utf8(file_name));
+	}
+
+	JS1_API void STDCALL stop_trace()
+	{
+		js1::TraceLog::stop();
+	}
+
+	// messages below the level (1 by default) are dropped before conversion: 
+	// 0 - debug, 1 - info, 2 - warning, 3 - error, 4 - none; returns false for any other level
+	JS1_API bool STDCALL set_log_level(int32_t level)
+	{
+		return js1::LogPipeline::set_level(level);
+	}
+
+	// in asynchronous mode the log callback is called on a background thread
+	JS1_API bool STDCALL set_asynchronous_logging(bool asynchronous, int32_t capacity)
+	{
+		return js1::LogPipeline::set_asynchronous(asynchronous, static_cast<uint32_t>(capacity));
+	}
+
+	JS1_API int64_t STDCALL get_dropped_log_messages()
+	{
+		return static_cast<int64_t>(js1::LogPipeline::get_dropped_count());
+	}
+
+	// state checkpoint deltas, see StateDelta.h for the format
+	JS1_API bool STDCALL get_state_delta(void *script_handle, bool full, int32_t full_snapshot_every, REPORT_STATISTICS_CALLBACK report_delta_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		std::string delta;
+		if (!query_script->get_state_delta(full, full_snapshot_every, delta))
+			return false;
+		report_delta_callback(&js1::utf8_to_utf16(delta)[0]);
+		return true;
+	}
+
+	JS1_API bool STDCALL apply_state_delta(void *script_handle, const uint16_t *delta_json)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		return query_script->apply_state_delta(delta_json);
+	}
+
+	// streams the state as UTF-8 JSON in chunks of at most chunk_size bytes, the callback returns false to abort
+	JS1_API bool STDCALL write_state(void *script_handle, int32_t chunk_size, WRITE_CHUNK_CALLBACK write_chunk_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		js1::CallbackChunkSink sink(write_chunk_callback);
+		return query_script->write_state(sink, static_cast<size_t>(chunk_size));
+	}
+
+	// loads the state from UTF-8 JSON chunks, the state is replaced by end_state_load
+	JS1_API void STDCALL begin_state_load(void *script_handle)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		query_script->begin_state_load();
+	}
+
+	JS1_API bool STDCALL append_state_chunk(void *script_handle, const uint8_t *data, int32_t length)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		return query_script->append_state_chunk(reinterpret_cast<const char *>(data), static_cast<size_t>(length));
+	}
+
+	JS1_API bool STDCALL end_state_load(void *script_handle)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		return query_script->end_state_load();
+	}
+
+	// writes the state in the compact binary format described in BinaryState.h
+	JS1_API bool STDCALL export_state(void *script_handle, int32_t chunk_size, WRITE_CHUNK_CALLBACK write_chunk_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		js1::CallbackChunkSink sink(write_chunk_callback);
+		return query_script->export_state(sink, static_cast<size_t>(chunk_size));
+	}
+
+	JS1_API bool STDCALL import_state(void *script_handle, const uint8_t *data, int32_t length)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		return query_script->import_state(reinterpret_cast<const char *>(data), static_cast<size_t>(length));
+	}
+
+	// serializes only the part of the state at path, a top-level key or a JSON pointer
+	JS1_API bool STDCALL get_state_at(void *script_handle, const uint16_t *path, REPORT_STATISTICS_CALLBACK report_state_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		std::string json;
+		if (!query_script->get_state_at(path, json))
+			return false;
+		report_state_callback(&js1::utf8_to_utf16(json)[0]);
+		return true;
+	}
+
+	// spill_file_name may be NULL to keep serialized partitions in memory
+	JS1_API bool STDCALL configure_partition_store(void *script_handle, int32_t max_materialized, int64_t max_resident_bytes, const uint16_t *spill_file_name)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		if (max_materialized < 0 || max_resident_bytes < 0)
+			return false;
+		return query_script->configure_partition_store(static_cast<size_t>(max_materialized), static_cast<uint64_t>(max_resident_bytes), 
+			spill_file_name != NULL ? js1::utf16_to_utf8(spill_file_name) : std::string());
+	}
+
+	// returns 1 if the partition state has been restored, 0 for a partition the store has not seen (its state is 
+	// initialized by $init) and -1 on error, in which case the current partition does not change
+	JS1_API int32_t STDCALL select_partition(void *script_handle, const uint16_t *partition)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		return query_script->select_partition(partition);
+	}
+
+	JS1_API void STDCALL clear_partition_store(void *script_handle)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		query_script->clear_partition_store();
+	}
+
+	JS1_API void STDCALL get_partition_store_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::QueryScript *query_script;
+		query_script = reinterpret_cast<js1::QueryScript *>(script_handle);
+		js1::PreludeScope prelude_scope(query_script);
+
+		js1::JsonWriter writer;
+		query_script->write_partition_store_statistics(writer);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+
+	// compiles a by-stream query into shard_count isolates running on their own threads, errors are reported by sharded_report_errors
+	JS1_API void * STDCALL compile_sharded_query(
+		void *prelude, const uint16_t *script, const uint16_t *file_name, int32_t shard_count, REVERSE_COMMAND_CALLBACK reverse_command_callback)
+	{
+		js1::PreludeScript *prelude_script = reinterpret_cast<js1::PreludeScript *>(prelude);
+		js1::TraceSpan trace_span("compile_sharded_query", "js1");
+
+		js1::ShardedQuery *sharded_query = new js1::ShardedQuery(prelude_script, reverse_command_callback);
+		sharded_query->start(script, file_name, shard_count);
+		return sharded_query;
+	}
+
+	JS1_API void STDCALL dispose_sharded_query(void *sharded_query_handle)
+	{
+		delete reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+	}
+
+	// queues the event to the shard of its partition, the call does not wait for the event to be processed
+	JS1_API bool STDCALL sharded_process_event(
+		void *sharded_query_handle, const uint16_t *partition, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		return sharded_query->process_event(partition, data_json, data_other, other_length);
+	}
+
+	JS1_API bool STDCALL sharded_initialize(void *sharded_query_handle)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		return sharded_query->initialize();
+	}
+
+	// the state is a JSON object keyed by partition
+	JS1_API bool STDCALL sharded_get_state(void *sharded_query_handle, REPORT_STATISTICS_CALLBACK report_state_callback)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		std::string json;
+		if (!sharded_query->get_state(json))
+			return false;
+		report_state_callback(&js1::utf8_to_utf16(json)[0]);
+		return true;
+	}
+
+	JS1_API bool STDCALL sharded_set_state(void *sharded_query_handle, const uint16_t *state_json)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		return sharded_query->set_state(state_json);
+	}
+
+	JS1_API void STDCALL sharded_report_errors(void *sharded_query_handle, REPORT_ERROR_CALLBACK report_error_callback)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		sharded_query->report_errors(report_error_callback);
+	}
+
+	JS1_API void STDCALL get_sharded_query_statistics(void *sharded_query_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback)
+	{
+		js1::ShardedQuery *sharded_query = reinterpret_cast<js1::ShardedQuery *>(sharded_query_handle);
+		js1::JsonWriter writer;
+		sharded_query->write_statistics(writer);
+		report_statistics_callback(&writer.to_utf16()[0]);
+	}
+}
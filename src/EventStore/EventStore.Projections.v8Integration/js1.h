@@ -7,6 +7,8 @@ typedef void (STDCALL * REVERSE_COMMAND_CALLBACK)(const uint16_t *command_name,
 typedef void * (STDCALL * LOAD_MODULE_CALLBACK)(const uint16_t *module_name);
 typedef void (STDCALL * LOG_CALLBACK)(const uint16_t *message);
 typedef void (STDCALL * REPORT_ERROR_CALLBACK)(const int error_code, const uint16_t *error_message);
+typedef void (STDCALL * REPORT_STATISTICS_CALLBACK)(const uint16_t *statistics_json);
+typedef bool (STDCALL * WRITE_CHUNK_CALLBACK)(const uint8_t *data, int32_t length);
 
 extern "C" 
 {
@@ -28,4 +30,66 @@ extern "C"
 	JS1_API void STDCALL free_result(void *result);
 
 	JS1_API void report_errors(void *script_handle, REPORT_ERROR_CALLBACK report_error_callback);
+
+	JS1_API bool STDCALL notify_idle(void *script_handle, int32_t idle_time_ms);
+	JS1_API void STDCALL notify_low_memory(void *script_handle);
+	JS1_API void STDCALL set_idle_gc_policy(void *script_handle, int32_t idle_after_ms, int32_t idle_time_ms, bool after_checkpoint);
+	JS1_API void STDCALL notify_checkpoint(void *script_handle);
+	JS1_API bool STDCALL idle_tick(void *script_handle);
+
+	JS1_API void STDCALL get_gc_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback);
+	JS1_API void STDCALL reset_gc_statistics(void *script_handle);
+
+	JS1_API void STDCALL get_handler_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback);
+	JS1_API void STDCALL reset_handler_statistics(void *script_handle);
+
+	JS1_API bool STDCALL enable_v8_counters(const uint16_t *map_file_name);
+	JS1_API void STDCALL get_v8_counters(REPORT_STATISTICS_CALLBACK report_statistics_callback);
+
+	JS1_API bool STDCALL start_cpu_profiling(void *script_handle, const uint16_t *title, int32_t max_duration_ms);
+	JS1_API bool STDCALL take_cpu_profile(void *script_handle, int32_t format, REPORT_STATISTICS_CALLBACK report_profile_callback);
+
+	JS1_API bool STDCALL write_heap_snapshot(void *script_handle, const uint16_t *file_name);
+	JS1_API void STDCALL get_heap_summary(void *script_handle, int32_t top_count, REPORT_STATISTICS_CALLBACK report_statistics_callback);
+
+	JS1_API bool STDCALL enable_perf_map(bool enabled);
+
+	JS1_API bool STDCALL start_capture(const uint16_t *file_name, int64_t max_file_size, int32_t max_files);
+	JS1_API bool STDCALL stop_capture();
+
+	JS1_API bool STDCALL start_trace(const uint16_t *file_name);
+	JS1_API void STDCALL stop_trace();
+
+	JS1_API bool STDCALL set_log_level(int32_t level);
+	JS1_API bool STDCALL set_asynchronous_logging(bool asynchronous, int32_t capacity);
+	JS1_API int64_t STDCALL get_dropped_log_messages();
+
+	JS1_API bool STDCALL get_state_delta(void *script_handle, bool full, int32_t full_snapshot_every, REPORT_STATISTICS_CALLBACK report_delta_callback);
+	JS1_API bool STDCALL apply_state_delta(void *script_handle, const uint16_t *delta_json);
+
+	JS1_API bool STDCALL write_state(void *script_handle, int32_t chunk_size, WRITE_CHUNK_CALLBACK write_chunk_callback);
+	JS1_API void STDCALL begin_state_load(void *script_handle);
+	JS1_API bool STDCALL append_state_chunk(void *script_handle, const uint8_t *data, int32_t length);
+	JS1_API bool STDCALL end_state_load(void *script_handle);
+
+	JS1_API bool STDCALL export_state(void *script_handle, int32_t chunk_size, WRITE_CHUNK_CALLBACK write_chunk_callback);
+	JS1_API bool STDCALL import_state(void *script_handle, const uint8_t *data, int32_t length);
+
+	JS1_API bool STDCALL get_state_at(void *script_handle, const uint16_t *path, REPORT_STATISTICS_CALLBACK report_state_callback);
+
+	JS1_API bool STDCALL configure_partition_store(void *script_handle, int32_t max_materialized, int64_t max_resident_bytes, const uint16_t *spill_file_name);
+	JS1_API int32_t STDCALL select_partition(void *script_handle, const uint16_t *partition);
+	JS1_API void STDCALL clear_partition_store(void *script_handle);
+	JS1_API void STDCALL get_partition_store_statistics(void *script_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback);
+
+	JS1_API void * STDCALL compile_sharded_query(
+		void *prelude, const uint16_t *script, const uint16_t *file_name, int32_t shard_count, REVERSE_COMMAND_CALLBACK reverse_command_callback);
+	JS1_API void STDCALL dispose_sharded_query(void *sharded_query_handle);
+	JS1_API bool STDCALL sharded_process_event(
+		void *sharded_query_handle, const uint16_t *partition, const uint16_t *data_json, const uint16_t *data_other[], int32_t other_length);
+	JS1_API bool STDCALL sharded_initialize(void *sharded_query_handle);
+	JS1_API bool STDCALL sharded_get_state(void *sharded_query_handle, REPORT_STATISTICS_CALLBACK report_state_callback);
+	JS1_API bool STDCALL sharded_set_state(void *sharded_query_handle, const uint16_t *state_json);
+	JS1_API void STDCALL sharded_report_errors(void *sharded_query_handle, REPORT_ERROR_CALLBACK report_error_callback);
+	JS1_API void STDCALL get_sharded_query_statistics(void *sharded_query_handle, REPORT_STATISTICS_CALLBACK report_statistics_callback);
 }
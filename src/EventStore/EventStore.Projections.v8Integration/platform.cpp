@@ -0,0 +1,326 @@
+#include "stdafx.h"
+#include "platform.h"
+
+#if __GNUC__ >= 4
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#endif
+
+namespace js1 
+{
+	namespace platform 
+	{
+
+#if __GNUC__ >= 4
+
+		uint64_t now_us()
+		{
+			timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+		}
+
+		uint32_t process_id()
+		{
+			return static_cast<uint32_t>(getpid());
+		}
+
+		uint32_t thread_id()
+		{
+			return static_cast<uint32_t>(syscall(SYS_gettid));
+		}
+
+		uint64_t atomic_compare_exchange(volatile uint64_t *target, uint64_t expected, uint64_t desired)
+		{
+			return __sync_val_compare_and_swap(target, expected, desired);
+		}
+
+		uint64_t atomic_increment(volatile uint64_t *target)
+		{
+			return __sync_add_and_fetch(target, 1);
+		}
+
+		uint64_t atomic_decrement(volatile uint64_t *target)
+		{
+			return __sync_sub_and_fetch(target, 1);
+		}
+
+		void memory_barrier()
+		{
+			__sync_synchronize();
+		}
+
+		Mutex::Mutex()
+		{
+			pthread_mutex_init(&mutex, NULL);
+		}
+
+		Mutex::~Mutex()
+		{
+			pthread_mutex_destroy(&mutex);
+		}
+
+		void Mutex::lock()
+		{
+			pthread_mutex_lock(&mutex);
+		}
+
+		void Mutex::unlock()
+		{
+			pthread_mutex_unlock(&mutex);
+		}
+
+		ConditionVariable::ConditionVariable()
+		{
+			pthread_cond_init(&condition, NULL);
+		}
+
+		ConditionVariable::~ConditionVariable()
+		{
+			pthread_cond_destroy(&condition);
+		}
+
+		void ConditionVariable::wait(Mutex &mutex)
+		{
+			pthread_cond_wait(&condition, &mutex.mutex);
+		}
+
+		bool ConditionVariable::wait(Mutex &mutex, uint32_t timeout_ms)
+		{
+			timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += timeout_ms / 1000;
+			deadline.tv_nsec += static_cast<long>(timeout_ms % 1000) * 1000000;
+			if (deadline.tv_nsec >= 1000000000)
+			{
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+			return pthread_cond_timedwait(&condition, &mutex.mutex, &deadline) != ETIMEDOUT;
+		}
+
+		void ConditionVariable::notify_one()
+		{
+			pthread_cond_signal(&condition);
+		}
+
+		void ConditionVariable::notify_all()
+		{
+			pthread_cond_broadcast(&condition);
+		}
+
+		Thread::Thread() : started(false), function(NULL), argument(NULL)
+		{
+		}
+
+		Thread::~Thread()
+		{
+			if (started)
+				pthread_detach(thread);
+		}
+
+		bool Thread::start(ThreadFunction function_, void *argument_)
+		{
+			if (started)
+				return false;
+			function = function_;
+			argument = argument_;
+			started = pthread_create(&thread, NULL, thread_start, this) == 0;
+			return started;
+		}
+
+		void Thread::join()
+		{
+			if (!started)
+				return;
+			pthread_join(thread, NULL);
+			started = false;
+		}
+
+		void *Thread::thread_start(void *thread)
+		{
+			Thread *self = reinterpret_cast<Thread *>(thread);
+			self->function(self->argument);
+			return NULL;
+		}
+
+		void *map_file(const char *file_name, size_t size)
+		{
+			int fd = open(file_name, O_RDWR | O_CREAT, 0644);
+			if (fd < 0)
+				return NULL;
+			if (ftruncate(fd, size) != 0)
+			{
+				close(fd);
+				return NULL;
+			}
+			void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			return memory == MAP_FAILED ? NULL : memory;
+		}
+
+		void unmap_file(void *memory, size_t size)
+		{
+			munmap(memory, size);
+		}
+
+#else
+
+		uint64_t now_us()
+		{
+			static LARGE_INTEGER frequency = { 0 };
+			if (frequency.QuadPart == 0)
+				QueryPerformanceFrequency(&frequency);
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return static_cast<uint64_t>(counter.QuadPart / frequency.QuadPart) * 1000000 
+				+ static_cast<uint64_t>(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+		}
+
+		uint32_t process_id()
+		{
+			return static_cast<uint32_t>(GetCurrentProcessId());
+		}
+
+		uint32_t thread_id()
+		{
+			return static_cast<uint32_t>(GetCurrentThreadId());
+		}
+
+		uint64_t atomic_compare_exchange(volatile uint64_t *target, uint64_t expected, uint64_t desired)
+		{
+			return static_cast<uint64_t>(InterlockedCompareExchange64(
+				reinterpret_cast<volatile LONGLONG *>(target), static_cast<LONGLONG>(desired), static_cast<LONGLONG>(expected)));
+		}
+
+		uint64_t atomic_increment(volatile uint64_t *target)
+		{
+			return static_cast<uint64_t>(InterlockedIncrement64(reinterpret_cast<volatile LONGLONG *>(target)));
+		}
+
+		uint64_t atomic_decrement(volatile uint64_t *target)
+		{
+			return static_cast<uint64_t>(InterlockedDecrement64(reinterpret_cast<volatile LONGLONG *>(target)));
+		}
+
+		void memory_barrier()
+		{
+			MemoryBarrier();
+		}
+
+		Mutex::Mutex()
+		{
+			InitializeCriticalSection(&mutex);
+		}
+
+		Mutex::~Mutex()
+		{
+			DeleteCriticalSection(&mutex);
+		}
+
+		void Mutex::lock()
+		{
+			EnterCriticalSection(&mutex);
+		}
+
+		void Mutex::unlock()
+		{
+			LeaveCriticalSection(&mutex);
+		}
+
+		ConditionVariable::ConditionVariable()
+		{
+			InitializeConditionVariable(&condition);
+		}
+
+		ConditionVariable::~ConditionVariable()
+		{
+		}
+
+		void ConditionVariable::wait(Mutex &mutex)
+		{
+			SleepConditionVariableCS(&condition, &mutex.mutex, INFINITE);
+		}
+
+		bool ConditionVariable::wait(Mutex &mutex, uint32_t timeout_ms)
+		{
+			return SleepConditionVariableCS(&condition, &mutex.mutex, timeout_ms) != 0;
+		}
+
+		void ConditionVariable::notify_one()
+		{
+			WakeConditionVariable(&condition);
+		}
+
+		void ConditionVariable::notify_all()
+		{
+			WakeAllConditionVariable(&condition);
+		}
+
+		Thread::Thread() : started(false), function(NULL), argument(NULL), thread(NULL)
+		{
+		}
+
+		Thread::~Thread()
+		{
+			if (started)
+				CloseHandle(thread);
+		}
+
+		bool Thread::start(ThreadFunction function_, void *argument_)
+		{
+			if (started)
+				return false;
+			function = function_;
+			argument = argument_;
+			thread = CreateThread(NULL, 0, thread_start, this, 0, NULL);
+			started = thread != NULL;
+			return started;
+		}
+
+		void Thread::join()
+		{
+			if (!started)
+				return;
+			WaitForSingleObject(thread, INFINITE);
+			CloseHandle(thread);
+			thread = NULL;
+			started = false;
+		}
+
+		DWORD WINAPI Thread::thread_start(LPVOID thread)
+		{
+			Thread *self = reinterpret_cast<Thread *>(thread);
+			self->function(self->argument);
+			return 0;
+		}
+
+		void *map_file(const char *file_name, size_t size)
+		{
+			HANDLE file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 
+				NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+				return NULL;
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 
+				static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), NULL);
+			CloseHandle(file);
+			if (mapping == NULL)
+				return NULL;
+			void *memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+			CloseHandle(mapping);
+			return memory;
+		}
+
+		void unmap_file(void *memory, size_t /*size*/)
+		{
+			UnmapViewOfFile(memory);
+		}
+
+#endif
+
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#if __GNUC__ >= 4
+#include <pthread.h>
+#else
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace js1 
+{
+	namespace platform 
+	{
+		// monotonic clock in microseconds, only differences between two readings are meaningful
+		uint64_t now_us();
+
+		uint32_t process_id();
+		uint32_t thread_id();
+
+		// full barrier atomics, compare_exchange returns the previous value of target
+		uint64_t atomic_compare_exchange(volatile uint64_t *target, uint64_t expected, uint64_t desired);
+		uint64_t atomic_increment(volatile uint64_t *target);
+		uint64_t atomic_decrement(volatile uint64_t *target);
+		void memory_barrier();
+
+		class Mutex 
+		{
+		public:
+			Mutex();
+			~Mutex();
+			void lock();
+			void unlock();
+		private:
+			friend class ConditionVariable;
+#if __GNUC__ >= 4
+			pthread_mutex_t mutex;
+#else
+			CRITICAL_SECTION mutex;
+#endif
+			Mutex(const Mutex &);
+			Mutex& operator=(const Mutex &);
+		};
+
+		class ScopedLock 
+		{
+		public:
+			ScopedLock(Mutex &mutex_) : mutex(mutex_) 
+			{
+				mutex.lock();
+			}
+			~ScopedLock()
+			{
+				mutex.unlock();
+			}
+		private:
+			Mutex &mutex;
+			ScopedLock(const ScopedLock &);
+			ScopedLock& operator=(const ScopedLock &);
+		};
+
+		class ConditionVariable 
+		{
+		public:
+			ConditionVariable();
+			~ConditionVariable();
+			// the mutex must be locked by the caller, spurious wake ups are possible
+			void wait(Mutex &mutex);
+			// returns false if the timeout has elapsed
+			bool wait(Mutex &mutex, uint32_t timeout_ms);
+			void notify_one();
+			void notify_all();
+		private:
+#if __GNUC__ >= 4
+			pthread_cond_t condition;
+#else
+			CONDITION_VARIABLE condition;
+#endif
+			ConditionVariable(const ConditionVariable &);
+			ConditionVariable& operator=(const ConditionVariable &);
+		};
+
+		class Thread 
+		{
+		public:
+			typedef void (*ThreadFunction)(void *argument);
+
+			Thread();
+			// a thread which has not been joined is detached
+			~Thread();
+			bool start(ThreadFunction function, void *argument);
+			void join();
+			bool is_started() const
+			{
+				return started;
+			}
+		private:
+			bool started;
+			ThreadFunction function;
+			void *argument;
+#if __GNUC__ >= 4
+			pthread_t thread;
+			static void *thread_start(void *thread);
+#else
+			HANDLE thread;
+			static DWORD WINAPI thread_start(LPVOID thread);
+#endif
+			Thread(const Thread &);
+			Thread& operator=(const Thread &);
+		};
+
+		// maps a file of the given size into memory, creating or extending it if necessary
+		void *map_file(const char *file_name, size_t size);
+		void unmap_file(void *memory, size_t size);
+	}
+}
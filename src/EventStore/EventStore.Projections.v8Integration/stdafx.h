@@ -7,6 +7,7 @@
 
 #include <list>
 #include <vector>
+#include <map>
 #include <string>
 
 #include <v8.h>
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+function err() {
+    exit 1
+}
+
+pushd $(dirname $0)/../.. || err
+js=$(pwd -P)
+include="-I $js/libs/include -I $js/EventStore.Projections.v8Integration"
+libs="-L $js/libs"
+output="$js/libs"
+
+$js/Scripts/v8/build-js1.sh || err
+
+pushd $js/EventStore.Projections.v8Integration.Benchmarks/ || err
+  shared="$js/EventStore.Projections.v8Integration"
+  g++ -O2 $include $libs js1bench.cpp $shared/Histogram.cpp $shared/JsonWriter.cpp $shared/encoding.cpp $shared/platform.cpp \
+      -o $output/js1bench -ljs1 -lv8 -lrt -lpthread -Wl,-rpath,'$ORIGIN' || err
+  g++ -O2 $include $libs js1micro.cpp $shared/JsonWriter.cpp $shared/platform.cpp \
+      -o $output/js1micro -ljs1 -lv8 -lrt -lpthread -Wl,-rpath,'$ORIGIN' || err
+  g++ -O2 $include $libs js1replay.cpp $shared/Capture.cpp $shared/Histogram.cpp $shared/JsonWriter.cpp $shared/encoding.cpp $shared/platform.cpp \
+      -o $output/js1replay -ljs1 -lv8 -lrt -lpthread -Wl,-rpath,'$ORIGIN' || err
+  g++ -O2 js1gen.cpp -o $output/js1gen || err
+popd || err
+popd || err
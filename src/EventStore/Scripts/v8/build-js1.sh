@@ -15,7 +15,7 @@ pushd $js/EventStore.Projections.v8Integration/ || err
   if [[ ! -d x64/Debug ]] ; then
 	  mkdir -p x64/Debug || err
   fi
-  g++ $include $libs *.cpp -o $output/libjs1.so -lv8 -fPIC -shared --save-temps || err    
+  g++ ${CXXFLAGS:--O2} $include $libs *.cpp -o $output/libjs1.so -lv8 -lrt -lpthread -fPIC -shared || err
 
 
 popd || err